@@ -7,6 +7,8 @@
 #include "esp_log.h"
 #include "nvs_flash.h"
 #include "nvs.h"
+#include "esfera_registry.h"
+#include "esfera_config.h"
 
 #define BTN_GPIO                19
 #define DEBOUNCE_US             40000      // 40 ms
@@ -52,8 +54,10 @@ static esp_err_t nvs_erase_namespace_all(const char *ns)
 static void borrar_esferas_y_config(void)
 {
     // Limpia registro de esferas y configuraciones por MAC
-    nvs_erase_namespace_all("esferas");       // esfera_manager_register_mac() 
-    nvs_erase_namespace_all("config_store");  // procesar_configuracion_esfera() 
+    nvs_erase_namespace_all("esferas");       // esfera_registry_flush() 
+    nvs_erase_namespace_all("config_store");  // esfera_config_guardar() 
+    esfera_config_reset();                     // caché en RAM de "config_store"
+    esfera_registry_reset();                   // copia en RAM del namespace "esferas"
 }
 
 
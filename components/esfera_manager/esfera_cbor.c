@@ -0,0 +1,94 @@
+#include "esfera_cbor.h"
+#include <stdbool.h>
+#include <string.h>
+
+#define MAYOR_UINT      0
+#define MAYOR_NEGATIVO  1
+#define MAYOR_BYTES     2
+#define MAYOR_TEXTO     3
+#define MAYOR_ARRAY     4
+#define MAYOR_MAPA      5
+#define MAYOR_TAG       6
+
+void esfera_cbor_init(esfera_cbor_t *w, uint8_t *buf, size_t cap)
+{
+    w->buf = buf;
+    w->cap = cap;
+    w->len = 0;
+    w->err = ESP_OK;
+}
+
+static bool reservar(esfera_cbor_t *w, size_t n)
+{
+    if (w->err != ESP_OK) return false;
+    if (w->len + n > w->cap) {
+        w->err = ESP_ERR_NO_MEM;
+        return false;
+    }
+    return true;
+}
+
+// Cabecera de un elemento: tipo mayor y argumento en la forma más corta
+static void cabecera(esfera_cbor_t *w, uint8_t mayor, uint64_t v)
+{
+    uint8_t tipo = mayor << 5;
+    int extra = v < 24 ? 0 : v <= UINT8_MAX ? 1 : v <= UINT16_MAX ? 2 : v <= UINT32_MAX ? 4 : 8;
+    if (!reservar(w, 1 + extra)) return;
+
+    uint8_t *p = &w->buf[w->len];
+    switch (extra) {
+    case 0: *p = tipo | (uint8_t)v; break;
+    case 1: *p = tipo | 24; break;
+    case 2: *p = tipo | 25; break;
+    case 4: *p = tipo | 26; break;
+    default: *p = tipo | 27; break;
+    }
+    // Big-endian, como pide el estándar
+    for (int i = 0; i < extra; i++) {
+        p[1 + i] = (uint8_t)(v >> (8 * (extra - 1 - i)));
+    }
+    w->len += 1 + extra;
+}
+
+void esfera_cbor_uint(esfera_cbor_t *w, uint64_t v)
+{
+    cabecera(w, MAYOR_UINT, v);
+}
+
+void esfera_cbor_int(esfera_cbor_t *w, int64_t v)
+{
+    if (v >= 0) cabecera(w, MAYOR_UINT, (uint64_t)v);
+    else cabecera(w, MAYOR_NEGATIVO, (uint64_t)(-1 - v));
+}
+
+void esfera_cbor_bytes(esfera_cbor_t *w, const uint8_t *datos, size_t len)
+{
+    cabecera(w, MAYOR_BYTES, len);
+    if (!reservar(w, len)) return;
+    memcpy(&w->buf[w->len], datos, len);
+    w->len += len;
+}
+
+void esfera_cbor_texto(esfera_cbor_t *w, const char *s)
+{
+    size_t len = strlen(s);
+    cabecera(w, MAYOR_TEXTO, len);
+    if (!reservar(w, len)) return;
+    memcpy(&w->buf[w->len], s, len);
+    w->len += len;
+}
+
+void esfera_cbor_array(esfera_cbor_t *w, size_t elementos)
+{
+    cabecera(w, MAYOR_ARRAY, elementos);
+}
+
+void esfera_cbor_mapa(esfera_cbor_t *w, size_t pares)
+{
+    cabecera(w, MAYOR_MAPA, pares);
+}
+
+void esfera_cbor_tag(esfera_cbor_t *w, uint64_t tag)
+{
+    cabecera(w, MAYOR_TAG, tag);
+}
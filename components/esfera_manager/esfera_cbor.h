@@ -0,0 +1,34 @@
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+#include "esp_err.h"
+
+// Claves enteras de cada lectura en las respuestas CBOR (mapa por lectura)
+#define ESFERA_CBOR_MAC             0   // bstr de 6 bytes
+#define ESFERA_CBOR_TIMESTAMP       1   // Tag 1 (epoch) + uint
+#define ESFERA_CBOR_HUMEDAD         2   // uint, centésimas de %
+#define ESFERA_CBOR_TEMPERATURA     3   // int, centésimas de °C
+#define ESFERA_CBOR_BATERIA         4   // uint, mV
+#define ESFERA_CBOR_RIEGO           5   // uint
+
+/**
+ * @brief Escritor CBOR (RFC 8949) mínimo sobre un buffer provisto por quien llama.
+ *        Solo largos definidos: arrays y mapas llevan la cantidad de elementos.
+ */
+typedef struct {
+    uint8_t *buf;
+    size_t cap;
+    size_t len;
+    esp_err_t err;          // ESP_ERR_NO_MEM si el buffer no alcanzó; el resto se ignora
+} esfera_cbor_t;
+
+void esfera_cbor_init(esfera_cbor_t *w, uint8_t *buf, size_t cap);
+
+void esfera_cbor_uint(esfera_cbor_t *w, uint64_t v);
+void esfera_cbor_int(esfera_cbor_t *w, int64_t v);
+void esfera_cbor_bytes(esfera_cbor_t *w, const uint8_t *datos, size_t len);
+void esfera_cbor_texto(esfera_cbor_t *w, const char *s);
+void esfera_cbor_array(esfera_cbor_t *w, size_t elementos);
+void esfera_cbor_mapa(esfera_cbor_t *w, size_t pares);
+void esfera_cbor_tag(esfera_cbor_t *w, uint64_t tag);
@@ -0,0 +1,195 @@
+#include "esfera_codec.h"
+#include <string.h>
+
+// Peor caso por lectura: timestamp 4+34 bits, 3 valores de 4+17 bits, riego 1 bit
+#define BITS_MAX_LECTURA    (38 + 3 * 21 + 1)
+
+typedef struct {
+    uint8_t *buf;
+    size_t cap;
+    size_t bit;
+    bool desborde;
+} escritor_t;
+
+typedef struct {
+    const uint8_t *buf;
+    size_t len;
+    size_t bit;
+    bool agotado;
+} lector_t;
+
+static void poner(escritor_t *w, uint64_t valor, unsigned bits)
+{
+    while (bits--) {
+        size_t byte = w->bit >> 3;
+        if (byte >= w->cap) {
+            w->desborde = true;
+            return;
+        }
+        uint8_t mascara = 0x80 >> (w->bit & 7);
+        if ((valor >> bits) & 1) w->buf[byte] |= mascara;
+        else w->buf[byte] &= ~mascara;
+        w->bit++;
+    }
+}
+
+static uint64_t tomar(lector_t *r, unsigned bits)
+{
+    uint64_t valor = 0;
+    while (bits--) {
+        size_t byte = r->bit >> 3;
+        if (byte >= r->len) {
+            r->agotado = true;
+            return 0;
+        }
+        valor = (valor << 1) | ((r->buf[byte] >> (7 - (r->bit & 7))) & 1);
+        r->bit++;
+    }
+    return valor;
+}
+
+static inline uint64_t zigzag(int64_t v)
+{
+    return ((uint64_t)v << 1) ^ (uint64_t)(v >> 63);
+}
+
+static inline int64_t dezigzag(uint64_t v)
+{
+    return (int64_t)(v >> 1) ^ -(int64_t)(v & 1);
+}
+
+// Prefijos de largo variable: '0' = 0, luego un escalón por cada tabla de anchos
+typedef struct {
+    uint8_t anchos[4];      // Bits del valor para prefijos '10', '110', '1110', '1111'
+} escalones_t;
+
+static const escalones_t ESC_TIEMPO = { { 7, 9, 12, 34 } };   // Delta-of-delta en segundos
+static const escalones_t ESC_VALOR  = { { 4, 8, 12, 17 } };   // Delta de valores de 16 bits
+
+static void poner_variable(escritor_t *w, int64_t v, const escalones_t *e)
+{
+    if (v == 0) {
+        poner(w, 0, 1);
+        return;
+    }
+    uint64_t z = zigzag(v);
+    for (unsigned i = 0; i < 4; i++) {
+        if (i == 3 || z < (1ULL << e->anchos[i])) {
+            // i = 0..2: i+1 unos y un cero; i = 3: cuatro unos
+            unsigned unos = i + 1;
+            poner(w, (1u << unos) - 1, unos);
+            if (i < 3) poner(w, 0, 1);
+            poner(w, z, e->anchos[i]);
+            return;
+        }
+    }
+}
+
+static int64_t tomar_variable(lector_t *r, const escalones_t *e)
+{
+    unsigned unos = 0;
+    while (unos < 4 && tomar(r, 1)) unos++;
+    if (unos == 0) return 0;
+    return dezigzag(tomar(r, e->anchos[unos - 1]));
+}
+
+size_t esfera_codec_max_largo(size_t n)
+{
+    return sizeof(esfera_codec_cabecera_t) + (n * BITS_MAX_LECTURA + 7) / 8;
+}
+
+esp_err_t esfera_codec_codificar(const esfera_data_t *datos, size_t n, uint8_t *buf, size_t cap, size_t *largo)
+{
+    if (n == 0 || n > ESFERA_CODEC_MAX_MUESTRAS) return ESP_ERR_INVALID_ARG;
+    if (cap < sizeof(esfera_codec_cabecera_t)) return ESP_ERR_INVALID_SIZE;
+    // Riego viaja en 1 bit: esfera_frame solo acepta 0 o 1, pero no se trunca en silencio
+    for (size_t i = 0; i < n; i++) {
+        if (datos[i].riego > 1) return ESP_ERR_INVALID_ARG;
+    }
+
+    escritor_t w = {
+        .buf = buf + sizeof(esfera_codec_cabecera_t),
+        .cap = cap - sizeof(esfera_codec_cabecera_t),
+    };
+
+    // La primera lectura va completa en el flujo; el resto, como diferencias
+    poner(&w, datos[0].humedad, 16);
+    poner(&w, (uint16_t)datos[0].temperatura, 16);
+    poner(&w, datos[0].voltaje_mv, 16);
+    poner(&w, datos[0].riego, 1);
+
+    int64_t delta_previo = 0;
+    for (size_t i = 1; i < n && !w.desborde; i++) {
+        const esfera_data_t *a = &datos[i - 1];
+        const esfera_data_t *b = &datos[i];
+        int64_t delta = (int64_t)b->epoch - a->epoch;
+        poner_variable(&w, delta - delta_previo, &ESC_TIEMPO);
+        delta_previo = delta;
+        poner_variable(&w, (int64_t)b->humedad - a->humedad, &ESC_VALOR);
+        poner_variable(&w, (int64_t)b->temperatura - a->temperatura, &ESC_VALOR);
+        poner_variable(&w, (int64_t)b->voltaje_mv - a->voltaje_mv, &ESC_VALOR);
+        poner(&w, b->riego, 1);
+    }
+    if (w.desborde) return ESP_ERR_INVALID_SIZE;
+
+    size_t total = sizeof(esfera_codec_cabecera_t) + (w.bit + 7) / 8;
+    if (total > UINT16_MAX) return ESP_ERR_INVALID_SIZE;
+
+    esfera_codec_cabecera_t cab = {
+        .version = ESFERA_CODEC_VERSION,
+        .muestras = (uint16_t)n,
+        .epoch_ini = datos[0].epoch,
+        .epoch_fin = datos[n - 1].epoch,
+        .largo = (uint16_t)total,
+    };
+    memcpy(cab.mac, datos[0].mac, sizeof(cab.mac));
+    memcpy(buf, &cab, sizeof(cab));
+    *largo = total;
+    return ESP_OK;
+}
+
+esp_err_t esfera_codec_cabecera(const uint8_t *buf, size_t len, esfera_codec_cabecera_t *cab)
+{
+    if (len < sizeof(*cab)) return ESP_ERR_INVALID_SIZE;
+    memcpy(cab, buf, sizeof(*cab));
+    if (cab->version != ESFERA_CODEC_VERSION) return ESP_ERR_NOT_SUPPORTED;
+    if (cab->largo > len || cab->largo < sizeof(*cab) || cab->muestras == 0) return ESP_ERR_INVALID_SIZE;
+    return ESP_OK;
+}
+
+esp_err_t esfera_codec_decodificar(const uint8_t *buf, size_t len, esfera_data_t *out, size_t cap, size_t *n)
+{
+    esfera_codec_cabecera_t cab;
+    esp_err_t err = esfera_codec_cabecera(buf, len, &cab);
+    if (err != ESP_OK) return err;
+    if (cab.muestras > cap) return ESP_ERR_INVALID_SIZE;
+
+    lector_t r = {
+        .buf = buf + sizeof(cab),
+        .len = cab.largo - sizeof(cab),
+    };
+
+    esfera_data_t d;
+    memcpy(d.mac, cab.mac, sizeof(d.mac));
+    d.epoch = cab.epoch_ini;
+    d.humedad = (uint16_t)tomar(&r, 16);
+    d.temperatura = (int16_t)tomar(&r, 16);
+    d.voltaje_mv = (uint16_t)tomar(&r, 16);
+    d.riego = (uint8_t)tomar(&r, 1);
+    out[0] = d;
+
+    int64_t delta = 0;
+    for (size_t i = 1; i < cab.muestras && !r.agotado; i++) {
+        delta += tomar_variable(&r, &ESC_TIEMPO);
+        d.epoch = (uint32_t)(d.epoch + delta);
+        d.humedad = (uint16_t)(d.humedad + tomar_variable(&r, &ESC_VALOR));
+        d.temperatura = (int16_t)(d.temperatura + tomar_variable(&r, &ESC_VALOR));
+        d.voltaje_mv = (uint16_t)(d.voltaje_mv + tomar_variable(&r, &ESC_VALOR));
+        d.riego = (uint8_t)tomar(&r, 1);
+        out[i] = d;
+    }
+    if (r.agotado || d.epoch != cab.epoch_fin) return ESP_ERR_INVALID_CRC;
+
+    *n = cab.muestras;
+    return ESP_OK;
+}
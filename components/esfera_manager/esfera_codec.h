@@ -0,0 +1,58 @@
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+#include "esp_err.h"
+#include "esfera_manager.h"
+
+#define ESFERA_CODEC_VERSION        1
+#define ESFERA_CODEC_MAX_MUESTRAS   256     // Lecturas por bloque: granularidad del acceso aleatorio
+
+/**
+ * @brief Cabecera de bloque, legible sin decodificar el resto (little endian, 19 bytes).
+ *
+ * Un bloque contiene lecturas de una sola esfera. Tras la cabecera va un flujo
+ * de bits: timestamps con delta-of-delta y valores con delta en punto fijo,
+ * cada uno con prefijos de largo variable al estilo Gorilla; riego en 1 bit.
+ */
+typedef struct __attribute__((packed)) {
+    uint8_t version;
+    uint8_t mac[6];
+    uint16_t muestras;
+    uint32_t epoch_ini;
+    uint32_t epoch_fin;
+    uint16_t largo;         // Bytes del bloque completo, cabecera incluida
+} esfera_codec_cabecera_t;
+
+_Static_assert(sizeof(esfera_codec_cabecera_t) == 19, "esfera_codec_cabecera_t debe medir 19 bytes");
+
+/**
+ * @brief Comprime lecturas de una misma esfera en un bloque.
+ *
+ * @param datos Lecturas (mismo mac), en el orden en que se quieren recuperar.
+ * @param n Cantidad, hasta ESFERA_CODEC_MAX_MUESTRAS.
+ * @param buf Destino.
+ * @param cap Tamaño de buf.
+ * @param largo Bytes escritos.
+ * @return ESP_ERR_INVALID_SIZE si no entra en cap; ESP_ERR_INVALID_ARG si algún
+ *         riego no es 0 o 1.
+ */
+esp_err_t esfera_codec_codificar(const esfera_data_t *datos, size_t n, uint8_t *buf, size_t cap, size_t *largo);
+
+/**
+ * @brief Lee la cabecera del bloque en buf (permite saltar bloques por largo o por rango de epoch).
+ */
+esp_err_t esfera_codec_cabecera(const uint8_t *buf, size_t len, esfera_codec_cabecera_t *cab);
+
+/**
+ * @brief Descomprime un bloque.
+ *
+ * @param out Destino con lugar para cab.muestras lecturas.
+ * @param n Lecturas escritas.
+ */
+esp_err_t esfera_codec_decodificar(const uint8_t *buf, size_t len, esfera_data_t *out, size_t cap, size_t *n);
+
+/**
+ * @brief Cota del tamaño de un bloque de n lecturas en el peor caso.
+ */
+size_t esfera_codec_max_largo(size_t n);
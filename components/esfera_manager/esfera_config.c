@@ -0,0 +1,226 @@
+#include "esfera_config.h"
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+#include <inttypes.h>
+#include "esp_log.h"
+#include "nvs_flash.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/semphr.h"
+#include "esfera_registry.h"
+
+#define CONFIG_NS   "config_store"
+
+static const char *TAG = "ESFERA_CONFIG";
+
+// --- Configuración estándar ---
+static const char *default_config_json =
+    "{\"MACHUB\":\"%s\",\"MACSLAVE\":\"%s\","
+    "\"colorLED\":16777215,"
+    "\"riegoAuto\":0,"
+    "\"diasRiego\":0,"
+    "\"horaRiego\":\"08:00\","
+    "\"ml\":100}";
+
+typedef struct {
+    uint8_t mac[6];             // Valida que la entrada corresponda al índice actual del registro
+    bool cargada;
+    uint32_t version;           // Hash de la configuración, 0 = sin configuración
+    uint32_t version_enviada;   // Última versión entregada a la esfera
+    uint16_t len;
+    char *payload;              // JSON con "cfgVer" agregado, listo para ESP-NOW
+} config_cache_t;
+
+static config_cache_t s_cache[ESFERA_REGISTRY_MAX];
+static SemaphoreHandle_t s_mutex;
+static const char *s_mac_hub = "";
+
+static uint32_t hash_config(const char *json)
+{
+    // FNV-1a de 32 bits; 0 se reserva para "sin configuración"
+    uint32_t h = 2166136261u;
+    for (const char *p = json; *p; p++) {
+        h ^= (uint8_t)*p;
+        h *= 16777619u;
+    }
+    return h ? h : 1;
+}
+
+static void liberar(config_cache_t *c)
+{
+    free(c->payload);
+    c->payload = NULL;
+    c->len = 0;
+    c->version = 0;
+    c->cargada = false;
+}
+
+// Agrega "cfgVer" al objeto JSON para que la esfera pueda informar la versión aplicada
+static void asignar_payload(config_cache_t *c, const char *json)
+{
+    size_t n = strlen(json);
+    if (n < 2 || json[n - 1] != '}') {
+        ESP_LOGE(TAG, "❌ Configuración no es un objeto JSON");
+        liberar(c);
+        return;
+    }
+
+    uint32_t version = hash_config(json);
+    char sufijo[24];
+    int s = snprintf(sufijo, sizeof(sufijo), "%s\"cfgVer\":%" PRIu32 "}", n > 2 ? "," : "", version);
+    size_t total = n - 1 + s;
+    if (total > ESFERA_CONFIG_MAX_LEN) {
+        ESP_LOGE(TAG, "❌ Configuración de %u bytes no entra en una trama ESP-NOW", (unsigned)total);
+        liberar(c);
+        return;
+    }
+
+    char *payload = malloc(total + 1);
+    if (!payload) {
+        ESP_LOGE(TAG, "❌ Error asignando memoria para JSON");
+        liberar(c);
+        return;
+    }
+    memcpy(payload, json, n - 1);
+    memcpy(payload + n - 1, sufijo, s + 1);
+
+    free(c->payload);
+    c->payload = payload;
+    c->len = (uint16_t)total;
+    c->version = version;
+    c->cargada = true;
+}
+
+static void cargar(config_cache_t *c, const uint8_t mac[6])
+{
+    char mac_txt[13];
+    esfera_registry_mac_a_texto(mac, mac_txt);
+
+    liberar(c);
+    memcpy(c->mac, mac, 6);
+    c->version_enviada = 0;
+
+    nvs_handle_t handle;
+    size_t required_size = 0;
+    char *json = NULL;
+    if (nvs_open(CONFIG_NS, NVS_READONLY, &handle) == ESP_OK) {
+        if (nvs_get_str(handle, mac_txt, NULL, &required_size) == ESP_OK && (json = malloc(required_size))) {
+            if (nvs_get_str(handle, mac_txt, json, &required_size) != ESP_OK) {
+                free(json);
+                json = NULL;
+            }
+        }
+        nvs_close(handle);
+    }
+
+    if (json) {
+        asignar_payload(c, json);
+        free(json);
+    } else {
+        ESP_LOGI(TAG, "ℹ️ No hay configuración en NVS, usando estándar para %s", mac_txt);
+        char buffer[256];
+        snprintf(buffer, sizeof(buffer), default_config_json, s_mac_hub, mac_txt);
+        asignar_payload(c, buffer);
+    }
+    c->cargada = true;
+}
+
+void esfera_config_init(const char *mac_hub)
+{
+    s_mac_hub = mac_hub;
+    if (!s_mutex) s_mutex = xSemaphoreCreateMutex();
+}
+
+bool esfera_config_pendiente(uint16_t indice, const esfera_lectura_t *lectura,
+                             uint8_t *buf, size_t *len, uint32_t *version)
+{
+    const uint8_t *mac = esfera_registry_mac(indice);
+    bool enviar = false;
+
+    xSemaphoreTake(s_mutex, portMAX_DELAY);
+
+    config_cache_t *c = &s_cache[indice];
+    if (!c->cargada || memcmp(c->mac, mac, 6) != 0) {
+        cargar(c, mac);
+    }
+
+    if (c->payload) {
+        if (lectura && lectura->tiene_cfg) {
+            enviar = lectura->cfg_version != c->version;
+        } else {
+            enviar = c->version_enviada != c->version;
+        }
+    }
+
+    if (enviar && c->len <= *len) {
+        memcpy(buf, c->payload, c->len);
+        *len = c->len;
+        *version = c->version;
+    } else {
+        enviar = false;
+    }
+
+    xSemaphoreGive(s_mutex);
+    return enviar;
+}
+
+void esfera_config_marcar_enviada(uint16_t indice, uint32_t version)
+{
+    xSemaphoreTake(s_mutex, portMAX_DELAY);
+    s_cache[indice].version_enviada = version;
+    xSemaphoreGive(s_mutex);
+}
+
+esp_err_t esfera_config_guardar(const char *mac_txt, const char *json)
+{
+    uint8_t mac[6];
+    if (!esfera_registry_mac_desde_texto(mac_txt, mac)) {
+        ESP_LOGE(TAG, "❌ MAC inválida: %s", mac_txt);
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    char clave[13];
+    esfera_registry_mac_a_texto(mac, clave);
+
+    nvs_handle_t handle;
+    esp_err_t err = nvs_open(CONFIG_NS, NVS_READWRITE, &handle);
+    if (err != ESP_OK) {
+        ESP_LOGE(TAG, "❌ Error abriendo NVS: %s", esp_err_to_name(err));
+        return err;
+    }
+
+    err = nvs_set_str(handle, clave, json);
+    if (err == ESP_OK) {
+        err = nvs_commit(handle);
+    }
+    nvs_close(handle);
+    if (err != ESP_OK) {
+        ESP_LOGE(TAG, "❌ Error escribiendo en NVS: %s", esp_err_to_name(err));
+        return err;
+    }
+
+    // Si la esfera ya está en caché se actualiza la versión; si no, se cargará
+    // desde NVS en su próxima trama.
+    uint16_t indice = esfera_registry_find(mac);
+    if (indice != ESFERA_REGISTRY_NINGUNA) {
+        xSemaphoreTake(s_mutex, portMAX_DELAY);
+        config_cache_t *c = &s_cache[indice];
+        if (c->cargada && memcmp(c->mac, mac, 6) == 0) {
+            asignar_payload(c, json);
+            c->cargada = true;
+        }
+        xSemaphoreGive(s_mutex);
+    }
+
+    ESP_LOGI(TAG, "💾 Configuración almacenada para %s", clave);
+    return ESP_OK;
+}
+
+void esfera_config_reset(void)
+{
+    xSemaphoreTake(s_mutex, portMAX_DELAY);
+    for (size_t i = 0; i < ESFERA_REGISTRY_MAX; i++) {
+        liberar(&s_cache[i]);
+    }
+    xSemaphoreGive(s_mutex);
+}
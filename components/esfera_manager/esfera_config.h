@@ -0,0 +1,52 @@
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdbool.h>
+#include "esp_err.h"
+#include "esfera_frame.h"
+
+#define ESFERA_CONFIG_MAX_LEN   250     // Cabe en una trama ESP-NOW
+
+/**
+ * @brief Inicializa la caché de configuraciones por esfera.
+ *
+ * @param mac_hub MAC del hub en texto, usada en la configuración estándar.
+ */
+void esfera_config_init(const char *mac_hub);
+
+/**
+ * @brief Decide si hay que enviarle la configuración a una esfera y, si es así,
+ *        copia el payload listo para ESP-NOW.
+ *
+ * La configuración se lee de NVS una sola vez por esfera y queda en RAM junto
+ * con su versión (hash). Si la trama informa la versión aplicada (v2) se envía
+ * solo cuando difiere; si no, se envía una vez por cada cambio de versión.
+ *
+ * @param indice Índice de la esfera en esfera_registry.
+ * @param lectura Lectura recién recibida (cfg_version si tiene_cfg).
+ * @param buf Destino del payload.
+ * @param len Entrada: tamaño de buf. Salida: bytes escritos.
+ * @param version Versión del payload copiado.
+ * @return true si hay que enviar buf.
+ */
+bool esfera_config_pendiente(uint16_t indice, const esfera_lectura_t *lectura,
+                             uint8_t *buf, size_t *len, uint32_t *version);
+
+/**
+ * @brief Registra que la versión fue entregada a la esfera.
+ */
+void esfera_config_marcar_enviada(uint16_t indice, uint32_t version);
+
+/**
+ * @brief Persiste la configuración recibida por MQTT y actualiza la caché.
+ *
+ * @param mac_txt MAC de la esfera ("A085E369D6AC", se aceptan ':').
+ * @param json Configuración serializada.
+ */
+esp_err_t esfera_config_guardar(const char *mac_txt, const char *json);
+
+/**
+ * @brief Descarta la caché (p.ej. tras borrar el namespace "config_store").
+ */
+void esfera_config_reset(void);
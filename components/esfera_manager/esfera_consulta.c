@@ -0,0 +1,132 @@
+#include "esfera_consulta.h"
+#include <stdlib.h>
+#include <string.h>
+#include "esp_log.h"
+#include "esfera_log.h"
+#include "esfera_json.h"
+
+static const char *TAG = "ESFERA_CONSULTA";
+
+typedef struct {
+    const esfera_consulta_t *consulta;
+    esfera_json_t *w;
+    size_t limite;
+    size_t cantidad;
+    bool truncada;
+} ejecucion_t;
+
+void esfera_consulta_default(esfera_consulta_t *consulta)
+{
+    memset(consulta, 0, sizeof(*consulta));
+    consulta->hasta = UINT32_MAX;
+    consulta->campos = ESFERA_CONSULTA_TODOS;
+}
+
+static bool coincide(const esfera_consulta_t *c, const esfera_data_t *e)
+{
+    if (e->epoch < c->desde || e->epoch > c->hasta) return false;
+    if (c->n_macs == 0) return true;
+    for (size_t i = 0; i < c->n_macs; i++) {
+        if (memcmp(c->macs[i], e->mac, sizeof(e->mac)) == 0) return true;
+    }
+    return false;
+}
+
+// Mismas claves y conversiones que el volcado de "Data", solo con los campos pedidos
+static void escribir_lectura(esfera_json_t *w, const esfera_data_t *e, uint8_t campos)
+{
+    char mac[13];
+    char timestamp[20];
+    esfera_data_formatear(e, mac, timestamp);
+
+    ESFERA_JSON_LIT(w, "{\"mac\":");
+    esfera_json_texto(w, mac);
+    if (campos & ESFERA_CONSULTA_HUMEDAD) {
+        ESFERA_JSON_LIT(w, ",\"humedad\":");
+        esfera_json_numero(w, e->humedad / 100.0f);
+    }
+    if (campos & ESFERA_CONSULTA_TEMPERATURA) {
+        ESFERA_JSON_LIT(w, ",\"temperatura\":");
+        esfera_json_numero(w, e->temperatura / 100.0f);
+    }
+    if (campos & ESFERA_CONSULTA_BATERIA) {
+        ESFERA_JSON_LIT(w, ",\"bateria\":");
+        esfera_json_numero(w, e->voltaje_mv / 1000.0f);
+    }
+    if (campos & ESFERA_CONSULTA_RIEGO) {
+        ESFERA_JSON_LIT(w, ",\"riego\":");
+        esfera_json_numero(w, e->riego);
+    }
+    ESFERA_JSON_LIT(w, ",\"timestamp\":");
+    esfera_json_texto(w, timestamp);
+    ESFERA_JSON_LIT(w, "}");
+}
+
+static bool visitar(const esfera_data_t *e, void *ctx)
+{
+    ejecucion_t *x = ctx;
+    if (!coincide(x->consulta, e)) return true;
+
+    // Una coincidencia más allá del límite solo marca la respuesta como truncada
+    if (x->cantidad == x->limite) {
+        x->truncada = true;
+        return false;
+    }
+    if (x->cantidad > 0) ESFERA_JSON_LIT(x->w, ",");
+    escribir_lectura(x->w, e, x->consulta->campos);
+    x->cantidad++;
+    return true;
+}
+
+char *esfera_consulta_generate_json(const esfera_consulta_t *consulta)
+{
+    size_t limite = consulta->limite;
+    if (limite == 0 || limite > ESFERA_CONSULTA_LIMITE_MAX) limite = ESFERA_CONSULTA_LIMITE_MAX;
+
+    size_t cap = 64 + limite * ESFERA_JSON_LECTURA_MAX;
+    char *json_string = malloc(cap + 1);
+    if (!json_string) {
+        ESP_LOGE(TAG, "❌ Error asignando %u bytes para JSON", (unsigned)(cap + 1));
+        return NULL;
+    }
+
+    esfera_consulta_t c = *consulta;
+    if (c.campos == 0) c.campos = ESFERA_CONSULTA_TODOS;
+    if (c.n_macs > ESFERA_CONSULTA_MACS) c.n_macs = ESFERA_CONSULTA_MACS;
+
+    esfera_json_t w;
+    esfera_json_init(&w, json_string, cap, NULL, NULL);
+    ejecucion_t x = { .consulta = &c, .w = &w, .limite = limite };
+
+    ESFERA_JSON_LIT(&w, "{\"Consulta\":[");
+    if (esfera_log_habilitado()) {
+        esfera_log_filtro_t filtro = { .desde = c.desde, .hasta = c.hasta };
+        for (size_t i = 0; i < c.n_macs; i++) {
+            filtro.bloom |= esfera_log_bloom(c.macs[i]);
+        }
+        esfera_log_recorrer(&filtro, c.descendente, visitar, &x);
+    } else {
+        // Una copia y no un snapshot: consultar no debe retener ni alterar lo pendiente
+        size_t n;
+        esfera_data_t *copia = esfera_manager_copiar(&n);
+        for (size_t i = 0; i < n; i++) {
+            if (!visitar(&copia[c.descendente ? n - 1 - i : i], &x)) break;
+        }
+        free(copia);
+    }
+    ESFERA_JSON_LIT(&w, "],\"Cantidad\":");
+    esfera_json_numero(&w, (double)x.cantidad);
+    if (x.truncada) {
+        ESFERA_JSON_LIT(&w, ",\"Truncada\":true}");
+    } else {
+        ESFERA_JSON_LIT(&w, ",\"Truncada\":false}");
+    }
+    if (esfera_json_fin(&w) != ESP_OK) {
+        free(json_string);
+        return NULL;
+    }
+    json_string[w.total] = '\0';
+
+    ESP_LOGI(TAG, "🔎 Consulta: %u lecturas%s", (unsigned)x.cantidad, x.truncada ? " (truncada)" : "");
+    return json_string;
+}
@@ -0,0 +1,45 @@
+#pragma once
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include "esfera_manager.h"
+
+#define ESFERA_CONSULTA_MACS        8       // MAC por consulta
+#define ESFERA_CONSULTA_LIMITE_MAX  100     // Lecturas por respuesta (~18 KB de JSON)
+
+// Campos a incluir en la respuesta (mac y timestamp van siempre)
+#define ESFERA_CONSULTA_HUMEDAD     (1 << 0)
+#define ESFERA_CONSULTA_TEMPERATURA (1 << 1)
+#define ESFERA_CONSULTA_BATERIA     (1 << 2)
+#define ESFERA_CONSULTA_RIEGO       (1 << 3)
+#define ESFERA_CONSULTA_TODOS       0x0F
+
+typedef struct {
+    uint8_t macs[ESFERA_CONSULTA_MACS][6];
+    size_t n_macs;          // 0 = todas las esferas
+    uint32_t desde;         // Epoch, inclusive
+    uint32_t hasta;         // Epoch, inclusive
+    uint8_t campos;         // ESFERA_CONSULTA_*; 0 = todos
+    size_t limite;          // Hasta ESFERA_CONSULTA_LIMITE_MAX (0 = máximo)
+    bool descendente;       // true: de la más nueva a la más vieja
+} esfera_consulta_t;
+
+/**
+ * @brief Consulta completa: todas las esferas, todo el rango, todos los campos.
+ */
+void esfera_consulta_default(esfera_consulta_t *consulta);
+
+/**
+ * @brief Ejecuta la consulta: {"Consulta":[...],"Cantidad":n,"Truncada":b}.
+ *
+ * Con el log en flash recorre todo lo guardado (publicado o no), salteando las
+ * páginas que por rango de epoch o MAC no pueden coincidir. Sin log solo se
+ * consulta el snapshot retenido del buffer en RAM. El orden es el de llegada
+ * al hub, salvo en el historial comprimido, donde cada grupo de páginas sale
+ * agrupado por esfera (ver esfera_log_recorrer). No modifica el buffer ni
+ * confirma lecturas.
+ *
+ * @return String a liberar con free(), o NULL sin memoria.
+ */
+char *esfera_consulta_generate_json(const esfera_consulta_t *consulta);
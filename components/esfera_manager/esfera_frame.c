@@ -0,0 +1,287 @@
+#include "esfera_frame.h"
+#include <string.h>
+#include "esp_log.h"
+
+static const char *TAG = "ESFERA_FRAME";
+
+static inline uint16_t leer_u16(const uint8_t *p)
+{
+    return (uint16_t)(p[0] | (p[1] << 8));
+}
+
+uint16_t esfera_frame_crc16(const uint8_t *data, size_t len)
+{
+    uint16_t crc = 0xFFFF;
+    for (size_t i = 0; i < len; i++) {
+        crc ^= (uint16_t)data[i] << 8;
+        for (int b = 0; b < 8; b++) {
+            crc = (crc & 0x8000) ? (uint16_t)((crc << 1) ^ 0x1021) : (uint16_t)(crc << 1);
+        }
+    }
+    return crc;
+}
+
+static inline uint32_t leer_u32(const uint8_t *p)
+{
+    return (uint32_t)leer_u16(p) | ((uint32_t)leer_u16(p + 2) << 16);
+}
+
+// v1 y v2 comparten el mismo prefijo de campos; v2 agrega cfg_version antes del CRC
+_Static_assert(offsetof(esfera_frame_v2_t, riego) == offsetof(esfera_frame_v1_t, riego), "prefijo v1/v2");
+
+static esp_err_t decode_binario(const uint8_t *data, size_t len, size_t esperado, size_t crc_off,
+                                const char *mac_origen, esfera_lectura_t *out)
+{
+    if (len != esperado) return ESP_ERR_INVALID_SIZE;
+    if (esfera_frame_crc16(data, crc_off) != leer_u16(&data[crc_off])) return ESP_ERR_INVALID_CRC;
+
+    out->tiene_seq = true;
+    out->seq = leer_u16(&data[offsetof(esfera_frame_v1_t, seq)]);
+    out->humedad = leer_u16(&data[offsetof(esfera_frame_v1_t, humedad)]);
+    out->temperatura = (int16_t)leer_u16(&data[offsetof(esfera_frame_v1_t, temperatura)]);
+    out->voltaje_mv = leer_u16(&data[offsetof(esfera_frame_v1_t, bateria_mv)]);
+    out->riego = data[offsetof(esfera_frame_v1_t, riego)] ? 1 : 0;
+    out->tiene_cfg = false;
+    out->cfg_version = 0;
+    out->edad_s = 0;
+    out->muestras = 1;
+    strncpy(out->mac, mac_origen, sizeof(out->mac) - 1);
+    out->mac[sizeof(out->mac) - 1] = '\0';
+    return ESP_OK;
+}
+
+static esp_err_t decode_v1(const uint8_t *data, size_t len, const char *mac_origen, esfera_lectura_t *out)
+{
+    return decode_binario(data, len, sizeof(esfera_frame_v1_t), offsetof(esfera_frame_v1_t, crc), mac_origen, out);
+}
+
+static esp_err_t decode_v2(const uint8_t *data, size_t len, const char *mac_origen, esfera_lectura_t *out)
+{
+    esp_err_t err = decode_binario(data, len, sizeof(esfera_frame_v2_t), offsetof(esfera_frame_v2_t, crc), mac_origen, out);
+    if (err == ESP_OK) {
+        out->tiene_cfg = true;
+        out->cfg_version = leer_u32(&data[offsetof(esfera_frame_v2_t, cfg_version)]);
+    }
+    return err;
+}
+
+static esp_err_t decode_v3(const uint8_t *data, size_t len, const char *mac_origen, esfera_lectura_t *out)
+{
+    if (len < sizeof(esfera_frame_v3_cab_t) + sizeof(uint16_t)) return ESP_ERR_INVALID_SIZE;
+
+    uint8_t n = data[offsetof(esfera_frame_v3_cab_t, n_muestras)];
+    size_t crc_off = sizeof(esfera_frame_v3_cab_t) + (size_t)n * sizeof(esfera_frame_v3_muestra_t);
+    if (n == 0 || len != crc_off + sizeof(uint16_t)) return ESP_ERR_INVALID_SIZE;
+    if (esfera_frame_crc16(data, crc_off) != leer_u16(&data[crc_off])) return ESP_ERR_INVALID_CRC;
+
+    out->tiene_seq = true;
+    out->tiene_cfg = true;
+    out->cfg_version = leer_u32(&data[offsetof(esfera_frame_v3_cab_t, cfg_version)]);
+    out->muestras = n;
+    strncpy(out->mac, mac_origen, sizeof(out->mac) - 1);
+    out->mac[sizeof(out->mac) - 1] = '\0';
+    esfera_frame_muestra(data, 0, out);
+    return ESP_OK;
+}
+
+void esfera_frame_muestra(const uint8_t *data, uint8_t i, esfera_lectura_t *out)
+{
+    const uint8_t *m = &data[sizeof(esfera_frame_v3_cab_t) + (size_t)i * sizeof(esfera_frame_v3_muestra_t)];
+    out->seq = (uint16_t)(leer_u16(&data[offsetof(esfera_frame_v3_cab_t, seq)]) + i);
+    out->edad_s = leer_u16(&m[offsetof(esfera_frame_v3_muestra_t, edad_s)]);
+    out->humedad = leer_u16(&m[offsetof(esfera_frame_v3_muestra_t, humedad)]);
+    out->temperatura = (int16_t)leer_u16(&m[offsetof(esfera_frame_v3_muestra_t, temperatura)]);
+    out->voltaje_mv = leer_u16(&m[offsetof(esfera_frame_v3_muestra_t, bateria_mv)]);
+    out->riego = m[offsetof(esfera_frame_v3_muestra_t, riego)] ? 1 : 0;
+}
+
+// ============================================================
+//   FORMATO TEXTO LEGADO: "h,t,v,r MAC"
+// ============================================================
+typedef struct {
+    const uint8_t *p;
+    size_t len;
+    size_t pos;
+} cursor_t;
+
+static const int32_t potencias_10[] = {1, 10, 100, 1000};
+
+static inline bool es_digito(uint8_t c)
+{
+    return c >= '0' && c <= '9';
+}
+
+static void saltar_espacios(cursor_t *c)
+{
+    while (c->pos < c->len && (c->p[c->pos] == ' ' || c->p[c->pos] == '\t')) c->pos++;
+}
+
+// Convierte "[-]ddd[.ddd]" a un entero escalado por 10^decimales. Los decimales
+// sobrantes se redondean (las esferas imprimen con "%f", es decir 6 decimales).
+static esfera_texto_err_t parse_fijo(cursor_t *c, int decimales, int32_t min, int32_t max, int32_t *out)
+{
+    saltar_espacios(c);
+
+    bool negativo = false;
+    if (c->pos < c->len && (c->p[c->pos] == '-' || c->p[c->pos] == '+')) {
+        negativo = c->p[c->pos] == '-';
+        c->pos++;
+    }
+
+    int32_t entero = 0;
+    int digitos = 0;
+    while (c->pos < c->len && es_digito(c->p[c->pos])) {
+        entero = entero * 10 + (c->p[c->pos] - '0');
+        if (entero > max && entero > -min) return ESFERA_TEXTO_ERR_RANGO;
+        c->pos++;
+        digitos++;
+    }
+
+    int32_t frac = 0;
+    int usados = 0;
+    bool redondeo = false;
+    if (decimales > 0 && c->pos < c->len && c->p[c->pos] == '.') {
+        c->pos++;
+        while (c->pos < c->len && es_digito(c->p[c->pos])) {
+            int d = c->p[c->pos] - '0';
+            if (usados < decimales) {
+                frac = frac * 10 + d;
+                usados++;
+            } else if (usados == decimales) {
+                redondeo = d >= 5;
+                usados++;
+            }
+            c->pos++;
+            digitos++;
+        }
+        if (usados > decimales) usados = decimales;
+    }
+
+    if (digitos == 0) return ESFERA_TEXTO_ERR_NUMERO;
+
+    int64_t valor = (int64_t)entero * potencias_10[decimales] +
+                    (int64_t)frac * potencias_10[decimales - usados] + (redondeo ? 1 : 0);
+    if (negativo) valor = -valor;
+    if (valor < min || valor > max) return ESFERA_TEXTO_ERR_RANGO;
+
+    *out = (int32_t)valor;
+    return ESFERA_TEXTO_OK;
+}
+
+static esfera_texto_err_t esperar(cursor_t *c, uint8_t sep)
+{
+    if (c->pos >= c->len || c->p[c->pos] != sep) return ESFERA_TEXTO_ERR_SEPARADOR;
+    c->pos++;
+    return ESFERA_TEXTO_OK;
+}
+
+static esfera_texto_err_t parse_mac(cursor_t *c, char mac[13])
+{
+    for (int i = 0; i < 12; i++) {
+        if (c->pos >= c->len) return ESFERA_TEXTO_ERR_MAC;
+        uint8_t ch = c->p[c->pos];
+        if (ch >= 'a' && ch <= 'f') ch -= 'a' - 'A';
+        if (!es_digito(ch) && !(ch >= 'A' && ch <= 'F')) return ESFERA_TEXTO_ERR_MAC;
+        mac[i] = (char)ch;
+        c->pos++;
+    }
+    mac[12] = '\0';
+
+    // Se toleran espacios, fin de línea o '\0' finales
+    while (c->pos < c->len) {
+        uint8_t ch = c->p[c->pos];
+        if (ch != ' ' && ch != '\t' && ch != '\r' && ch != '\n' && ch != '\0') return ESFERA_TEXTO_ERR_SOBRANTE;
+        c->pos++;
+    }
+    return ESFERA_TEXTO_OK;
+}
+
+esfera_texto_err_t esfera_frame_parse_texto(const uint8_t *data, size_t len, esfera_lectura_t *out, size_t *pos_error)
+{
+    cursor_t c = {.p = data, .len = len, .pos = 0};
+    int32_t h, t, v, r;
+    esfera_texto_err_t err;
+
+    if (len == 0) {
+        err = ESFERA_TEXTO_ERR_VACIO;
+    } else if ((err = parse_fijo(&c, 2, 0, UINT16_MAX, &h)) == ESFERA_TEXTO_OK &&
+               (err = esperar(&c, ',')) == ESFERA_TEXTO_OK &&
+               (err = parse_fijo(&c, 2, INT16_MIN, INT16_MAX, &t)) == ESFERA_TEXTO_OK &&
+               (err = esperar(&c, ',')) == ESFERA_TEXTO_OK &&
+               (err = parse_fijo(&c, 3, 0, UINT16_MAX, &v)) == ESFERA_TEXTO_OK &&
+               (err = esperar(&c, ',')) == ESFERA_TEXTO_OK &&
+               (err = parse_fijo(&c, 0, 0, 1, &r)) == ESFERA_TEXTO_OK &&
+               (err = esperar(&c, ' ')) == ESFERA_TEXTO_OK) {
+        saltar_espacios(&c);
+        err = parse_mac(&c, out->mac);
+    }
+
+    if (err != ESFERA_TEXTO_OK) {
+        if (pos_error) *pos_error = c.pos;
+        return err;
+    }
+
+    out->tiene_seq = false;
+    out->seq = 0;
+    out->tiene_cfg = false;
+    out->cfg_version = 0;
+    out->edad_s = 0;
+    out->muestras = 1;
+    out->humedad = (uint16_t)h;
+    out->temperatura = (int16_t)t;
+    out->voltaje_mv = (uint16_t)v;
+    out->riego = (uint8_t)r;
+    return ESFERA_TEXTO_OK;
+}
+
+const char *esfera_frame_texto_err_str(esfera_texto_err_t err)
+{
+    switch (err) {
+    case ESFERA_TEXTO_OK:            return "ok";
+    case ESFERA_TEXTO_ERR_VACIO:     return "trama vacía";
+    case ESFERA_TEXTO_ERR_NUMERO:    return "se esperaba un número";
+    case ESFERA_TEXTO_ERR_RANGO:     return "valor fuera de rango";
+    case ESFERA_TEXTO_ERR_SEPARADOR: return "separador faltante";
+    case ESFERA_TEXTO_ERR_MAC:       return "MAC inválida";
+    case ESFERA_TEXTO_ERR_SOBRANTE:  return "caracteres sobrantes";
+    default:                         return "desconocido";
+    }
+}
+
+esp_err_t esfera_frame_decode(const uint8_t *data, size_t len, const char *mac_origen, esfera_lectura_t *out)
+{
+    if (len == 0) {
+        ESP_LOGW(TAG, "⚠️ Trama vacía de %s", mac_origen);
+        return ESP_ERR_INVALID_SIZE;
+    }
+
+    esp_err_t err;
+    if (data[0] > ESFERA_FRAME_VERSION_MAX) {
+        size_t pos = 0;
+        esfera_texto_err_t terr = esfera_frame_parse_texto(data, len, out, &pos);
+        if (terr == ESFERA_TEXTO_OK) return ESP_OK;
+        ESP_LOGW(TAG, "⚠️ Formato inválido de %s en byte %u: %s (%.*s)",
+                 mac_origen, (unsigned)pos, esfera_frame_texto_err_str(terr), (int)len, (const char *)data);
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    switch (data[0]) {
+    case ESFERA_FRAME_V1:
+        err = decode_v1(data, len, mac_origen, out);
+        break;
+    case ESFERA_FRAME_V2:
+        err = decode_v2(data, len, mac_origen, out);
+        break;
+    case ESFERA_FRAME_V3:
+        err = decode_v3(data, len, mac_origen, out);
+        break;
+    default:
+        err = ESP_ERR_INVALID_VERSION;
+        break;
+    }
+
+    if (err != ESP_OK) {
+        ESP_LOGW(TAG, "⚠️ Trama v%u inválida de %s: %s", data[0], mac_origen, esp_err_to_name(err));
+    }
+    return err;
+}
@@ -0,0 +1,147 @@
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdbool.h>
+#include "esp_err.h"
+
+// El primer byte de la trama elige el decodificador: las tramas binarias
+// empiezan con un byte de versión < 0x20, que nunca aparece al inicio del
+// formato texto legado ("h,t,v,r MAC").
+#define ESFERA_FRAME_V1             0x01
+#define ESFERA_FRAME_V2             0x02
+#define ESFERA_FRAME_V3             0x03
+#define ESFERA_FRAME_VERSION_MAX    0x1F
+
+/**
+ * @brief Trama binaria v1 (little-endian, empaquetada, 12 bytes).
+ *
+ * La MAC no viaja en la trama: se toma de recv_info->src_addr.
+ * El CRC es CRC-16/CCITT-FALSE sobre todos los bytes anteriores.
+ */
+typedef struct __attribute__((packed)) {
+    uint8_t version;        // ESFERA_FRAME_V1
+    uint16_t seq;           // Número de secuencia de la esfera
+    uint16_t humedad;       // Centésimas de %
+    int16_t temperatura;    // Centésimas de °C
+    uint16_t bateria_mv;    // mV
+    uint8_t riego;          // 0 o 1
+    uint16_t crc;
+} esfera_frame_v1_t;
+
+_Static_assert(sizeof(esfera_frame_v1_t) == 12, "esfera_frame_v1_t debe medir 12 bytes");
+
+/**
+ * @brief Trama binaria v2 (16 bytes): v1 más la versión de configuración
+ *        que la esfera tiene aplicada ("cfgVer" de la última config recibida).
+ */
+typedef struct __attribute__((packed)) {
+    uint8_t version;        // ESFERA_FRAME_V2
+    uint16_t seq;
+    uint16_t humedad;
+    int16_t temperatura;
+    uint16_t bateria_mv;
+    uint8_t riego;
+    uint32_t cfg_version;   // 0 si la esfera no tiene configuración aplicada
+    uint16_t crc;
+} esfera_frame_v2_t;
+
+_Static_assert(sizeof(esfera_frame_v2_t) == 16, "esfera_frame_v2_t debe medir 16 bytes");
+
+/**
+ * @brief Trama binaria v3: varias muestras por transmisión.
+ *
+ * Cabecera + n_muestras * esfera_frame_v3_muestra_t + CRC-16 final. La muestra
+ * i lleva la secuencia seq + i. Con ESP-NOW v2 entran hasta
+ * ESFERA_FRAME_V3_MAX_MUESTRAS muestras; con v1 (250 bytes), hasta 26.
+ */
+typedef struct __attribute__((packed)) {
+    uint8_t version;        // ESFERA_FRAME_V3
+    uint16_t seq;           // Secuencia de la primera muestra
+    uint32_t cfg_version;
+    uint8_t n_muestras;
+} esfera_frame_v3_cab_t;
+
+typedef struct __attribute__((packed)) {
+    uint16_t edad_s;        // Segundos entre la medición y el envío
+    uint16_t humedad;
+    int16_t temperatura;
+    uint16_t bateria_mv;
+    uint8_t riego;
+} esfera_frame_v3_muestra_t;
+
+#define ESFERA_FRAME_V3_MAX_MUESTRAS \
+    ((1470 - sizeof(esfera_frame_v3_cab_t) - sizeof(uint16_t)) / sizeof(esfera_frame_v3_muestra_t))
+
+_Static_assert(sizeof(esfera_frame_v3_cab_t) == 8, "esfera_frame_v3_cab_t debe medir 8 bytes");
+_Static_assert(sizeof(esfera_frame_v3_muestra_t) == 9, "esfera_frame_v3_muestra_t debe medir 9 bytes");
+
+/**
+ * @brief Lectura decodificada, independiente del formato de origen.
+ */
+typedef struct {
+    uint16_t humedad;       // Centésimas de %
+    int16_t temperatura;    // Centésimas de °C
+    uint16_t voltaje_mv;
+    uint8_t riego;
+    bool tiene_seq;         // Solo las tramas binarias traen secuencia
+    uint16_t seq;
+    bool tiene_cfg;         // Solo las tramas v2 y v3 informan la configuración aplicada
+    uint32_t cfg_version;
+    uint16_t edad_s;        // Antigüedad de la muestra al enviarse (v3)
+    uint8_t muestras;       // Muestras en la trama (> 1 solo en v3)
+    char mac[13];           // "A085E369D6AC"
+} esfera_lectura_t;
+
+/**
+ * @brief Resultado del parser del formato texto legado.
+ */
+typedef enum {
+    ESFERA_TEXTO_OK = 0,
+    ESFERA_TEXTO_ERR_VACIO,         // Trama vacía
+    ESFERA_TEXTO_ERR_NUMERO,        // Se esperaba un número
+    ESFERA_TEXTO_ERR_RANGO,         // Valor fuera del rango del campo
+    ESFERA_TEXTO_ERR_SEPARADOR,     // Falta ',' o el espacio antes de la MAC
+    ESFERA_TEXTO_ERR_MAC,           // MAC ausente o con caracteres no hexadecimales
+    ESFERA_TEXTO_ERR_SOBRANTE,      // Caracteres extra después de la MAC
+} esfera_texto_err_t;
+
+/**
+ * @brief Parser de una pasada para "h,t,v,r MAC" sobre un buffer acotado.
+ *
+ * No reserva memoria, no requiere '\0' final y convierte los decimales
+ * directamente a punto fijo (redondeando al último decimal soportado).
+ * El riego solo admite 0 o 1, igual que en las tramas binarias.
+ *
+ * @param data Payload en texto.
+ * @param len Longitud del payload.
+ * @param out Lectura decodificada (solo válida si devuelve ESFERA_TEXTO_OK).
+ * @param pos_error Opcional: posición del byte donde se detectó el error.
+ */
+esfera_texto_err_t esfera_frame_parse_texto(const uint8_t *data, size_t len, esfera_lectura_t *out, size_t *pos_error);
+
+const char *esfera_frame_texto_err_str(esfera_texto_err_t err);
+
+/**
+ * @brief Decodifica una trama de esfera eligiendo el formato por el primer byte.
+ *
+ * @param data Trama recibida (no necesita terminar en '\0').
+ * @param len Longitud de la trama.
+ * @param mac_origen MAC de origen en texto, usada por las tramas binarias.
+ * @param out Lectura decodificada.
+ * @return ESP_OK, ESP_ERR_INVALID_SIZE, ESP_ERR_INVALID_CRC,
+ *         ESP_ERR_INVALID_VERSION o ESP_ERR_INVALID_ARG (texto mal formado).
+ *         Los errores se registran en el log con el detalle del fallo.
+ *
+ * En tramas v3 valida la trama completa y deja en out la muestra 0; las
+ * restantes (out->muestras - 1) se obtienen con esfera_frame_muestra().
+ */
+esp_err_t esfera_frame_decode(const uint8_t *data, size_t len, const char *mac_origen, esfera_lectura_t *out);
+
+/**
+ * @brief Carga en out la muestra i de una trama v3 ya validada por esfera_frame_decode.
+ *        Conserva MAC y versión de configuración de out.
+ */
+void esfera_frame_muestra(const uint8_t *data, uint8_t i, esfera_lectura_t *out);
+
+uint16_t esfera_frame_crc16(const uint8_t *data, size_t len);
@@ -0,0 +1,88 @@
+#include "esfera_json.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <float.h>
+#include <limits.h>
+
+void esfera_json_init(esfera_json_t *w, char *buf, size_t cap, esfera_json_salida_t salida, void *ctx)
+{
+    w->buf = buf;
+    w->cap = cap;
+    w->len = 0;
+    w->total = 0;
+    w->salida = salida;
+    w->ctx = ctx;
+    w->err = ESP_OK;
+}
+
+static void vaciar(esfera_json_t *w)
+{
+    if (w->len && w->salida && w->err == ESP_OK) {
+        w->err = w->salida(w->buf, w->len, w->ctx);
+    }
+    w->len = 0;
+}
+
+void esfera_json_raw(esfera_json_t *w, const char *s, size_t n)
+{
+    w->total += n;
+    if (!w->buf || w->err != ESP_OK) return;
+
+    while (n) {
+        if (w->len == w->cap) {
+            if (!w->salida) {
+                w->err = ESP_ERR_INVALID_SIZE;
+                return;
+            }
+            vaciar(w);
+            if (w->err != ESP_OK) return;
+        }
+        size_t m = w->cap - w->len < n ? w->cap - w->len : n;
+        memcpy(w->buf + w->len, s, m);
+        w->len += m;
+        s += m;
+        n -= m;
+    }
+}
+
+void esfera_json_texto(esfera_json_t *w, const char *s)
+{
+    esfera_json_raw(w, "\"", 1);
+    esfera_json_raw(w, s, strlen(s));
+    esfera_json_raw(w, "\"", 1);
+}
+
+// Misma lógica que print_number de cJSON para que la salida sea idéntica
+void esfera_json_numero(esfera_json_t *w, double d)
+{
+    char num[26];
+    int len;
+    int entero = d >= INT_MAX ? INT_MAX : d <= (double)INT_MIN ? INT_MIN : (int)d;
+
+    if (isnan(d) || isinf(d)) {
+        len = snprintf(num, sizeof(num), "null");
+    } else if (d == (double)entero) {
+        len = snprintf(num, sizeof(num), "%d", entero);
+    } else {
+        // 15 dígitos si alcanzan para recuperar el valor, si no 17
+        len = snprintf(num, sizeof(num), "%1.15g", d);
+        double test = strtod(num, NULL);
+        double max = fabs(test) > fabs(d) ? fabs(test) : fabs(d);
+        if (!(fabs(test - d) <= max * DBL_EPSILON)) {
+            len = snprintf(num, sizeof(num), "%1.17g", d);
+        }
+    }
+    if (len < 0 || len >= (int)sizeof(num)) {
+        w->err = ESP_FAIL;
+        return;
+    }
+    esfera_json_raw(w, num, (size_t)len);
+}
+
+esp_err_t esfera_json_fin(esfera_json_t *w)
+{
+    vaciar(w);
+    return w->err;
+}
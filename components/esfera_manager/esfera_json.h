@@ -0,0 +1,56 @@
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdbool.h>
+#include "esp_err.h"
+
+/**
+ * @brief Cota de una lectura serializada: 104 bytes fijos (claves, MAC,
+ *        timestamp, separadores) + 3 números de hasta 25 caracteres + riego.
+ */
+#define ESFERA_JSON_LECTURA_MAX    180
+
+/**
+ * @brief Escribe un literal de texto sin calcular su largo en tiempo de ejecución.
+ */
+#define ESFERA_JSON_LIT(w, s) esfera_json_raw((w), (s), sizeof(s) - 1)
+
+/**
+ * @brief Recibe cada tramo de salida cuando se llena el buffer y al final.
+ */
+typedef esp_err_t (*esfera_json_salida_t)(const char *datos, size_t len, void *ctx);
+
+/**
+ * @brief Escritor JSON en streaming sobre un buffer provisto por quien llama.
+ *
+ * No arma árbol ni reasigna memoria. Si no hay salida, el buffer debe alcanzar
+ * para todo el documento; con buf NULL y cap 0 solo se cuentan bytes.
+ * Los números se formatean igual que cJSON_PrintUnformatted.
+ */
+typedef struct {
+    char *buf;
+    size_t cap;
+    size_t len;             // Bytes en buf sin entregar
+    size_t total;           // Bytes producidos en total
+    esfera_json_salida_t salida;
+    void *ctx;
+    esp_err_t err;          // Primer error; el resto de las escrituras se ignora
+} esfera_json_t;
+
+void esfera_json_init(esfera_json_t *w, char *buf, size_t cap, esfera_json_salida_t salida, void *ctx);
+
+void esfera_json_raw(esfera_json_t *w, const char *s, size_t n);
+
+/**
+ * @brief Escribe "texto" sin escapar: solo para textos generados por el hub (MAC, fechas).
+ */
+void esfera_json_texto(esfera_json_t *w, const char *s);
+
+void esfera_json_numero(esfera_json_t *w, double d);
+
+/**
+ * @brief Entrega lo pendiente a la salida.
+ * @return Primer error ocurrido, o ESP_OK.
+ */
+esp_err_t esfera_json_fin(esfera_json_t *w);
@@ -0,0 +1,813 @@
+#include "esfera_log.h"
+#include <stdlib.h>
+#include <string.h>
+#include <inttypes.h>
+#include "esp_log.h"
+#include "esp_partition.h"
+#include "esp_timer.h"
+#include "nvs_flash.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/semphr.h"
+#include "esfera_frame.h"
+#include "esfera_codec.h"
+
+#define LOG_NS          "esfera_log"
+#define LOG_NS_ACK      "ack"
+#define PAGINA          4096        // Un sector de flash
+#define CABECERA        32          // Espacio reservado a la cabecera de página
+#define MAGIC           0x474F4C45  // "ELOG"
+#define MAGIC_HIST      0x53494845  // "EHIS"
+#define FORMATO         2           // 2: anillo crudo + historial comprimido
+#define MARCA           0xA5        // Slot escrito; un slot borrado queda en 0xFF
+#define LIBRE           0xFFFF      // Largo de un registro de historial aún borrado
+#define LEER_SLOTS      16          // Slots por lectura de flash al recorrer
+
+static const char *TAG = "ESFERA_LOG";
+
+typedef struct {
+    uint32_t magic;
+    uint32_t primer_id;     // Id del slot 0 (historial: número de página); orden circular
+    uint16_t formato;
+    uint16_t crc;           // CRC-16 de los campos anteriores
+} cabecera_t;
+
+// Resumen de la página para podar consultas; se escribe sobre el área aún
+// borrada de la cabecera al cerrar la página. Sin resumen la página se recorre.
+typedef struct {
+    uint32_t epoch_min;
+    uint32_t epoch_max;
+    uint64_t bloom;         // Bit esfera_log_bloom(mac) de cada lectura
+    uint16_t crc;           // CRC-16 de los campos anteriores
+    uint16_t reservado;
+} __attribute__((packed)) resumen_t;
+
+#define OFFSET_RESUMEN  sizeof(cabecera_t)
+
+typedef struct {
+    esfera_data_t dato;
+    uint16_t crc;           // CRC-16 de dato
+    uint8_t marca;
+    uint8_t reservado;
+} slot_t;
+
+#define SLOTS   ((PAGINA - CABECERA) / sizeof(slot_t))
+
+// Registro del historial: un bloque de esfera_codec de una esfera, por epoch
+typedef struct {
+    uint16_t largo;         // Bytes del bloque que sigue; LIBRE = fin de lo escrito
+    uint16_t crc;           // CRC-16 de hasta_id y el bloque
+    uint32_t hasta_id;      // Las lecturas crudas con id menor ya están comprimidas
+} registro_t;
+
+#define REGISTROS_MAX   ((PAGINA - CABECERA) / (sizeof(registro_t) + sizeof(esfera_codec_cabecera_t)))
+#define DATOS_MAX       (SLOTS > ESFERA_CODEC_MAX_MUESTRAS ? SLOTS : ESFERA_CODEC_MAX_MUESTRAS)
+
+_Static_assert(OFFSET_RESUMEN + sizeof(resumen_t) <= CABECERA, "El resumen no entra en la cabecera");
+_Static_assert(sizeof(slot_t) == 24, "slot_t debe medir 24 bytes");
+
+static const esp_partition_t *s_part;
+static uint32_t s_paginas;
+static uint32_t s_crudas;           // Páginas del anillo crudo; las siguientes son historial
+static uint32_t s_pagina;           // Página en escritura
+static uint32_t s_primer_id;        // primer_id de s_pagina
+static uint32_t s_slot;             // Próximo slot libre de s_pagina
+static uint32_t s_min_id;           // Lectura más antigua que sigue en flash
+static uint32_t s_ack;              // Lecturas con id menor ya publicadas
+static uint32_t s_ack_nvs;          // Último s_ack persistido
+static int64_t s_ack_nvs_us;        // Momento de ese commit
+static resumen_t s_resumen;         // Resumen en curso de s_pagina
+
+static bool s_hist_hay;             // Hay una página de historial abierta
+static uint32_t s_hist_num;         // Número de la página de historial en escritura
+static uint32_t s_hist_min;         // Número de la más antigua que sigue en flash
+static uint32_t s_hist_offset;      // Próximo byte libre de s_hist_num
+static resumen_t s_hist_resumen;
+static uint32_t s_archivado;        // Lecturas con id menor ya comprimidas al historial
+
+static esfera_data_t s_lote[ESFERA_LOG_LOTE];
+static uint32_t s_lote_n;
+static int64_t s_lote_desde_us;
+
+static esfera_log_stats_t s_stats;
+static SemaphoreHandle_t s_mutex;
+
+static inline uint32_t siguiente_id(void)
+{
+    return s_primer_id + s_slot;
+}
+
+static inline size_t offset_slot(uint32_t pagina, uint32_t slot)
+{
+    return (size_t)pagina * PAGINA + CABECERA + slot * sizeof(slot_t);
+}
+
+static bool leer_cabecera(uint32_t pagina, uint32_t magic, cabecera_t *cab)
+{
+    if (esp_partition_read(s_part, (size_t)pagina * PAGINA, cab, sizeof(*cab)) != ESP_OK) {
+        s_stats.errores++;
+        return false;
+    }
+    return cab->magic == magic && cab->formato == FORMATO &&
+           cab->crc == esfera_frame_crc16((const uint8_t *)cab, offsetof(cabecera_t, crc));
+}
+
+uint64_t esfera_log_bloom(const uint8_t mac[6])
+{
+    uint32_t h = 2166136261u;
+    for (int i = 0; i < 6; i++) {
+        h ^= mac[i];
+        h *= 16777619u;
+    }
+    return 1ULL << (h % 64);
+}
+
+static void resumen_vacio(resumen_t *r)
+{
+    r->epoch_min = UINT32_MAX;
+    r->epoch_max = 0;
+    r->bloom = 0;
+}
+
+static void resumen_sumar(resumen_t *r, const esfera_data_t *d)
+{
+    if (d->epoch < r->epoch_min) r->epoch_min = d->epoch;
+    if (d->epoch > r->epoch_max) r->epoch_max = d->epoch;
+    r->bloom |= esfera_log_bloom(d->mac);
+}
+
+static bool resumen_descarta(const resumen_t *r, const esfera_log_filtro_t *filtro)
+{
+    return r->epoch_max < filtro->desde || r->epoch_min > filtro->hasta ||
+           (filtro->bloom && !(r->bloom & filtro->bloom));
+}
+
+static void cerrar_pagina(uint32_t pagina, resumen_t *r)
+{
+    r->crc = esfera_frame_crc16((const uint8_t *)r, offsetof(resumen_t, crc));
+    r->reservado = 0xFFFF;
+    if (esp_partition_write(s_part, (size_t)pagina * PAGINA + OFFSET_RESUMEN, r, sizeof(*r)) != ESP_OK) {
+        s_stats.errores++;
+    }
+}
+
+static bool leer_resumen(uint32_t pagina, resumen_t *r)
+{
+    if (esp_partition_read(s_part, (size_t)pagina * PAGINA + OFFSET_RESUMEN, r, sizeof(*r)) != ESP_OK) {
+        s_stats.errores++;
+        return false;
+    }
+    return r->crc == esfera_frame_crc16((const uint8_t *)r, offsetof(resumen_t, crc));
+}
+
+static bool slot_valido(const slot_t *s)
+{
+    return s->marca == MARCA && s->crc == esfera_frame_crc16((const uint8_t *)&s->dato, sizeof(s->dato));
+}
+
+// Página (física) que contiene el id, que debe estar entre s_min_id y siguiente_id()
+static inline uint32_t pagina_de(uint32_t id)
+{
+    uint32_t atras = s_primer_id / SLOTS - id / SLOTS;
+    return (s_pagina + s_crudas - atras) % s_crudas;
+}
+
+static void persistir_ack(void)
+{
+    // Aun si falla se espera al próximo plazo para no reintentar en cada confirmación
+    s_ack_nvs = s_ack;
+    s_ack_nvs_us = esp_timer_get_time();
+
+    nvs_handle_t handle;
+    if (nvs_open(LOG_NS, NVS_READWRITE, &handle) != ESP_OK) return;
+    if (nvs_set_u32(handle, LOG_NS_ACK, s_ack) == ESP_OK && nvs_commit(handle) == ESP_OK) {
+        s_stats.commits_ack++;
+    }
+    nvs_close(handle);
+}
+
+// Un commit por confirmación gastaría la NVS a la tasa de publicación; se
+// acota a uno por página confirmada o por ESFERA_LOG_ACK_MS
+static void persistir_ack_si_vence(bool forzar)
+{
+    if (s_ack == s_ack_nvs) return;
+    if (forzar || s_ack - s_ack_nvs >= SLOTS ||
+        esp_timer_get_time() - s_ack_nvs_us >= ESFERA_LOG_ACK_MS * 1000LL) {
+        persistir_ack();
+    }
+}
+
+// ============================================================
+//   HISTORIAL COMPRIMIDO
+// ============================================================
+// Antes de reciclar una página cruda, su grupo de ESFERA_LOG_GRUPO páginas se
+// agrupa por esfera y se escribe con esfera_codec en las páginas de historial,
+// que a su vez se reciclan en orden circular. Agrupar varias páginas da bloques
+// largos por esfera, que es donde el codec comprime.
+static inline bool historial_habilitado(void)
+{
+    return s_crudas < s_paginas;
+}
+
+static inline uint32_t hist_fisica(uint32_t num)
+{
+    return s_crudas + num % (s_paginas - s_crudas);
+}
+
+static void abrir_historial(uint32_t num)
+{
+    if (s_hist_hay) cerrar_pagina(hist_fisica(s_hist_num), &s_hist_resumen);
+    if (!s_hist_hay) s_hist_min = num;
+    else if (num - s_hist_min >= s_paginas - s_crudas) s_hist_min = num - (s_paginas - s_crudas) + 1;
+
+    uint32_t pagina = hist_fisica(num);
+    esp_err_t err = esp_partition_erase_range(s_part, (size_t)pagina * PAGINA, PAGINA);
+    if (err == ESP_OK) {
+        s_stats.borrados++;
+        cabecera_t cab = { .magic = MAGIC_HIST, .primer_id = num, .formato = FORMATO };
+        cab.crc = esfera_frame_crc16((const uint8_t *)&cab, offsetof(cabecera_t, crc));
+        err = esp_partition_write(s_part, (size_t)pagina * PAGINA, &cab, sizeof(cab));
+    }
+    if (err != ESP_OK) {
+        s_stats.errores++;
+        ESP_LOGE(TAG, "❌ Error abriendo página de historial %" PRIu32 ": %s", pagina, esp_err_to_name(err));
+    }
+
+    s_hist_hay = true;
+    s_hist_num = num;
+    s_hist_offset = err == ESP_OK ? CABECERA : PAGINA;
+    resumen_vacio(&s_hist_resumen);
+}
+
+// Agrega lecturas de una esfera ordenadas por epoch, en bloques que entren en
+// lo que queda de la página. rec tiene lugar para un registro del bloque más largo.
+static void archivar(const esfera_data_t *datos, size_t n, uint32_t hasta_id, uint8_t *rec)
+{
+    uint8_t *bloque = rec + sizeof(registro_t);
+    while (n > 0) {
+        size_t m = n < ESFERA_CODEC_MAX_MUESTRAS ? n : ESFERA_CODEC_MAX_MUESTRAS;
+        size_t largo;
+        if (esfera_codec_codificar(datos, m, bloque, esfera_codec_max_largo(m), &largo) != ESP_OK) {
+            s_stats.errores++;
+            return;
+        }
+
+        // Si no entra se prueba con la parte proporcional antes de pasar de página
+        size_t cap = 0;
+        if (s_hist_hay && s_hist_offset + sizeof(registro_t) < PAGINA) cap = PAGINA - s_hist_offset - sizeof(registro_t);
+        if (largo > cap) {
+            size_t parte = m * cap / largo;
+            if (parte == 0 || esfera_codec_codificar(datos, parte, bloque, cap, &largo) != ESP_OK) {
+                abrir_historial(s_hist_hay ? s_hist_num + 1 : 0);
+                if (s_hist_offset == PAGINA) return;
+                continue;
+            }
+            m = parte;
+        }
+
+        registro_t reg = { .largo = (uint16_t)largo, .hasta_id = hasta_id };
+        memcpy(rec, &reg, sizeof(reg));
+        reg.crc = esfera_frame_crc16(rec + offsetof(registro_t, hasta_id), sizeof(reg.hasta_id) + largo);
+        memcpy(rec, &reg, sizeof(reg));
+
+        size_t offset = (size_t)hist_fisica(s_hist_num) * PAGINA + s_hist_offset;
+        if (esp_partition_write(s_part, offset, rec, sizeof(reg) + largo) != ESP_OK) {
+            s_stats.errores++;
+            s_hist_offset = PAGINA;     // Lo que siga va a la próxima página
+            return;
+        }
+        s_hist_offset += sizeof(reg) + largo;
+        s_stats.archivadas += m;
+        s_stats.bytes_historial += sizeof(reg) + largo;
+        for (size_t i = 0; i < m; i++) resumen_sumar(&s_hist_resumen, &datos[i]);
+        datos += m;
+        n -= m;
+    }
+}
+
+static int comparar_mac_epoch(const void *a, const void *b)
+{
+    const esfera_data_t *x = a, *y = b;
+    int c = memcmp(x->mac, y->mac, sizeof(x->mac));
+    if (c != 0) return c;
+    return (x->epoch > y->epoch) - (x->epoch < y->epoch);
+}
+
+// Comprime las páginas crudas del grupo de num que aún no estén en el historial
+static void compactar(uint32_t num)
+{
+    uint32_t desde = num;
+    if (desde < s_archivado / SLOTS) desde = s_archivado / SLOTS;
+    if (desde < s_min_id / SLOTS) desde = s_min_id / SLOTS;
+    uint32_t hasta = (num / ESFERA_LOG_GRUPO + 1) * ESFERA_LOG_GRUPO;
+    if (hasta > s_primer_id / SLOTS + 1) hasta = s_primer_id / SLOTS + 1;
+    if (desde >= hasta) return;
+
+    esfera_data_t *datos = malloc(ESFERA_LOG_GRUPO * SLOTS * sizeof(esfera_data_t));
+    uint8_t *rec = malloc(sizeof(registro_t) + esfera_codec_max_largo(ESFERA_CODEC_MAX_MUESTRAS));
+    if (datos && rec) {
+        size_t n = 0;
+        slot_t buf[LEER_SLOTS];
+        for (uint32_t k = desde; k < hasta; k++) {
+            uint32_t pagina = pagina_de(k * SLOTS);
+            for (uint32_t base = 0; base < SLOTS; base += LEER_SLOTS) {
+                uint32_t m = SLOTS - base < LEER_SLOTS ? SLOTS - base : LEER_SLOTS;
+                if (esp_partition_read(s_part, offset_slot(pagina, base), buf, m * sizeof(slot_t)) != ESP_OK) {
+                    s_stats.errores++;
+                    break;
+                }
+                for (uint32_t j = 0; j < m; j++) {
+                    if (slot_valido(&buf[j])) datos[n++] = buf[j].dato;
+                }
+            }
+        }
+
+        qsort(datos, n, sizeof(esfera_data_t), comparar_mac_epoch);
+        for (size_t i = 0; i < n;) {
+            size_t j = i + 1;
+            while (j < n && memcmp(datos[j].mac, datos[i].mac, sizeof(datos[i].mac)) == 0) j++;
+            archivar(&datos[i], j - i, hasta * SLOTS, rec);
+            i = j;
+        }
+        ESP_LOGD(TAG, "Historial: %u lecturas de %" PRIu32 " páginas comprimidas", (unsigned)n, hasta - desde);
+    } else {
+        ESP_LOGW(TAG, "⚠️ Sin memoria para comprimir %" PRIu32 " páginas al historial", hasta - desde);
+    }
+    free(datos);
+    free(rec);
+    // Aun sin memoria se avanza: reintentar en cada página frenaría la ingesta
+    s_archivado = hasta * SLOTS;
+}
+
+// Registros de una página de historial copiada en RAM; los de CRC inválido
+// (escritura cortada) se saltean. Devuelve el primer byte libre.
+static size_t registros_de(const uint8_t *pag, uint16_t offsets[REGISTROS_MAX], size_t *n)
+{
+    size_t offset = CABECERA;
+    *n = 0;
+    while (offset + sizeof(registro_t) <= PAGINA) {
+        registro_t reg;
+        memcpy(&reg, pag + offset, sizeof(reg));
+        if (reg.largo == LIBRE) return offset;
+        size_t fin = offset + sizeof(reg) + reg.largo;
+        if (fin > PAGINA) break;
+        if (*n < REGISTROS_MAX &&
+            reg.crc == esfera_frame_crc16(pag + offset + offsetof(registro_t, hasta_id), sizeof(reg.hasta_id) + reg.largo)) {
+            offsets[(*n)++] = (uint16_t)offset;
+        }
+        offset = fin;
+    }
+    return PAGINA;
+}
+
+// La página en escritura del historial: dónde seguir, su resumen y hasta qué
+// id se comprimió (si está vacía, de la anterior)
+static void recuperar_historial(void)
+{
+    s_hist_hay = false;
+    s_archivado = 0;
+    if (!historial_habilitado()) return;
+
+    uint32_t max_num = 0, min_num = 0;
+    for (uint32_t p = s_crudas; p < s_paginas; p++) {
+        cabecera_t cab;
+        if (!leer_cabecera(p, MAGIC_HIST, &cab)) continue;
+        if (!s_hist_hay || cab.primer_id > max_num) max_num = cab.primer_id;
+        if (!s_hist_hay || cab.primer_id < min_num) min_num = cab.primer_id;
+        s_hist_hay = true;
+    }
+    if (!s_hist_hay) return;
+    s_hist_num = max_num;
+    s_hist_min = min_num;
+    s_hist_offset = PAGINA;
+    resumen_vacio(&s_hist_resumen);
+
+    uint8_t *pag = malloc(PAGINA);
+    if (!pag) return;
+    uint16_t offsets[REGISTROS_MAX];
+    for (uint32_t num = max_num; ; num--) {
+        size_t n = 0;
+        if (esp_partition_read(s_part, (size_t)hist_fisica(num) * PAGINA, pag, PAGINA) != ESP_OK) {
+            s_stats.errores++;
+        } else {
+            size_t libre = registros_de(pag, offsets, &n);
+            if (num == max_num) s_hist_offset = libre;
+        }
+        for (size_t i = 0; i < n; i++) {
+            registro_t reg;
+            memcpy(&reg, pag + offsets[i], sizeof(reg));
+            if (reg.hasta_id > s_archivado) s_archivado = reg.hasta_id;
+
+            esfera_codec_cabecera_t cab;
+            if (num != max_num || esfera_codec_cabecera(pag + offsets[i] + sizeof(reg), reg.largo, &cab) != ESP_OK) continue;
+            esfera_data_t extremo = { .epoch = cab.epoch_ini };
+            memcpy(extremo.mac, cab.mac, sizeof(extremo.mac));
+            resumen_sumar(&s_hist_resumen, &extremo);
+            extremo.epoch = cab.epoch_fin;
+            resumen_sumar(&s_hist_resumen, &extremo);
+        }
+        if (n > 0 || num == min_num) break;
+    }
+    free(pag);
+}
+
+// Sin log crudo los ids vuelven a empezar: el historial anterior no se puede
+// ubicar respecto de ellos, así que se invalidan sus cabeceras (sin borrar)
+static void descartar_historial(void)
+{
+    for (uint32_t p = s_crudas; p < s_paginas; p++) {
+        cabecera_t cab;
+        if (!leer_cabecera(p, MAGIC_HIST, &cab)) continue;
+        uint32_t cero = 0;
+        if (esp_partition_write(s_part, (size_t)p * PAGINA, &cero, sizeof(cero)) != ESP_OK) s_stats.errores++;
+    }
+    s_hist_hay = false;
+    s_archivado = 0;
+}
+
+static esp_err_t abrir_pagina(uint32_t pagina, uint32_t primer_id)
+{
+    // Al reciclar la página más antigua se pierden sus lecturas sin confirmar
+    cabecera_t vieja;
+    if (leer_cabecera(pagina, MAGIC, &vieja)) {
+        // Antes de reciclarla, la página (y el resto de su grupo) pasa al historial
+        if (historial_habilitado() && s_archivado < vieja.primer_id + SLOTS) compactar(vieja.primer_id / SLOTS);
+
+        uint32_t fin = vieja.primer_id + SLOTS;
+        if (fin > s_ack) {
+            uint32_t desde = vieja.primer_id > s_ack ? vieja.primer_id : s_ack;
+            s_stats.perdidas += fin - desde;
+            ESP_LOGW(TAG, "⚠️ Log lleno: se pisan %" PRIu32 " lecturas sin publicar", fin - desde);
+            s_ack = fin;
+            persistir_ack();
+        }
+        if (fin > s_min_id) s_min_id = fin;
+    }
+
+    esp_err_t err = esp_partition_erase_range(s_part, (size_t)pagina * PAGINA, PAGINA);
+    if (err == ESP_OK) {
+        s_stats.borrados++;
+        cabecera_t cab = { .magic = MAGIC, .primer_id = primer_id, .formato = FORMATO };
+        cab.crc = esfera_frame_crc16((const uint8_t *)&cab, offsetof(cabecera_t, crc));
+        err = esp_partition_write(s_part, (size_t)pagina * PAGINA, &cab, sizeof(cab));
+    }
+    if (err != ESP_OK) {
+        s_stats.errores++;
+        ESP_LOGE(TAG, "❌ Error abriendo página %" PRIu32 ": %s", pagina, esp_err_to_name(err));
+    }
+
+    // Aun con error se avanza: la página queda inválida y se reintenta en la próxima vuelta
+    s_pagina = pagina;
+    s_primer_id = primer_id;
+    s_slot = 0;
+    resumen_vacio(&s_resumen);
+    return err;
+}
+
+static void escribir_lote(void)
+{
+    slot_t buf[ESFERA_LOG_LOTE];
+    uint32_t i = 0;
+
+    while (i < s_lote_n) {
+        if (s_slot == SLOTS) {
+            cerrar_pagina(s_pagina, &s_resumen);
+            abrir_pagina((s_pagina + 1) % s_crudas, s_primer_id + SLOTS);
+        }
+
+        // Tramo contiguo dentro de la página actual
+        uint32_t n = s_lote_n - i;
+        if (n > SLOTS - s_slot) n = SLOTS - s_slot;
+        for (uint32_t j = 0; j < n; j++) {
+            buf[j].dato = s_lote[i + j];
+            buf[j].crc = esfera_frame_crc16((const uint8_t *)&buf[j].dato, sizeof(buf[j].dato));
+            buf[j].marca = MARCA;
+            buf[j].reservado = 0xFF;
+            resumen_sumar(&s_resumen, &buf[j].dato);
+        }
+
+        esp_err_t err = esp_partition_write(s_part, offset_slot(s_pagina, s_slot), buf, n * sizeof(slot_t));
+        if (err != ESP_OK) {
+            s_stats.errores++;
+            ESP_LOGE(TAG, "❌ Error escribiendo %" PRIu32 " lecturas: %s", n, esp_err_to_name(err));
+        } else {
+            s_stats.escritas += n;
+        }
+        s_slot += n;
+        i += n;
+    }
+    s_lote_n = 0;
+}
+
+esp_err_t esfera_log_init(void)
+{
+    s_part = esp_partition_find_first(ESP_PARTITION_TYPE_DATA, ESFERA_LOG_SUBTIPO, ESFERA_LOG_PARTICION);
+    if (!s_part) {
+        ESP_LOGW(TAG, "⚠️ Sin partición \"%s\", lecturas solo en RAM", ESFERA_LOG_PARTICION);
+        return ESP_ERR_NOT_FOUND;
+    }
+    if (!s_mutex) s_mutex = xSemaphoreCreateMutex();
+    s_paginas = s_part->size / PAGINA;
+    s_stats.paginas = s_paginas;
+
+    // Mitad cruda y mitad historial; en una partición chica, todo crudo
+    s_crudas = s_paginas;
+    if (s_paginas >= 4 * ESFERA_LOG_GRUPO &&
+        sizeof(registro_t) + esfera_codec_max_largo(ESFERA_CODEC_MAX_MUESTRAS) <= PAGINA - CABECERA) {
+        s_crudas = s_paginas / 2;
+    }
+
+    nvs_handle_t handle;
+    s_ack = 0;
+    if (nvs_open(LOG_NS, NVS_READONLY, &handle) == ESP_OK) {
+        nvs_get_u32(handle, LOG_NS_ACK, &s_ack);
+        nvs_close(handle);
+    }
+
+    // 1) Cabeceras: la página con mayor primer_id es la última en escritura
+    bool hay = false;
+    uint32_t max_id = 0, min_id = 0, max_pag = 0;
+    for (uint32_t p = 0; p < s_crudas; p++) {
+        cabecera_t cab;
+        if (!leer_cabecera(p, MAGIC, &cab)) continue;
+        if (!hay || cab.primer_id > max_id) { max_id = cab.primer_id; max_pag = p; }
+        if (!hay || cab.primer_id < min_id) min_id = cab.primer_id;
+        hay = true;
+    }
+
+    if (!hay) {
+        s_ack = 0;
+        s_min_id = 0;
+        descartar_historial();
+        abrir_pagina(0, 0);
+        persistir_ack();
+        ESP_LOGI(TAG, "📼 Log nuevo en \"%s\" (%" PRIu32 " páginas crudas, %" PRIu32 " de historial)",
+                 ESFERA_LOG_PARTICION, s_crudas, s_paginas - s_crudas);
+        return ESP_OK;
+    }
+
+    // 2) Una sola página: el último slot escrito marca dónde seguir. Un slot
+    //    a medio escribir (corte de energía) no se reutiliza, queda salteado.
+    s_pagina = max_pag;
+    s_primer_id = max_id;
+    s_min_id = min_id;
+    s_slot = 0;
+    resumen_vacio(&s_resumen);
+    slot_t buf[LEER_SLOTS];
+    for (uint32_t base = 0; base < SLOTS; base += LEER_SLOTS) {
+        uint32_t n = SLOTS - base < LEER_SLOTS ? SLOTS - base : LEER_SLOTS;
+        if (esp_partition_read(s_part, offset_slot(s_pagina, base), buf, n * sizeof(slot_t)) != ESP_OK) {
+            s_stats.errores++;
+            s_slot = SLOTS;     // Ante la duda no se escribe sobre esta página
+            break;
+        }
+        for (uint32_t j = 0; j < n; j++) {
+            if (buf[j].marca != 0xFF) s_slot = base + j + 1;
+            if (slot_valido(&buf[j])) resumen_sumar(&s_resumen, &buf[j].dato);
+        }
+    }
+
+    if (s_ack < s_min_id) s_ack = s_min_id;
+    if (s_ack > siguiente_id()) s_ack = siguiente_id();
+    s_ack_nvs = s_ack;
+    s_ack_nvs_us = esp_timer_get_time();
+
+    // Un historial con ids más allá del log crudo es de un log anterior
+    recuperar_historial();
+    if (s_archivado > siguiente_id()) descartar_historial();
+
+    ESP_LOGI(TAG, "📼 Log recuperado: %" PRIu32 " lecturas sin publicar (página %" PRIu32 ", slot %" PRIu32 ")",
+             siguiente_id() - s_ack, s_pagina, s_slot);
+    if (s_hist_hay) {
+        ESP_LOGI(TAG, "📼 Historial: páginas %" PRIu32 "-%" PRIu32 ", comprimido hasta el id %" PRIu32,
+                 s_hist_min, s_hist_num, s_archivado);
+    }
+    return ESP_OK;
+}
+
+bool esfera_log_habilitado(void)
+{
+    return s_part != NULL;
+}
+
+esp_err_t esfera_log_agregar(const esfera_data_t *dato, uint32_t *id)
+{
+    if (!s_part) return ESP_ERR_INVALID_STATE;
+
+    xSemaphoreTake(s_mutex, portMAX_DELAY);
+    if (s_lote_n == 0) s_lote_desde_us = esp_timer_get_time();
+    *id = siguiente_id() + s_lote_n;
+    s_lote[s_lote_n++] = *dato;
+    if (s_lote_n == ESFERA_LOG_LOTE) escribir_lote();
+    xSemaphoreGive(s_mutex);
+    return ESP_OK;
+}
+
+void esfera_log_flush(bool forzar)
+{
+    if (!s_part) return;
+
+    xSemaphoreTake(s_mutex, portMAX_DELAY);
+    if (s_lote_n && (forzar || esp_timer_get_time() - s_lote_desde_us >= ESFERA_LOG_FLUSH_MS * 1000LL)) {
+        escribir_lote();
+    }
+    persistir_ack_si_vence(forzar);
+    xSemaphoreGive(s_mutex);
+}
+
+void esfera_log_recorrer_pendientes(uint32_t hasta_id, esfera_log_cb_t cb, void *ctx)
+{
+    if (!s_part) return;
+
+    xSemaphoreTake(s_mutex, portMAX_DELAY);
+    // Lo que esté en el lote en RAM también es pendiente
+    if (s_lote_n) escribir_lote();
+    slot_t buf[LEER_SLOTS];
+    uint32_t fin = siguiente_id();
+    if (fin > hasta_id) fin = hasta_id;
+    uint32_t id = s_ack;
+    while (id < fin) {
+        uint32_t slot = id % SLOTS;
+        uint32_t n = SLOTS - slot;
+        if (n > LEER_SLOTS) n = LEER_SLOTS;
+        if (n > fin - id) n = fin - id;
+
+        if (esp_partition_read(s_part, offset_slot(pagina_de(id), slot), buf, n * sizeof(slot_t)) != ESP_OK) {
+            s_stats.errores++;
+        } else {
+            for (uint32_t j = 0; j < n; j++) {
+                if (slot_valido(&buf[j])) cb(&buf[j].dato, id + j, ctx);
+            }
+        }
+        id += n;
+    }
+    xSemaphoreGive(s_mutex);
+}
+
+uint32_t esfera_log_primer_pendiente(void)
+{
+    if (!s_part) return 0;
+
+    xSemaphoreTake(s_mutex, portMAX_DELAY);
+    uint32_t id = s_ack;
+    xSemaphoreGive(s_mutex);
+    return id;
+}
+
+uint32_t esfera_log_siguiente_id(void)
+{
+    if (!s_part) return 0;
+
+    xSemaphoreTake(s_mutex, portMAX_DELAY);
+    uint32_t id = siguiente_id() + s_lote_n;
+    xSemaphoreGive(s_mutex);
+    return id;
+}
+
+void esfera_log_confirmar(uint32_t hasta_id)
+{
+    if (!s_part) return;
+
+    xSemaphoreTake(s_mutex, portMAX_DELAY);
+    uint32_t tope = siguiente_id() + s_lote_n;
+    if (hasta_id > tope) hasta_id = tope;
+    if (hasta_id > s_ack) {
+        s_ack = hasta_id;
+        persistir_ack_si_vence(false);
+    }
+    xSemaphoreGive(s_mutex);
+}
+
+// Una página cruda: se lee bajo el mutex y se visita fuera de él. corte es
+// s_archivado al empezar el recorrido: lo anterior sale del historial.
+static bool recorrer_crudas(uint32_t num, uint32_t corte, const esfera_log_filtro_t *filtro, bool descendente,
+                            esfera_log_visita_t cb, void *ctx, esfera_data_t *datos)
+{
+    uint32_t id0 = num * SLOTS;
+    size_t n = 0;
+    slot_t buf[LEER_SLOTS];
+
+    // El mutex se toma por página para no frenar la ingesta durante la consulta
+    xSemaphoreTake(s_mutex, portMAX_DELAY);
+    uint32_t fin = siguiente_id();
+    uint32_t piso = s_min_id > corte ? s_min_id : corte;
+    if (id0 + SLOTS > piso && id0 < fin) {
+        uint32_t p = pagina_de(id0);
+        resumen_t r = s_resumen;
+        bool con_resumen = num == s_primer_id / SLOTS || leer_resumen(p, &r);
+        bool descartar = con_resumen && resumen_descarta(&r, filtro);
+
+        uint32_t desde = id0 < piso ? piso - id0 : 0;
+        uint32_t hasta = fin - id0 < SLOTS ? fin - id0 : SLOTS;
+        for (uint32_t base = desde; !descartar && base < hasta; base += LEER_SLOTS) {
+            uint32_t m = hasta - base < LEER_SLOTS ? hasta - base : LEER_SLOTS;
+            if (esp_partition_read(s_part, offset_slot(p, base), buf, m * sizeof(slot_t)) != ESP_OK) {
+                s_stats.errores++;
+                break;
+            }
+            for (uint32_t j = 0; j < m; j++) {
+                const esfera_data_t *d = &buf[j].dato;
+                if (slot_valido(&buf[j]) && d->epoch >= filtro->desde && d->epoch <= filtro->hasta &&
+                    (!filtro->bloom || (esfera_log_bloom(d->mac) & filtro->bloom))) {
+                    datos[n++] = *d;
+                }
+            }
+        }
+    }
+    xSemaphoreGive(s_mutex);
+
+    for (size_t i = 0; i < n; i++) {
+        if (!cb(&datos[descendente ? n - 1 - i : i], ctx)) return false;
+    }
+    return true;
+}
+
+// Una página de historial: se copia bajo el mutex y se decodifica fuera de él.
+// Se saltean los registros comprimidos después de corte (siguen crudos).
+static bool recorrer_historial(uint32_t num, uint32_t corte, const esfera_log_filtro_t *filtro, bool descendente,
+                               esfera_log_visita_t cb, void *ctx, uint8_t *copia, esfera_data_t *datos)
+{
+    bool leida = false;
+    xSemaphoreTake(s_mutex, portMAX_DELAY);
+    if (s_hist_hay && num >= s_hist_min && num <= s_hist_num) {
+        uint32_t p = hist_fisica(num);
+        resumen_t r = s_hist_resumen;
+        bool con_resumen = num == s_hist_num || leer_resumen(p, &r);
+        if (!con_resumen || !resumen_descarta(&r, filtro)) {
+            leida = esp_partition_read(s_part, (size_t)p * PAGINA, copia, PAGINA) == ESP_OK;
+            if (!leida) s_stats.errores++;
+        }
+    }
+    xSemaphoreGive(s_mutex);
+    if (!leida) return true;
+
+    uint16_t offsets[REGISTROS_MAX];
+    size_t n;
+    registros_de(copia, offsets, &n);
+    for (size_t k = 0; k < n; k++) {
+        const uint8_t *rec = copia + offsets[descendente ? n - 1 - k : k];
+        registro_t reg;
+        memcpy(&reg, rec, sizeof(reg));
+        if (reg.hasta_id > corte) continue;
+
+        // La cabecera del bloque alcanza para descartarlo por esfera o rango
+        esfera_codec_cabecera_t cab;
+        const uint8_t *bloque = rec + sizeof(reg);
+        if (esfera_codec_cabecera(bloque, reg.largo, &cab) != ESP_OK) continue;
+        if (cab.epoch_fin < filtro->desde || cab.epoch_ini > filtro->hasta) continue;
+        if (filtro->bloom && !(esfera_log_bloom(cab.mac) & filtro->bloom)) continue;
+
+        size_t m;
+        if (esfera_codec_decodificar(bloque, reg.largo, datos, DATOS_MAX, &m) != ESP_OK) continue;
+        for (size_t i = 0; i < m; i++) {
+            const esfera_data_t *d = &datos[descendente ? m - 1 - i : i];
+            if (d->epoch < filtro->desde || d->epoch > filtro->hasta) continue;
+            if (!cb(d, ctx)) return false;
+        }
+    }
+    return true;
+}
+
+void esfera_log_recorrer(const esfera_log_filtro_t *filtro, bool descendente, esfera_log_visita_t cb, void *ctx)
+{
+    if (!s_part) return;
+
+    esfera_data_t *datos = malloc(DATOS_MAX * sizeof(esfera_data_t));
+    uint8_t *copia = malloc(PAGINA);
+    if (!datos || !copia) {
+        free(datos);
+        free(copia);
+        return;
+    }
+
+    // Lo que esté en el lote en RAM también se consulta
+    xSemaphoreTake(s_mutex, portMAX_DELAY);
+    if (s_lote_n) escribir_lote();
+    uint32_t corte = s_archivado;
+    uint32_t primera = (s_min_id > corte ? s_min_id : corte) / SLOTS;
+    uint32_t ultima = (siguiente_id() + SLOTS - 1) / SLOTS;   // Exclusiva
+    uint32_t hist_min = s_hist_min;
+    uint32_t n_hist = s_hist_hay ? s_hist_num - s_hist_min + 1 : 0;
+    xSemaphoreGive(s_mutex);
+
+    // El historial es anterior a todo lo crudo
+    uint32_t total = n_hist + (ultima - primera);
+    bool seguir = true;
+    for (uint32_t k = 0; seguir && k < total; k++) {
+        uint32_t i = descendente ? total - 1 - k : k;
+        if (i < n_hist) {
+            seguir = recorrer_historial(hist_min + i, corte, filtro, descendente, cb, ctx, copia, datos);
+        } else {
+            seguir = recorrer_crudas(primera + i - n_hist, corte, filtro, descendente, cb, ctx, datos);
+        }
+    }
+    free(datos);
+    free(copia);
+}
+
+void esfera_log_get_stats(esfera_log_stats_t *stats)
+{
+    if (s_mutex) xSemaphoreTake(s_mutex, portMAX_DELAY);
+    *stats = s_stats;
+    stats->pendientes = s_part ? siguiente_id() + s_lote_n - s_ack : 0;
+    if (s_mutex) xSemaphoreGive(s_mutex);
+}
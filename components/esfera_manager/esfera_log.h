@@ -0,0 +1,125 @@
+#pragma once
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "esp_err.h"
+#include "esfera_manager.h"
+
+#define ESFERA_LOG_PARTICION    "lecturas"  // Partición de datos, subtipo 0x40
+#define ESFERA_LOG_SUBTIPO      0x40
+#define ESFERA_LOG_LOTE         16          // Lecturas acumuladas en RAM antes de escribir
+#define ESFERA_LOG_FLUSH_MS     5000        // Antigüedad máxima de un lote sin escribir
+#define ESFERA_LOG_ACK_MS       60000       // Antigüedad máxima del cursor confirmado sin persistir
+#define ESFERA_LOG_GRUPO        4           // Páginas crudas que se comprimen juntas al historial
+
+typedef struct {
+    uint32_t paginas;
+    uint32_t escritas;          // Lecturas escritas en flash desde el arranque
+    uint32_t pendientes;        // Lecturas sin confirmar (en flash + lote en RAM)
+    uint32_t perdidas;          // Lecturas sin confirmar pisadas por log lleno
+    uint32_t borrados;          // Sectores borrados desde el arranque
+    uint32_t errores;           // Fallos de lectura/escritura de flash
+    uint32_t commits_ack;       // Veces que se persistió el cursor en NVS
+    uint32_t archivadas;        // Lecturas comprimidas al historial desde el arranque
+    uint32_t bytes_historial;   // Bytes que ocupan en flash
+} esfera_log_stats_t;
+
+/**
+ * @brief Callback de esfera_log_recorrer_pendientes.
+ */
+typedef void (*esfera_log_cb_t)(const esfera_data_t *dato, uint32_t id, void *ctx);
+
+/**
+ * @brief Filtro de esfera_log_recorrer. bloom es el OR de esfera_log_bloom() de
+ *        las MAC buscadas (0 = todas); puede dejar pasar otras MAC.
+ */
+typedef struct {
+    uint32_t desde;
+    uint32_t hasta;
+    uint64_t bloom;
+} esfera_log_filtro_t;
+
+/**
+ * @brief Visita de esfera_log_recorrer. Devuelve false para terminar.
+ */
+typedef bool (*esfera_log_visita_t)(const esfera_data_t *dato, void *ctx);
+
+/**
+ * @brief Monta el log sobre la partición ESFERA_LOG_PARTICION.
+ *
+ * La mitad de la partición es un anillo de páginas crudas (slots de 24 bytes
+ * con id, para publicar y confirmar); la otra mitad, el historial. Antes de
+ * reciclar una página cruda, su grupo de ESFERA_LOG_GRUPO páginas se comprime
+ * por esfera con esfera_codec (~3-4 bytes por lectura). Con la partición de
+ * 4 MB son ~86 000 lecturas crudas y ~500 000-650 000 comprimidas: unas 7
+ * semanas con 10 esferas a una lectura por minuto, algo más de una con 50.
+ * Las particiones de menos de 4 × ESFERA_LOG_GRUPO páginas quedan todo crudo.
+ *
+ * Lee la cabecera de cada página para ubicar la más nueva y recorre solo esa
+ * página para encontrar el próximo lugar libre. Sin la partición el log queda
+ * deshabilitado y el resto de las funciones no hacen nada.
+ */
+esp_err_t esfera_log_init(void);
+
+bool esfera_log_habilitado(void);
+
+/**
+ * @brief Agrega una lectura al lote en RAM; el lote se escribe al llenarse o al vencer.
+ *
+ * @param id Identificador creciente de la lectura en el log (para confirmarla).
+ */
+esp_err_t esfera_log_agregar(const esfera_data_t *dato, uint32_t *id);
+
+/**
+ * @brief Escribe el lote pendiente y persiste el cursor de confirmación si venció.
+ *
+ * @param forzar false: solo si el lote supera ESFERA_LOG_FLUSH_MS o el cursor
+ *               ESFERA_LOG_ACK_MS; true: ambos ya (antes de reiniciar).
+ */
+void esfera_log_flush(bool forzar);
+
+/**
+ * @brief Recorre en orden las lecturas aún no confirmadas con id menor que hasta_id.
+ *        Escribe antes el lote en RAM. Los slots dañados se saltean.
+ */
+void esfera_log_recorrer_pendientes(uint32_t hasta_id, esfera_log_cb_t cb, void *ctx);
+
+/**
+ * @brief Id de la lectura sin confirmar más antigua (todas las menores están publicadas).
+ */
+uint32_t esfera_log_primer_pendiente(void);
+
+/**
+ * @brief Id que recibirá la próxima lectura.
+ */
+uint32_t esfera_log_siguiente_id(void);
+
+/**
+ * @brief Confirma (publicadas) todas las lecturas con id menor que hasta_id.
+ *
+ * El cursor se persiste en NVS cuando avanzó una página o pasaron
+ * ESFERA_LOG_ACK_MS desde el último commit, no en cada confirmación. Tras un
+ * corte se vuelven a publicar a lo sumo esas lecturas (el consumidor ya debe
+ * tolerar duplicados porque el ack MQTT puede perderse).
+ */
+void esfera_log_confirmar(uint32_t hasta_id);
+
+/**
+ * @brief Recorre todo lo que sigue en flash (publicado o no): primero el
+ *        historial y después lo crudo en orden de llegada.
+ *
+ * En el historial, cada grupo de páginas sale agrupado por esfera y por epoch
+ * dentro de cada una. Cada página cerrada guarda en la cabecera su rango de
+ * epoch y un filtro de Bloom de las MAC, y cada bloque comprimido su MAC y
+ * rango: lo que no puede coincidir se saltea sin decodificar.
+ *
+ * @param descendente true: de lo más nuevo a lo más viejo.
+ */
+void esfera_log_recorrer(const esfera_log_filtro_t *filtro, bool descendente, esfera_log_visita_t cb, void *ctx);
+
+uint64_t esfera_log_bloom(const uint8_t mac[6]);
+
+/**
+ * @brief Contadores del log; se puede llamar desde cualquier tarea.
+ */
+void esfera_log_get_stats(esfera_log_stats_t *stats);
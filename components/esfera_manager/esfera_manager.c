@@ -3,99 +3,521 @@
 #include <string.h>
 #include <stdlib.h>
 #include <time.h>
+#include <stdatomic.h>
+#include "sdkconfig.h"
 #include "esp_log.h"
-#include "cJSON.h"
-#include "nvs_flash.h"
-
-#define MAX_ENTRADAS 32
+#include "esp_heap_caps.h"
+#include "esp_random.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "esfera_registry.h"
+#include "esfera_log.h"
+#include "esfera_stats.h"
+#include "esfera_codec.h"
+#include "esfera_json.h"
+#include "esfera_cbor.h"
 
 static const char *TAG = "ESFERA_MANAGER";
-static esfera_data_t buffer[MAX_ENTRADAS];
-static size_t buffer_index = 0;
+
+// Cada mitad es un buffer circular: inicio apunta a la lectura más antigua
+typedef struct {
+    esfera_data_t *datos;
+    size_t inicio;
+    size_t cantidad;
+    bool aviso_lleno;       // Un solo aviso por llenado, se rearma al vaciar
+    bool con_id;            // Se asignaron ids de esfera_log a esta mitad
+    bool incompleta;        // Perdió lecturas (sobrescritas o rechazadas) que siguen en flash
+    uint32_t desde_id;      // Primer id asignado a esta mitad
+    uint32_t hasta_id;      // Último id asignado + 1
+} mitad_t;
+
+// Doble buffer: la ingesta escribe siempre en la mitad activa y el publicador
+// intercambia las mitades para leer la otra sin bloquear al productor.
+// s_escribiendo indica en qué mitad está escribiendo la ingesta (-1 ninguna);
+// junto con s_activa forma un handshake con orden secuencial (estilo Dekker).
+// s_copiando es el lado inverso para las consultas: marca una mitad que se está
+// copiando sin intercambiar, y la ingesta espera antes de escribir en ella.
+static mitad_t s_mitades[2];
+static size_t s_capacidad;
+static atomic_int s_activa;
+static atomic_int s_escribiendo = -1;
+static atomic_int s_copiando = -1;
+static int s_tomada = -1;           // Mitad retenida por el publicador, solo la usa él
+static uint32_t s_cursor;           // Cursor de la primera lectura retenida (o de la próxima)
+static size_t s_enviadas;           // Lecturas retenidas ya enviadas en una página, confirmables
+static uint32_t s_corte;            // Primer id de esfera_log posterior a las mitades ya tomadas
+// Los escribe la ingesta y los lee el reporte periódico de otra tarea
+static atomic_uint sobrescritas;
+static atomic_uint rechazadas;
+
+static esfera_data_t *reservar(size_t tam) {
+    esfera_data_t *p = NULL;
+#if CONFIG_ESFERA_BUFFER_PSRAM
+    p = heap_caps_malloc(tam, MALLOC_CAP_SPIRAM | MALLOC_CAP_8BIT);
+    if (!p) ESP_LOGW(TAG, "⚠️ Sin PSRAM para el buffer, usando RAM interna");
+#endif
+    if (!p) p = heap_caps_malloc(tam, MALLOC_CAP_DEFAULT);
+    return p;
+}
+
+static void vaciar(mitad_t *m) {
+    m->inicio = 0;
+    m->cantidad = 0;
+    m->aviso_lleno = false;
+    m->con_id = false;
+    m->incompleta = false;
+}
+
+static void agregar(mitad_t *m, const esfera_data_t *dato, bool con_id, uint32_t id) {
+    if (con_id) {
+        if (!m->con_id) m->desde_id = id;
+        m->con_id = true;
+        m->hasta_id = id + 1;
+    }
+
+    if (m->cantidad == s_capacidad) {
+        // Lo que se pierde de RAM sigue en flash: el snapshot se rearmará desde ahí
+        m->incompleta = true;
+#if CONFIG_ESFERA_BUFFER_SOBRESCRIBIR
+        m->inicio = (m->inicio + 1) % s_capacidad;
+        m->cantidad--;
+        atomic_fetch_add_explicit(&sobrescritas, 1, memory_order_relaxed);
+        if (!m->aviso_lleno) ESP_LOGW(TAG, "⚠️ Buffer lleno, sobrescribiendo lecturas antiguas");
+        m->aviso_lleno = true;
+#else
+        atomic_fetch_add_explicit(&rechazadas, 1, memory_order_relaxed);
+        if (!m->aviso_lleno) ESP_LOGW(TAG, "⚠️ Buffer lleno, descartando entradas");
+        m->aviso_lleno = true;
+        return;
+#endif
+    }
+
+    m->datos[(m->inicio + m->cantidad) % s_capacidad] = *dato;
+    m->cantidad++;
+}
+
+static void reponer_desde_log(const esfera_data_t *dato, uint32_t id, void *ctx) {
+    mitad_t *m = ctx;
+    if (m->cantidad < s_capacidad) m->datos[(m->inicio + m->cantidad++) % s_capacidad] = *dato;
+}
+
+// Con el log en flash, el snapshot debe empezar en la lectura sin confirmar más
+// antigua y no tener huecos, para que confirmarlo no confirme lecturas nunca
+// publicadas. Si no es así (buffer desbordado, reinicio) se rearma desde flash
+// hasta la capacidad; lo que no entra se drena en las próximas publicaciones.
+// Después de esto las lecturas retenidas son los ids [hasta_id - cantidad, hasta_id).
+static void completar_desde_log(mitad_t *m) {
+    uint32_t limite = m->con_id ? m->hasta_id : s_corte;
+    s_corte = limite;
+
+    uint32_t desde = esfera_log_primer_pendiente();
+    if (m->con_id && !m->incompleta && m->desde_id == desde) return;
+
+    vaciar(m);
+    if ((int32_t)(limite - desde) <= 0) return;
+    if (limite - desde > s_capacidad) limite = desde + s_capacidad;
+
+    esfera_log_recorrer_pendientes(limite, reponer_desde_log, m);
+    m->con_id = true;
+    m->desde_id = desde;
+    m->hasta_id = limite;
+    ESP_LOGI(TAG, "📼 Snapshot rearmado desde flash: %u lecturas (ids %" PRIu32 "-%" PRIu32 ")",
+             (unsigned)m->cantidad, desde, limite - 1);
+}
 
 void esfera_manager_init(void) {
-    buffer_index = 0;
-    memset(buffer, 0, sizeof(buffer));
+    if (!s_mitades[0].datos) {
+        size_t tam = CONFIG_ESFERA_BUFFER_CAPACIDAD * sizeof(esfera_data_t);
+        s_mitades[0].datos = reservar(tam);
+        s_mitades[1].datos = s_mitades[0].datos ? reservar(tam) : NULL;
+        if (!s_mitades[1].datos) {
+            heap_caps_free(s_mitades[0].datos);
+            s_mitades[0].datos = NULL;
+            ESP_LOGE(TAG, "❌ No se pudo reservar el buffer de 2 x %u bytes", (unsigned)tam);
+        } else {
+            s_capacidad = CONFIG_ESFERA_BUFFER_CAPACIDAD;
+            ESP_LOGI(TAG, "✅ Buffer de 2 x %u lecturas (%u bytes)", (unsigned)s_capacidad, (unsigned)(2 * tam));
+        }
+    }
+    vaciar(&s_mitades[0]);
+    vaciar(&s_mitades[1]);
+    atomic_store(&s_activa, 0);
+    s_tomada = -1;
+    // Base aleatoria: un cursor de antes del reinicio no confirma lecturas nuevas
+    s_cursor = esp_random();
+    s_enviadas = 0;
+    esfera_registry_init();
+    esfera_stats_init();
+
+    // Lo que quedó sin publicar antes del reinicio no se copia acá: el primer
+    // snapshot lo toma de flash, de a una capacidad por publicación
+    if (s_capacidad && esfera_log_init() == ESP_OK) {
+        s_corte = esfera_log_siguiente_id();
+        uint32_t pendientes = s_corte - esfera_log_primer_pendiente();
+        if (pendientes) ESP_LOGI(TAG, "📼 %" PRIu32 " lecturas sin publicar en flash", pendientes);
+    }
 }
 
 //Agrega lecturas de esferas en la memoria 
-void esfera_manager_add(const char *raw_payload, const char *mac_origen) {
-    if (buffer_index >= MAX_ENTRADAS) {
-        ESP_LOGW(TAG, "⚠️ Buffer lleno, descartando entrada");
-        return;
+void esfera_manager_add(uint16_t indice, const esfera_lectura_t *lectura, time_t epoch) {
+    if (s_capacidad == 0) return;
+
+    esfera_data_t entrada;
+    entrada.epoch = (uint32_t)epoch;
+    entrada.humedad = lectura->humedad;
+    entrada.temperatura = lectura->temperatura;
+    entrada.voltaje_mv = lectura->voltaje_mv;
+    entrada.riego = lectura->riego;
+    // Las tramas de texto traen su propia MAC, por eso se parte del texto de la lectura
+    if (!esfera_registry_mac_desde_texto(lectura->mac, entrada.mac)) {
+        memset(entrada.mac, 0, sizeof(entrada.mac));
     }
 
-    float h, t, v;
-    int r;
-    char mac_final[13];
-    if (sscanf(raw_payload, "%f,%f,%f,%d %12s", &h, &t, &v, &r, mac_final) != 5) {
-        ESP_LOGW(TAG, "⚠️ Formato inválido: %s", raw_payload);
-        return;
+    ESP_LOGD(TAG, "🟢 Entrada agregada: MAC=%s H=%u T=%d V=%u R=%u epoch=%" PRIu32,
+             lectura->mac, entrada.humedad, entrada.temperatura, entrada.voltaje_mv,
+             entrada.riego, entrada.epoch);
+
+    esfera_stats_actualizar(indice, &entrada);
+
+    // La escritura en flash queda fuera del handshake para no demorar al publicador
+    uint32_t id = 0;
+    bool con_id = esfera_log_agregar(&entrada, &id) == ESP_OK;
+
+    // Se anuncia la mitad antes de escribir y se confirma que siga activa;
+    // si el publicador intercambió en el medio, se reintenta con la nueva.
+    int activa;
+    while (true) {
+        activa = atomic_load(&s_activa);
+        atomic_store(&s_escribiendo, activa);
+        if (atomic_load(&s_activa) != activa) continue;
+        if (atomic_load(&s_copiando) != activa) break;
+        // Una consulta está copiando esta mitad: se espera a que termine
+        atomic_store(&s_escribiendo, -1);
+        while (atomic_load(&s_copiando) == activa) {
+            vTaskDelay(1);
+        }
+    }
+
+    agregar(&s_mitades[activa], &entrada, con_id, id);
+
+    atomic_store(&s_escribiendo, -1);
+}
+
+size_t esfera_manager_snapshot_tomar(void) {
+    if (s_capacidad == 0) return 0;
+
+    if (s_tomada < 0) {
+        int vieja = atomic_load(&s_activa);
+        atomic_store(&s_activa, 1 - vieja);
+        // Solo se espera a que termine una escritura ya empezada (microsegundos)
+        while (atomic_load(&s_escribiendo) == vieja) {
+            vTaskDelay(1);
+        }
+        s_tomada = vieja;
+        if (esfera_log_habilitado()) completar_desde_log(&s_mitades[s_tomada]);
+    }
+    return s_mitades[s_tomada].cantidad;
+}
+
+const esfera_data_t *esfera_manager_snapshot_leer(size_t i) {
+    const mitad_t *m = &s_mitades[s_tomada];
+    return &m->datos[(m->inicio + i) % s_capacidad];
+}
+
+static size_t copiar_mitad(const mitad_t *m, esfera_data_t *destino) {
+    for (size_t i = 0; i < m->cantidad; i++) {
+        destino[i] = m->datos[(m->inicio + i) % s_capacidad];
+    }
+    return m->cantidad;
+}
+
+esfera_data_t *esfera_manager_copiar(size_t *n) {
+    *n = 0;
+    if (s_capacidad == 0) return NULL;
+
+    esfera_data_t *copia = malloc(2 * s_capacidad * sizeof(esfera_data_t));
+    if (!copia) {
+        ESP_LOGE(TAG, "❌ Sin memoria para copiar el buffer");
+        return NULL;
+    }
+
+    // El snapshot retenido es más antiguo y solo lo toca esta tarea
+    if (s_tomada >= 0) *n = copiar_mitad(&s_mitades[s_tomada], copia);
+
+    // La mitad activa solo cambia con un intercambio, que hace esta misma tarea
+    int activa = atomic_load(&s_activa);
+    atomic_store(&s_copiando, activa);
+    while (atomic_load(&s_escribiendo) == activa) {
+        vTaskDelay(1);
     }
+    *n += copiar_mitad(&s_mitades[activa], copia + *n);
+    atomic_store(&s_copiando, -1);
+    return copia;
+}
+
+void esfera_manager_snapshot_liberar(void) {
+    if (s_tomada < 0) return;
+    // Publicadas: ya no hace falta conservarlas en flash
+    // Solo hasta lo que el snapshot contenía: lo desbordado queda pendiente en flash
+    if (s_mitades[s_tomada].con_id) esfera_log_confirmar(s_mitades[s_tomada].hasta_id);
+    s_cursor += s_mitades[s_tomada].cantidad;
+    s_enviadas = 0;
+    vaciar(&s_mitades[s_tomada]);
+    s_tomada = -1;
+}
 
-    time_t now = time(NULL);
+esp_err_t esfera_manager_confirmar(uint32_t cursor) {
+    if (s_tomada < 0) return ESP_ERR_INVALID_STATE;
+
+    // Solo se aceptan cursores dentro de lo ya enviado del snapshot retenido
+    uint32_t k = cursor - s_cursor;
+    if (k == 0) return ESP_OK;
+    if (k > s_enviadas) return ESP_ERR_INVALID_ARG;
+
+    mitad_t *m = &s_mitades[s_tomada];
+    if (k == m->cantidad) {
+        esfera_manager_snapshot_liberar();
+        return ESP_OK;
+    }
+
+    // Confirmación parcial: se descartan de RAM; el log en flash se confirma al
+    // vaciarse el snapshot (tras un reinicio podrían reenviarse: al menos una vez)
+    m->inicio = (m->inicio + k) % s_capacidad;
+    m->cantidad -= k;
+    s_cursor += k;
+    s_enviadas -= k;
+    return ESP_OK;
+}
+
+void esfera_data_formatear(const esfera_data_t *e, char mac[13], char timestamp[20]) {
+    esfera_registry_mac_a_texto(e->mac, mac);
+
+    time_t epoch = e->epoch;
     struct tm timeinfo;
-    localtime_r(&now, &timeinfo);
+    localtime_r(&epoch, &timeinfo);
+    strftime(timestamp, 20, "%Y-%m-%dT%H:%M:%S", &timeinfo);
+}
 
-    esfera_data_t *entrada = &buffer[buffer_index++];
-    entrada->humedad = h;
-    entrada->temperatura = t;
-    entrada->voltaje = v;
-    entrada->riego = (uint8_t)r;
-    strncpy(entrada->mac, mac_final, sizeof(entrada->mac));
-    strftime(entrada->timestamp, sizeof(entrada->timestamp), "%Y-%m-%dT%H:%M:%S", &timeinfo);
+static void escribir_json(esfera_json_t *w, size_t desde, size_t cantidad) {
+    ESFERA_JSON_LIT(w, "[");
+    for (size_t i = desde; i < desde + cantidad; i++) {
+        const esfera_data_t *e = esfera_manager_snapshot_leer(i);
+        char mac[13];
+        char timestamp[20];
+        esfera_data_formatear(e, mac, timestamp);
 
-    ESP_LOGI(TAG, "🟢 Entrada agregada: MAC=%s H=%.1f T=%.1f V=%.2f R=%d TS=%s",
-             entrada->mac, h, t, v, r, entrada->timestamp);
+        // Mismo orden de claves y mismas conversiones a float que la versión con cJSON
+        if (i > desde) ESFERA_JSON_LIT(w, ",");
+        ESFERA_JSON_LIT(w, "{\"mac\":");
+        esfera_json_texto(w, mac);
+        ESFERA_JSON_LIT(w, ",\"humedad\":");
+        esfera_json_numero(w, e->humedad / 100.0f);
+        ESFERA_JSON_LIT(w, ",\"temperatura\":");
+        esfera_json_numero(w, e->temperatura / 100.0f);
+        ESFERA_JSON_LIT(w, ",\"bateria\":");
+        esfera_json_numero(w, e->voltaje_mv / 1000.0f);
+        ESFERA_JSON_LIT(w, ",\"riego\":");
+        esfera_json_numero(w, e->riego);
+        ESFERA_JSON_LIT(w, ",\"timestamp\":");
+        esfera_json_texto(w, timestamp);
+        ESFERA_JSON_LIT(w, "}");
+    }
+    ESFERA_JSON_LIT(w, "]");
 }
 
-char *esfera_manager_generate_json(void) {
-    cJSON *root = cJSON_CreateArray();
+esp_err_t esfera_manager_write_json(char *buf, size_t cap, esfera_json_salida_t salida, void *ctx, size_t *total) {
+    esfera_json_t w;
+    esfera_json_init(&w, buf, cap, salida, ctx);
+    escribir_json(&w, 0, esfera_manager_snapshot_tomar());
+    esp_err_t err = esfera_json_fin(&w);
+    if (total) *total = w.total;
+    return err;
+}
 
-    for (size_t i = 0; i < buffer_index; i++) {
-        cJSON *item = cJSON_CreateObject();
-        cJSON_AddStringToObject(item, "mac", buffer[i].mac);
-        cJSON_AddNumberToObject(item, "humedad", buffer[i].humedad);
-        cJSON_AddNumberToObject(item, "temperatura", buffer[i].temperatura);
-        cJSON_AddNumberToObject(item, "bateria", buffer[i].voltaje);
-        cJSON_AddNumberToObject(item, "riego", buffer[i].riego);
-        cJSON_AddStringToObject(item, "timestamp", buffer[i].timestamp);
-        cJSON_AddItemToArray(root, item);
+char *esfera_manager_generate_json(void) {
+    // Una sola reserva con la cota de peor caso y una sola pasada
+    size_t cap = 2 + esfera_manager_snapshot_tomar() * ESFERA_JSON_LECTURA_MAX;
+    char *json_string = malloc(cap + 1);
+    if (!json_string) {
+        ESP_LOGE(TAG, "❌ Error asignando %u bytes para JSON", (unsigned)(cap + 1));
+        return NULL;
     }
 
-    char *json_string = cJSON_PrintUnformatted(root);
-    cJSON_Delete(root);
+    size_t total = 0;
+    if (esfera_manager_write_json(json_string, cap, NULL, NULL, &total) != ESP_OK) {
+        free(json_string);
+        return NULL;
+    }
+    json_string[total] = '\0';
 
     return json_string; // 🔁 Recordá: hay que liberar con free() luego de publicar
 }
 
-void esfera_manager_clear(void) {
-    buffer_index = 0;
-    memset(buffer, 0, sizeof(buffer));
-    ESP_LOGI(TAG, "🧹 Buffer de esferas limpiado");
+char *esfera_manager_generate_pagina(const uint32_t *cursor, size_t limite) {
+    if (limite == 0 || limite > ESFERA_MANAGER_PAGINA_MAX) limite = ESFERA_MANAGER_PAGINA_MAX;
+
+    // El cursor recibido confirma lo anterior; uno inválido no confirma nada
+    if (cursor && esfera_manager_confirmar(*cursor) == ESP_ERR_INVALID_ARG) {
+        ESP_LOGW(TAG, "⚠️ Cursor %" PRIu32 " fuera de rango, se reenvía desde %" PRIu32, *cursor, s_cursor);
+    }
+    if (s_tomada >= 0 && s_mitades[s_tomada].cantidad == 0) {
+        esfera_manager_snapshot_liberar();
+    }
+
+    size_t retenidas = esfera_manager_snapshot_tomar();
+    size_t n = retenidas < limite ? retenidas : limite;
+    size_t restantes = retenidas - n + (s_capacidad ? s_mitades[1 - s_tomada].cantidad : 0);
+    if (s_capacidad && esfera_log_habilitado()) {
+        // Con el log cuenta también lo pendiente en flash que aún no entró al buffer
+        const mitad_t *m = &s_mitades[s_tomada];
+        uint32_t primera = m->con_id ? m->hasta_id - (uint32_t)retenidas : s_corte;
+        restantes = esfera_log_siguiente_id() - primera - n;
+    }
+
+    size_t cap = 64 + n * ESFERA_JSON_LECTURA_MAX;
+    char *json_string = malloc(cap + 1);
+    if (!json_string) {
+        ESP_LOGE(TAG, "❌ Error asignando %u bytes para JSON", (unsigned)(cap + 1));
+        return NULL;
+    }
+
+    // {"Datos":[...],"Cursor":c,"Restantes":r}: c confirma esta página en el próximo pedido
+    esfera_json_t w;
+    esfera_json_init(&w, json_string, cap, NULL, NULL);
+    ESFERA_JSON_LIT(&w, "{\"Datos\":");
+    escribir_json(&w, 0, n);
+    ESFERA_JSON_LIT(&w, ",\"Cursor\":");
+    esfera_json_numero(&w, (double)(uint32_t)(s_cursor + n));
+    ESFERA_JSON_LIT(&w, ",\"Restantes\":");
+    esfera_json_numero(&w, (double)restantes);
+    ESFERA_JSON_LIT(&w, "}");
+    if (esfera_json_fin(&w) != ESP_OK) {
+        free(json_string);
+        return NULL;
+    }
+    json_string[w.total] = '\0';
+
+    if (s_tomada >= 0) s_enviadas = n;
+    return json_string;
 }
 
-esp_err_t esfera_manager_register_mac(const char *mac) {
-    nvs_handle_t handle;
-    esp_err_t err = nvs_open("esferas", NVS_READWRITE, &handle);
-    if (err != ESP_OK) return err;
+// Clave de orden de generate_bloques: la posición desempata y conserva el
+// orden de llegada dentro de cada esfera
+typedef struct {
+    uint8_t mac[6];
+    uint32_t pos;
+} clave_t;
+
+static int comparar_clave(const void *a, const void *b) {
+    const clave_t *x = a, *y = b;
+    int c = memcmp(x->mac, y->mac, sizeof(x->mac));
+    if (c != 0) return c;
+    return (x->pos > y->pos) - (x->pos < y->pos);
+}
 
-    size_t len = 0;
-    err = nvs_get_str(handle, mac, NULL, &len);
+uint8_t *esfera_manager_generate_bloques(size_t *len) {
+    size_t cantidad = esfera_manager_snapshot_tomar();
+    size_t cap = 256, usado = 0;
+    uint8_t *out = malloc(cap);
+    clave_t *claves = malloc((cantidad ? cantidad : 1) * sizeof(clave_t));
+    esfera_data_t *grupo = malloc(ESFERA_CODEC_MAX_MUESTRAS * sizeof(esfera_data_t));
+    bool ok = out && claves && grupo;
 
-    if (err == ESP_ERR_NVS_NOT_FOUND) {
-        // La MAC no existe, la guardamos como "registered"
-        err = nvs_set_str(handle, mac, "registered");
-        if (err == ESP_OK) {
-            err = nvs_commit(handle);
-            ESP_LOGI("ESFERA_MANAGER", "✅ Nueva esfera registrada en NVS: %s", mac);
+    // Agrupa por esfera ordenando una vez por MAC: O(n log n) en lugar de
+    // recorrer el snapshot entero por cada esfera
+    for (size_t i = 0; ok && i < cantidad; i++) {
+        memcpy(claves[i].mac, esfera_manager_snapshot_leer(i)->mac, sizeof(claves[i].mac));
+        claves[i].pos = (uint32_t)i;
+    }
+    if (ok) qsort(claves, cantidad, sizeof(clave_t), comparar_clave);
+
+    for (size_t i = 0; ok && i < cantidad;) {
+        size_t n = 0;
+        const uint8_t *mac = claves[i].mac;
+        while (i < cantidad && n < ESFERA_CODEC_MAX_MUESTRAS &&
+               memcmp(claves[i].mac, mac, sizeof(claves[i].mac)) == 0) {
+            grupo[n++] = *esfera_manager_snapshot_leer(claves[i++].pos);
+        }
+
+        size_t max = esfera_codec_max_largo(n);
+        if (usado + max > cap) {
+            while (usado + max > cap) cap *= 2;
+            uint8_t *nuevo = realloc(out, cap);
+            if (!nuevo) {
+                ok = false;
+                break;
+            }
+            out = nuevo;
         }
-    } else if (err == ESP_OK) {
-        // Ya estaba registrada
-        ESP_LOGD("ESFERA_MANAGER", "ℹ️ Esfera %s ya estaba registrada en NVS", mac);
+        size_t largo;
+        ok = esfera_codec_codificar(grupo, n, out + usado, max, &largo) == ESP_OK;
+        usado += largo;
     }
 
-    nvs_close(handle);
-    return err;
+    free(claves);
+    free(grupo);
+    if (!ok) {
+        ESP_LOGE(TAG, "❌ Error comprimiendo %u lecturas", (unsigned)cantidad);
+        free(out);
+        return NULL;
+    }
+    ESP_LOGI(TAG, "🗜️ %u lecturas comprimidas en %u bytes", (unsigned)cantidad, (unsigned)usado);
+    *len = usado;
+    return out;
 }
 
+// Cota de una lectura en CBOR: mapa (1) + MAC (1 + 7) + timestamp (1 + 1 + 5)
+// + humedad, temperatura y batería (3 x (1 + 3)) + riego (1 + 2)
+#define LECTURA_CBOR_MAX    31
+
+uint8_t *esfera_manager_generate_cbor(size_t *len) {
+    size_t cantidad = esfera_manager_snapshot_tomar();
+    size_t cap = 5 + cantidad * LECTURA_CBOR_MAX;
+    uint8_t *out = malloc(cap);
+    if (!out) {
+        ESP_LOGE(TAG, "❌ Error asignando %u bytes para CBOR", (unsigned)cap);
+        return NULL;
+    }
+
+    esfera_cbor_t w;
+    esfera_cbor_init(&w, out, cap);
+    esfera_cbor_array(&w, cantidad);
+    for (size_t i = 0; i < cantidad; i++) {
+        const esfera_data_t *e = esfera_manager_snapshot_leer(i);
+        esfera_cbor_mapa(&w, 6);
+        esfera_cbor_uint(&w, ESFERA_CBOR_MAC);
+        esfera_cbor_bytes(&w, e->mac, sizeof(e->mac));
+        esfera_cbor_uint(&w, ESFERA_CBOR_TIMESTAMP);
+        esfera_cbor_tag(&w, 1);
+        esfera_cbor_uint(&w, e->epoch);
+        esfera_cbor_uint(&w, ESFERA_CBOR_HUMEDAD);
+        esfera_cbor_uint(&w, e->humedad);
+        esfera_cbor_uint(&w, ESFERA_CBOR_TEMPERATURA);
+        esfera_cbor_int(&w, e->temperatura);
+        esfera_cbor_uint(&w, ESFERA_CBOR_BATERIA);
+        esfera_cbor_uint(&w, e->voltaje_mv);
+        esfera_cbor_uint(&w, ESFERA_CBOR_RIEGO);
+        esfera_cbor_uint(&w, e->riego);
+    }
+    if (w.err != ESP_OK) {
+        ESP_LOGE(TAG, "❌ Error serializando %u lecturas en CBOR", (unsigned)cantidad);
+        free(out);
+        return NULL;
+    }
+    *len = w.len;
+    return out;
+}
+
+void esfera_manager_clear(void) {
+    // Las lecturas que llegaron después del snapshot están en la otra mitad y se conservan
+    esfera_manager_snapshot_tomar();
+    esfera_manager_snapshot_liberar();
+    ESP_LOGI(TAG, "🧹 Buffer de esferas limpiado");
+}
+
+void esfera_manager_get_stats(esfera_manager_stats_t *stats) {
+    stats->capacidad = s_capacidad;
+    stats->ocupacion = s_mitades[0].cantidad + s_mitades[1].cantidad;
+    stats->sobrescritas = atomic_load_explicit(&sobrescritas, memory_order_relaxed);
+    stats->rechazadas = atomic_load_explicit(&rechazadas, memory_order_relaxed);
+}
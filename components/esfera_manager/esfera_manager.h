@@ -1,19 +1,149 @@
 #pragma once
 
 #include <inttypes.h>
+#include <time.h>
 #include "esp_err.h"
+#include "esfera_frame.h"
+#include "esfera_registry.h"
+#include "esfera_json.h"
 
+/**
+ * @brief Lectura almacenada en el buffer (20 bytes). Los valores quedan en punto
+ *        fijo y la MAC y el timestamp se formatean recién al serializar.
+ */
 typedef struct {
-    float humedad;
-    float temperatura;
-    float voltaje;
+    uint32_t epoch;         // Momento de la medición
+    uint16_t humedad;       // Centésimas de %
+    int16_t temperatura;    // Centésimas de °C
+    uint16_t voltaje_mv;
+    uint8_t mac[6];
     uint8_t riego;
-    char mac[13];         // "A085E369D6AC"
-    char timestamp[20];   // "2025-04-22T14:00:00"
 } esfera_data_t;
 
+_Static_assert(sizeof(esfera_data_t) == 20, "esfera_data_t debe medir 20 bytes");
+
+#define ESFERA_MANAGER_PAGINA_MAX   100     // Lecturas por página (~16 KB de JSON)
+
+typedef struct {
+    uint32_t capacidad;     // Por mitad del doble buffer
+    uint32_t ocupacion;
+    uint32_t sobrescritas;  // Lecturas antiguas pisadas con el buffer lleno
+    uint32_t rechazadas;    // Lecturas nuevas descartadas con el buffer lleno
+} esfera_manager_stats_t;
+
+/**
+ * @brief Reserva el buffer circular de lecturas (CONFIG_ESFERA_BUFFER_CAPACIDAD,
+ *        en PSRAM si CONFIG_ESFERA_BUFFER_PSRAM) e inicializa el registro.
+ */
 void esfera_manager_init(void);
-void esfera_manager_add(const char *raw_payload, const char *mac_origen);
+/**
+ * @brief Agrega una lectura al buffer.
+ *
+ * @param indice Índice en esfera_registry para la tabla de estado, o
+ *               ESFERA_REGISTRY_NINGUNA si la esfera no pudo registrarse.
+ * @param lectura Lectura decodificada.
+ * @param epoch Momento de la medición (recepción menos edad_s de la muestra).
+ */
+void esfera_manager_add(uint16_t indice, const esfera_lectura_t *lectura, time_t epoch);
+/**
+ * @brief Formatea MAC ("A085E369D6AC") y timestamp ("2025-04-22T14:00:00") de una lectura.
+ */
+void esfera_data_formatear(const esfera_data_t *e, char mac[13], char timestamp[20]);
+
+/**
+ * @brief Toma un snapshot consistente de las lecturas pendientes.
+ *
+ * Intercambia las mitades del doble buffer: la ingesta sigue escribiendo en
+ * la otra sin bloquearse. Mientras no se libere, llamadas repetidas devuelven
+ * el mismo snapshot. Solo debe usarse desde una tarea (el publicador).
+ *
+ * @return Cantidad de lecturas del snapshot.
+ */
+size_t esfera_manager_snapshot_tomar(void);
+
+/**
+ * @brief Lectura i del snapshot tomado, de la más antigua a la más nueva.
+ */
+const esfera_data_t *esfera_manager_snapshot_leer(size_t i);
+
+/**
+ * @brief Copia las lecturas en RAM (snapshot retenido y mitad activa, de la más
+ *        antigua a la más nueva) sin tomar ni alterar el snapshot.
+ *
+ * La ingesta espera solo mientras se copia la mitad activa. Debe llamarse desde
+ * la misma tarea que toma los snapshots.
+ *
+ * @param n Lecturas copiadas.
+ * @return Buffer a liberar con free(), o NULL sin memoria.
+ */
+esfera_data_t *esfera_manager_copiar(size_t *n);
+
+/**
+ * @brief Descarta las lecturas del snapshot (ya publicadas).
+ */
+void esfera_manager_snapshot_liberar(void);
+
+/**
+ * @brief Serializa el snapshot actual (lo toma si no hay uno retenido) en streaming.
+ *
+ * @param buf Buffer de trabajo; con salida != NULL se entrega por tramos.
+ * @param cap Tamaño de buf.
+ * @param salida Destino de cada tramo, o NULL si buf alcanza para todo.
+ * @param total Opcional: bytes del documento (con buf NULL solo se cuentan).
+ */
+esp_err_t esfera_manager_write_json(char *buf, size_t cap, esfera_json_salida_t salida, void *ctx, size_t *total);
+
+/**
+ * @brief Serializa el snapshot actual en un string reservado a la medida.
+ *        Hay que liberarlo con free().
+ */
 char *esfera_manager_generate_json(void);
+
+/**
+ * @brief Serializa el snapshot actual como bloques de esfera_codec concatenados,
+ *        un bloque por esfera (o más, cada ESFERA_CODEC_MAX_MUESTRAS lecturas).
+ *
+ * @param len Bytes del resultado.
+ * @return Buffer a liberar con free(), o NULL sin memoria.
+ */
+uint8_t *esfera_manager_generate_bloques(size_t *len);
+
+/**
+ * @brief Serializa el snapshot actual en CBOR: un array con un mapa por lectura,
+ *        claves enteras ESFERA_CBOR_* y valores en punto fijo (las mismas
+ *        unidades que esfera_data_t, sin pasar por float).
+ *
+ * @param len Bytes del resultado.
+ * @return Buffer a liberar con free(), o NULL sin memoria.
+ */
+uint8_t *esfera_manager_generate_cbor(size_t *len);
+
+/**
+ * @brief Página del snapshot: {"Datos":[...],"Cursor":c,"Restantes":r}.
+ *
+ * El cursor recibido confirma (y libera) las lecturas enviadas antes de él; la
+ * página siguiente empieza ahí. Sin confirmar, la misma página se reenvía.
+ * "Cursor" de la respuesta es el valor a mandar en el próximo pedido.
+ *
+ * @param cursor Cursor de la respuesta anterior, o NULL en el primer pedido.
+ * @param limite Lecturas por página, hasta ESFERA_MANAGER_PAGINA_MAX (0 = máximo).
+ * @return String a liberar con free(), o NULL sin memoria.
+ */
+char *esfera_manager_generate_pagina(const uint32_t *cursor, size_t limite);
+
+/**
+ * @brief Confirma las lecturas enviadas con cursor menor que el dado.
+ * @return ESP_ERR_INVALID_ARG si el cursor no corresponde a lo enviado.
+ */
+esp_err_t esfera_manager_confirmar(uint32_t cursor);
+
+/**
+ * @brief Descarta el snapshot; las lecturas recibidas después no se pierden.
+ */
 void esfera_manager_clear(void);
-esp_err_t esfera_manager_register_mac(const char *mac);
+
+/**
+ * @brief Contadores del doble buffer; se puede llamar desde cualquier tarea
+ * (la ocupación es aproximada mientras la ingesta escribe).
+ */
+void esfera_manager_get_stats(esfera_manager_stats_t *stats);
@@ -0,0 +1,206 @@
+#include "esfera_registry.h"
+#include <stdio.h>
+#include <string.h>
+#include <stdatomic.h>
+#include "esp_log.h"
+#include "nvs_flash.h"
+
+#define REGISTRY_NS         "esferas"
+#define TABLA_SLOTS         (ESFERA_REGISTRY_MAX * 2)   // Potencia de 2, factor de carga <= 0.5
+#define TABLA_MASK          (TABLA_SLOTS - 1)
+#define SLOT_VACIO          0xFFFF
+
+_Static_assert((TABLA_SLOTS & TABLA_MASK) == 0, "TABLA_SLOTS debe ser potencia de 2");
+
+static const char *TAG = "ESFERA_REGISTRY";
+
+typedef struct {
+    uint8_t mac[6];
+    bool pendiente;     // Aún no persistida en NVS
+} registro_t;
+
+// Tabla de direccionamiento abierto (sondeo lineal) que guarda índices densos
+// a s_registros. Las entradas solo se agregan, nunca se borran individualmente.
+static uint16_t s_tabla[TABLA_SLOTS];
+static registro_t s_registros[ESFERA_REGISTRY_MAX];
+static atomic_size_t s_count;
+static size_t s_pendientes;
+static atomic_bool s_reset_pedido;
+
+static uint32_t hash_mac(const uint8_t mac[6])
+{
+    // FNV-1a de 32 bits
+    uint32_t h = 2166136261u;
+    for (int i = 0; i < 6; i++) {
+        h ^= mac[i];
+        h *= 16777619u;
+    }
+    return h;
+}
+
+void esfera_registry_mac_a_texto(const uint8_t mac[6], char texto[13])
+{
+    snprintf(texto, 13, "%02X%02X%02X%02X%02X%02X", mac[0], mac[1], mac[2], mac[3], mac[4], mac[5]);
+}
+
+static int valor_hex(char c)
+{
+    if (c >= '0' && c <= '9') return c - '0';
+    if (c >= 'A' && c <= 'F') return c - 'A' + 10;
+    if (c >= 'a' && c <= 'f') return c - 'a' + 10;
+    return -1;
+}
+
+bool esfera_registry_mac_desde_texto(const char *texto, uint8_t mac[6])
+{
+    int n = 0;
+    for (const char *p = texto; *p; p++) {
+        if (*p == ':') continue;
+        int v = valor_hex(*p);
+        if (v < 0 || n >= 12) return false;
+        if (n % 2 == 0) mac[n / 2] = (uint8_t)(v << 4);
+        else mac[n / 2] |= (uint8_t)v;
+        n++;
+    }
+    return n == 12;
+}
+
+static void vaciar(void)
+{
+    memset(s_tabla, 0xFF, sizeof(s_tabla));
+    memset(s_registros, 0, sizeof(s_registros));
+    atomic_store(&s_count, 0);
+    s_pendientes = 0;
+}
+
+static void aplicar_reset_pedido(void)
+{
+    if (atomic_exchange(&s_reset_pedido, false)) {
+        vaciar();
+        ESP_LOGI(TAG, "🧹 Registro de esferas vaciado");
+    }
+}
+
+// Devuelve el slot de la tabla donde está la MAC o el primer slot vacío del sondeo
+static uint32_t buscar_slot(const uint8_t mac[6])
+{
+    uint32_t slot = hash_mac(mac) & TABLA_MASK;
+    while (s_tabla[slot] != SLOT_VACIO && memcmp(s_registros[s_tabla[slot]].mac, mac, 6) != 0) {
+        slot = (slot + 1) & TABLA_MASK;
+    }
+    return slot;
+}
+
+static esp_err_t insertar(const uint8_t mac[6], bool pendiente, uint16_t *indice, bool *nueva)
+{
+    uint32_t slot = buscar_slot(mac);
+    if (s_tabla[slot] != SLOT_VACIO) {
+        if (indice) *indice = s_tabla[slot];
+        if (nueva) *nueva = false;
+        return ESP_OK;
+    }
+
+    size_t count = atomic_load(&s_count);
+    if (count >= ESFERA_REGISTRY_MAX) return ESP_ERR_NO_MEM;
+
+    registro_t *r = &s_registros[count];
+    memcpy(r->mac, mac, 6);
+    r->pendiente = pendiente;
+    s_tabla[slot] = (uint16_t)count;
+    atomic_store_explicit(&s_count, count + 1, memory_order_release);
+    if (pendiente) s_pendientes++;
+
+    if (indice) *indice = (uint16_t)count;
+    if (nueva) *nueva = true;
+    return ESP_OK;
+}
+
+esp_err_t esfera_registry_init(void)
+{
+    vaciar();
+
+    nvs_iterator_t it = NULL;
+    esp_err_t err = nvs_entry_find(NVS_DEFAULT_PART_NAME, REGISTRY_NS, NVS_TYPE_STR, &it);
+    while (err == ESP_OK) {
+        nvs_entry_info_t info;
+        nvs_entry_info(it, &info);
+
+        uint8_t mac[6];
+        if (!esfera_registry_mac_desde_texto(info.key, mac)) {
+            ESP_LOGW(TAG, "⚠️ Clave inválida en NVS: %s", info.key);
+        } else if (insertar(mac, false, NULL, NULL) == ESP_ERR_NO_MEM) {
+            ESP_LOGW(TAG, "⚠️ Registro lleno, se ignoran esferas restantes en NVS");
+            break;
+        }
+        err = nvs_entry_next(&it);
+    }
+    nvs_release_iterator(it);
+
+    ESP_LOGI(TAG, "📋 %u esferas cargadas desde NVS", (unsigned)atomic_load(&s_count));
+    return (err == ESP_OK || err == ESP_ERR_NVS_NOT_FOUND) ? ESP_OK : err;
+}
+
+esp_err_t esfera_registry_register(const uint8_t mac[6], uint16_t *indice, bool *nueva)
+{
+    aplicar_reset_pedido();
+    return insertar(mac, true, indice, nueva);
+}
+
+uint16_t esfera_registry_find(const uint8_t mac[6])
+{
+    uint32_t slot = buscar_slot(mac);
+    return s_tabla[slot];
+}
+
+const uint8_t *esfera_registry_mac(uint16_t indice)
+{
+    return s_registros[indice].mac;
+}
+
+size_t esfera_registry_count(void)
+{
+    return atomic_load_explicit(&s_count, memory_order_acquire);
+}
+
+esp_err_t esfera_registry_flush(void)
+{
+    aplicar_reset_pedido();
+    if (s_pendientes == 0) return ESP_OK;
+
+    nvs_handle_t handle;
+    esp_err_t err = nvs_open(REGISTRY_NS, NVS_READWRITE, &handle);
+    if (err != ESP_OK) return err;
+
+    size_t count = atomic_load(&s_count);
+    size_t escritas = 0;
+    for (size_t i = 0; i < count && err == ESP_OK; i++) {
+        if (!s_registros[i].pendiente) continue;
+
+        char clave[13];
+        esfera_registry_mac_a_texto(s_registros[i].mac, clave);
+        err = nvs_set_str(handle, clave, "registered");
+        if (err == ESP_OK) {
+            s_registros[i].pendiente = false;
+            escritas++;
+        }
+    }
+
+    if (escritas > 0) {
+        esp_err_t c = nvs_commit(handle);
+        if (err == ESP_OK) err = c;
+    }
+    nvs_close(handle);
+
+    s_pendientes -= escritas;
+    if (err != ESP_OK) {
+        ESP_LOGE(TAG, "❌ Error persistiendo esferas: %s", esp_err_to_name(err));
+    } else {
+        ESP_LOGI(TAG, "💾 %u esferas nuevas persistidas en NVS", (unsigned)escritas);
+    }
+    return err;
+}
+
+void esfera_registry_reset(void)
+{
+    atomic_store(&s_reset_pedido, true);
+}
@@ -0,0 +1,60 @@
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdbool.h>
+#include "esp_err.h"
+
+#define ESFERA_REGISTRY_MAX       128       // Esferas distintas que puede recordar el hub
+#define ESFERA_REGISTRY_NINGUNA   0xFFFF    // Índice inválido
+
+/**
+ * @brief Carga una única vez el namespace "esferas" de NVS en la tabla en RAM.
+ */
+esp_err_t esfera_registry_init(void);
+
+/**
+ * @brief Busca la MAC y, si no existe, la agrega en RAM y la deja pendiente de
+ *        persistir. No toca la flash.
+ *
+ * Solo debe llamarse desde la tarea de ingesta.
+ *
+ * @param mac MAC binaria de 6 bytes.
+ * @param indice Índice denso de la esfera (0..count-1), estable hasta reiniciar.
+ * @param nueva true si la esfera no estaba registrada.
+ * @return ESP_OK o ESP_ERR_NO_MEM si la tabla está llena.
+ */
+esp_err_t esfera_registry_register(const uint8_t mac[6], uint16_t *indice, bool *nueva);
+
+/**
+ * @brief Devuelve el índice de la MAC o ESFERA_REGISTRY_NINGUNA.
+ */
+uint16_t esfera_registry_find(const uint8_t mac[6]);
+
+/**
+ * @brief MAC binaria de un índice válido.
+ */
+const uint8_t *esfera_registry_mac(uint16_t indice);
+
+size_t esfera_registry_count(void);
+
+/**
+ * @brief Formatea la MAC como "A085E369D6AC" (formato de las claves en NVS).
+ */
+void esfera_registry_mac_a_texto(const uint8_t mac[6], char texto[13]);
+
+/**
+ * @brief Parsea 12 dígitos hexadecimales, con o sin ':' intercalados.
+ */
+bool esfera_registry_mac_desde_texto(const char *texto, uint8_t mac[6]);
+
+/**
+ * @brief Persiste en un solo commit todas las esferas nuevas pendientes.
+ */
+esp_err_t esfera_registry_flush(void);
+
+/**
+ * @brief Pide vaciar la tabla en RAM (p.ej. tras borrar el namespace en NVS).
+ *        Se aplica en la próxima operación de la tarea de ingesta.
+ */
+void esfera_registry_reset(void);
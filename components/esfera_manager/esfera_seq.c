@@ -0,0 +1,113 @@
+#include "esfera_seq.h"
+#include <string.h>
+#include <stdbool.h>
+#include "esp_log.h"
+#include "freertos/FreeRTOS.h"
+#include "esfera_registry.h"
+
+static const char *TAG = "ESFERA_SEQ";
+
+typedef struct {
+    uint8_t mac[6];         // Valida que el estado corresponda al índice actual del registro
+    bool iniciada;
+    uint16_t max_seq;
+    uint64_t ventana;       // Bit i = se recibió max_seq - i
+    int64_t ultimo_us;      // Recepción de la última secuencia aceptada
+    esfera_seq_stats_t stats;
+} seq_estado_t;
+
+// El estado lo escribe solo la ingesta; los contadores se publican bajo s_lock
+// para que "Estado" (tarea de comandos) los copie enteros
+static seq_estado_t s_estado[ESFERA_REGISTRY_MAX];
+static portMUX_TYPE s_lock = portMUX_INITIALIZER_UNLOCKED;
+
+static void reiniciar(seq_estado_t *e, uint16_t seq)
+{
+    e->iniciada = true;
+    e->max_seq = seq;
+    e->ventana = 1;
+}
+
+// Trabaja sobre una copia de los contadores, que esfera_seq_check publica al final
+static esfera_seq_res_t verificar(seq_estado_t *e, uint16_t indice, uint16_t seq, int64_t rx_us,
+                                  esfera_seq_stats_t *stats)
+{
+    const uint8_t *mac = esfera_registry_mac(indice);
+
+    if (!e->iniciada || memcmp(e->mac, mac, 6) != 0) {
+        memcpy(e->mac, mac, 6);
+        reiniciar(e, seq);
+        e->ultimo_us = rx_us;
+        memset(stats, 0, sizeof(*stats));
+        stats->recibidas++;
+        return ESFERA_SEQ_NUEVA;
+    }
+
+    int16_t delta = (int16_t)(seq - e->max_seq);
+    bool reciente = rx_us - e->ultimo_us <= ESFERA_SEQ_REINTENTO_MS * 1000LL;
+
+    // Hacia atrás fuera de la ventana o del plazo de reintento, o un salto
+    // hacia adelante imposible: la esfera reinició su contador. No es pérdida.
+    if ((delta <= 0 && (-delta >= ESFERA_SEQ_VENTANA || !reciente)) || delta > ESFERA_SEQ_SALTO_MAX) {
+        ESP_LOGD(TAG, "Esfera %u reinició su secuencia (%u -> %u)", indice, e->max_seq, seq);
+        reiniciar(e, seq);
+        e->ultimo_us = rx_us;
+        stats->reinicios++;
+        stats->recibidas++;
+        return ESFERA_SEQ_NUEVA;
+    }
+
+    if (delta > 0) {
+        if (delta > 1) {
+            stats->perdidas += delta - 1;
+            ESP_LOGD(TAG, "Hueco de %d tramas en esfera %u (seq %u)", delta - 1, indice, seq);
+        }
+        e->ventana = delta >= ESFERA_SEQ_VENTANA ? 0 : e->ventana << delta;
+        e->ventana |= 1;
+        e->max_seq = seq;
+        e->ultimo_us = rx_us;
+        stats->recibidas++;
+        return ESFERA_SEQ_NUEVA;
+    }
+
+    int desplazamiento = -delta;
+    uint64_t bit = 1ULL << desplazamiento;
+    if (e->ventana & bit) {
+        stats->duplicadas++;
+        return ESFERA_SEQ_DUPLICADA;
+    }
+
+    // Llegó tarde: ya se había contado como perdida
+    e->ventana |= bit;
+    if (stats->perdidas > 0) stats->perdidas--;
+    stats->fuera_de_orden++;
+    stats->recibidas++;
+    e->ultimo_us = rx_us;
+    return ESFERA_SEQ_NUEVA;
+}
+
+esfera_seq_res_t esfera_seq_check(uint16_t indice, uint16_t seq, int64_t rx_us)
+{
+    seq_estado_t *e = &s_estado[indice];
+    esfera_seq_stats_t stats = e->stats;
+    esfera_seq_res_t res = verificar(e, indice, seq, rx_us, &stats);
+
+    taskENTER_CRITICAL(&s_lock);
+    e->stats = stats;
+    taskEXIT_CRITICAL(&s_lock);
+    return res;
+}
+
+esp_err_t esfera_seq_get_stats(uint16_t indice, esfera_seq_stats_t *stats)
+{
+    if (indice >= ESFERA_REGISTRY_MAX) return ESP_ERR_NOT_FOUND;
+
+    // Tras un reset del registro el índice puede pertenecer a otra esfera
+    const seq_estado_t *e = &s_estado[indice];
+    const uint8_t *mac = esfera_registry_mac(indice);
+    taskENTER_CRITICAL(&s_lock);
+    bool valida = e->iniciada && memcmp(e->mac, mac, 6) == 0;
+    if (valida) *stats = e->stats;
+    taskEXIT_CRITICAL(&s_lock);
+    return valida ? ESP_OK : ESP_ERR_NOT_FOUND;
+}
@@ -0,0 +1,44 @@
+#pragma once
+
+#include <stdint.h>
+#include "esp_err.h"
+
+#define ESFERA_SEQ_VENTANA      64      // Secuencias recordadas detrás de la más alta
+#define ESFERA_SEQ_REINTENTO_MS 5000    // Plazo en que una secuencia vieja puede ser retransmisión
+#define ESFERA_SEQ_SALTO_MAX    1024    // Mayor salto hacia adelante que se cuenta como pérdida
+
+typedef enum {
+    ESFERA_SEQ_NUEVA = 0,       // Lectura válida (en orden, tardía dentro de la ventana o tras reinicio)
+    ESFERA_SEQ_DUPLICADA,       // Ya recibida: retransmisión ESP-NOW o reintento de la esfera
+} esfera_seq_res_t;
+
+typedef struct {
+    uint32_t recibidas;         // Secuencias distintas aceptadas
+    uint32_t duplicadas;
+    uint32_t perdidas;          // Huecos detectados (descontando las que llegaron tarde)
+    uint32_t fuera_de_orden;    // Llegaron tarde pero dentro de la ventana
+    uint32_t reinicios;         // Contador reiniciado (salto hacia atrás o salto grande)
+} esfera_seq_stats_t;
+
+/**
+ * @brief Ventana deslizante por esfera para descartar duplicados y contar huecos.
+ *
+ * Las tramas no traen un identificador de arranque, así que el reinicio de
+ * una esfera se deduce: una secuencia hacia atrás solo se toma como
+ * retransmisión o llegada tardía si llega dentro de ESFERA_SEQ_REINTENTO_MS
+ * de la última trama aceptada; si no, o si salta hacia adelante más de
+ * ESFERA_SEQ_SALTO_MAX, la esfera reinició y el salto no suma pérdidas.
+ *
+ * Solo debe llamarse desde la tarea de ingesta.
+ *
+ * @param indice Índice de la esfera en esfera_registry.
+ * @param seq Secuencia de la trama binaria.
+ * @param rx_us Momento de recepción de la trama (esp_timer_get_time()).
+ */
+esfera_seq_res_t esfera_seq_check(uint16_t indice, uint16_t seq, int64_t rx_us);
+
+/**
+ * @brief Copia consistente de los contadores de la esfera, desde cualquier tarea.
+ * @return ESP_ERR_NOT_FOUND si la esfera del índice nunca envió secuencias.
+ */
+esp_err_t esfera_seq_get_stats(uint16_t indice, esfera_seq_stats_t *stats);
@@ -0,0 +1,222 @@
+#include "esfera_stats.h"
+#include <stdlib.h>
+#include <string.h>
+#include "sdkconfig.h"
+#include "esp_log.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/semphr.h"
+#include "esfera_registry.h"
+#include "esfera_seq.h"
+#include "esfera_json.h"
+
+static const char *TAG = "ESFERA_STATS";
+
+typedef struct {
+    int32_t min;
+    int32_t max;
+    int64_t suma;
+    int32_t ewma_x256;      // Punto fijo para no perder resolución al promediar
+} acumulador_t;
+
+typedef struct {
+    bool valida;
+    esfera_data_t ultima;
+    uint32_t ventana_inicio;
+    uint32_t muestras;
+    acumulador_t metricas[3];   // humedad, temperatura, voltaje
+} entrada_t;
+
+static entrada_t s_tabla[ESFERA_REGISTRY_MAX];
+static uint32_t s_ventana_s = CONFIG_ESFERA_STATS_VENTANA_S;
+static uint8_t s_ewma_shift = CONFIG_ESFERA_STATS_EWMA_SHIFT;
+static SemaphoreHandle_t s_mutex;
+
+void esfera_stats_init(void)
+{
+    if (!s_mutex) s_mutex = xSemaphoreCreateMutex();
+    memset(s_tabla, 0, sizeof(s_tabla));
+    esfera_stats_configurar(CONFIG_ESFERA_STATS_VENTANA_S, CONFIG_ESFERA_STATS_EWMA_SHIFT);
+}
+
+void esfera_stats_configurar(uint32_t ventana_s, uint8_t ewma_shift)
+{
+    if (ventana_s == 0 || ewma_shift > 8) return;
+
+    xSemaphoreTake(s_mutex, portMAX_DELAY);
+    s_ventana_s = ventana_s;
+    s_ewma_shift = ewma_shift;
+    for (size_t i = 0; i < ESFERA_REGISTRY_MAX; i++) {
+        s_tabla[i].muestras = 0;
+    }
+    xSemaphoreGive(s_mutex);
+    ESP_LOGI(TAG, "⚙️ Ventana %u s, EWMA 1/%u", (unsigned)ventana_s, 1u << ewma_shift);
+}
+
+static void acumular(acumulador_t *a, int32_t valor, bool nueva_ventana, bool primera_muestra, bool en_ventana)
+{
+    if (nueva_ventana) {
+        a->min = a->max = valor;
+        a->suma = 0;
+    }
+    if (en_ventana) {
+        if (valor < a->min) a->min = valor;
+        if (valor > a->max) a->max = valor;
+        a->suma += valor;
+    }
+
+    int32_t v = valor * 256;
+    if (primera_muestra) a->ewma_x256 = v;
+    else a->ewma_x256 += (v - a->ewma_x256) >> s_ewma_shift;
+}
+
+void esfera_stats_actualizar(uint16_t indice, const esfera_data_t *dato)
+{
+    if (indice >= ESFERA_REGISTRY_MAX) return;
+
+    xSemaphoreTake(s_mutex, portMAX_DELAY);
+    entrada_t *e = &s_tabla[indice];
+
+    // Tras un reset del registro el índice puede pertenecer a otra esfera
+    bool primera_muestra = !e->valida || memcmp(e->ultima.mac, dato->mac, sizeof(dato->mac)) != 0;
+    if (primera_muestra) e->muestras = 0;
+
+    uint32_t inicio = dato->epoch - dato->epoch % s_ventana_s;
+    bool nueva_ventana = e->muestras == 0 || inicio > e->ventana_inicio;
+    if (nueva_ventana) {
+        e->ventana_inicio = inicio;
+        e->muestras = 0;
+    }
+
+    // Una lectura atrasada (lote v3) entra en la EWMA pero no desplaza a la
+    // última lectura; si es de una ventana anterior tampoco cuenta en la actual
+    if (!e->valida || primera_muestra || dato->epoch >= e->ultima.epoch) e->ultima = *dato;
+    bool en_ventana = inicio == e->ventana_inicio;
+
+    acumular(&e->metricas[0], dato->humedad, nueva_ventana, primera_muestra, en_ventana);
+    acumular(&e->metricas[1], dato->temperatura, nueva_ventana, primera_muestra, en_ventana);
+    acumular(&e->metricas[2], dato->voltaje_mv, nueva_ventana, primera_muestra, en_ventana);
+    if (en_ventana) e->muestras++;
+    e->valida = true;
+    xSemaphoreGive(s_mutex);
+}
+
+static void exportar(const acumulador_t *a, uint32_t muestras, esfera_stats_metrica_t *m)
+{
+    m->min = a->min;
+    m->max = a->max;
+    m->media = muestras ? (int32_t)(a->suma / (int64_t)muestras) : 0;
+    m->ewma = a->ewma_x256 / 256;
+}
+
+bool esfera_stats_get(uint16_t indice, esfera_stats_t *out)
+{
+    if (indice >= ESFERA_REGISTRY_MAX) return false;
+
+    xSemaphoreTake(s_mutex, portMAX_DELAY);
+    const entrada_t *e = &s_tabla[indice];
+    bool valida = e->valida;
+    if (valida) {
+        out->ultima = e->ultima;
+        out->ventana_inicio = e->ventana_inicio;
+        out->muestras = e->muestras;
+        exportar(&e->metricas[0], e->muestras, &out->humedad);
+        exportar(&e->metricas[1], e->muestras, &out->temperatura);
+        exportar(&e->metricas[2], e->muestras, &out->voltaje_mv);
+    }
+    xSemaphoreGive(s_mutex);
+    return valida;
+}
+
+// Cota de una entrada de "Estado": 330 bytes de claves, MAC, timestamp y
+// separadores + 22 números de hasta 25 caracteres
+#define ESTADO_ENTRADA_MAX  (330 + 22 * 25)
+
+static void escribir_metrica(esfera_json_t *w, int32_t actual, const esfera_stats_metrica_t *m, double escala)
+{
+    ESFERA_JSON_LIT(w, "{\"actual\":");
+    esfera_json_numero(w, actual / escala);
+    ESFERA_JSON_LIT(w, ",\"min\":");
+    esfera_json_numero(w, m->min / escala);
+    ESFERA_JSON_LIT(w, ",\"max\":");
+    esfera_json_numero(w, m->max / escala);
+    ESFERA_JSON_LIT(w, ",\"media\":");
+    esfera_json_numero(w, m->media / escala);
+    ESFERA_JSON_LIT(w, ",\"ewma\":");
+    esfera_json_numero(w, m->ewma / escala);
+    ESFERA_JSON_LIT(w, "}");
+}
+
+static void escribir_entrada(esfera_json_t *w, uint16_t indice, const esfera_stats_t *st)
+{
+    char mac[13];
+    char timestamp[20];
+    esfera_data_formatear(&st->ultima, mac, timestamp);
+
+    ESFERA_JSON_LIT(w, "{\"mac\":");
+    esfera_json_texto(w, mac);
+    ESFERA_JSON_LIT(w, ",\"timestamp\":");
+    esfera_json_texto(w, timestamp);
+    ESFERA_JSON_LIT(w, ",\"riego\":");
+    esfera_json_numero(w, st->ultima.riego);
+    ESFERA_JSON_LIT(w, ",\"muestras\":");
+    esfera_json_numero(w, st->muestras);
+    ESFERA_JSON_LIT(w, ",\"humedad\":");
+    escribir_metrica(w, st->ultima.humedad, &st->humedad, 100.0);
+    ESFERA_JSON_LIT(w, ",\"temperatura\":");
+    escribir_metrica(w, st->ultima.temperatura, &st->temperatura, 100.0);
+    ESFERA_JSON_LIT(w, ",\"bateria\":");
+    escribir_metrica(w, st->ultima.voltaje_mv, &st->voltaje_mv, 1000.0);
+
+    // Solo las tramas binarias traen secuencia
+    esfera_seq_stats_t seq;
+    if (esfera_seq_get_stats(indice, &seq) == ESP_OK) {
+        ESFERA_JSON_LIT(w, ",\"secuencia\":{\"recibidas\":");
+        esfera_json_numero(w, seq.recibidas);
+        ESFERA_JSON_LIT(w, ",\"perdidas\":");
+        esfera_json_numero(w, seq.perdidas);
+        ESFERA_JSON_LIT(w, ",\"duplicadas\":");
+        esfera_json_numero(w, seq.duplicadas);
+        ESFERA_JSON_LIT(w, ",\"fuera_de_orden\":");
+        esfera_json_numero(w, seq.fuera_de_orden);
+        ESFERA_JSON_LIT(w, ",\"reinicios\":");
+        esfera_json_numero(w, seq.reinicios);
+        ESFERA_JSON_LIT(w, "}");
+    }
+    ESFERA_JSON_LIT(w, "}");
+}
+
+char *esfera_stats_generate_json(void)
+{
+    // Una sola reserva con la cota de peor caso para las esferas con lecturas;
+    // si aparece otra mientras se escribe, queda para el próximo pedido
+    size_t esferas = 0;
+    xSemaphoreTake(s_mutex, portMAX_DELAY);
+    for (uint16_t i = 0; i < ESFERA_REGISTRY_MAX; i++) {
+        if (s_tabla[i].valida) esferas++;
+    }
+    xSemaphoreGive(s_mutex);
+    size_t cap = 16 + esferas * ESTADO_ENTRADA_MAX;
+    char *json_string = malloc(cap + 1);
+    if (!json_string) {
+        ESP_LOGE(TAG, "❌ Error asignando %u bytes para JSON", (unsigned)(cap + 1));
+        return NULL;
+    }
+
+    esfera_json_t w;
+    esfera_json_init(&w, json_string, cap, NULL, NULL);
+    ESFERA_JSON_LIT(&w, "{\"Estado\":[");
+    size_t escritas = 0;
+    for (uint16_t i = 0; i < ESFERA_REGISTRY_MAX && escritas < esferas; i++) {
+        esfera_stats_t st;
+        if (!esfera_stats_get(i, &st)) continue;
+        if (escritas++ > 0) ESFERA_JSON_LIT(&w, ",");
+        escribir_entrada(&w, i, &st);
+    }
+    ESFERA_JSON_LIT(&w, "]}");
+    if (esfera_json_fin(&w) != ESP_OK) {
+        free(json_string);
+        return NULL;
+    }
+    json_string[w.total] = '\0';
+    return json_string;
+}
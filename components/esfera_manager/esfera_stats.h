@@ -0,0 +1,57 @@
+#pragma once
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <time.h>
+#include "esfera_manager.h"
+
+typedef struct {
+    int32_t min;
+    int32_t max;
+    int32_t media;
+    int32_t ewma;
+} esfera_stats_metrica_t;
+
+/**
+ * @brief Estado de una esfera: última lectura y estadísticas de la ventana actual.
+ *        Los valores están en las mismas unidades que esfera_data_t.
+ */
+typedef struct {
+    esfera_data_t ultima;
+    uint32_t ventana_inicio;    // Epoch de inicio de la ventana
+    uint32_t muestras;          // Lecturas en la ventana
+    esfera_stats_metrica_t humedad;
+    esfera_stats_metrica_t temperatura;
+    esfera_stats_metrica_t voltaje_mv;
+} esfera_stats_t;
+
+/**
+ * @brief Vacía la tabla y aplica CONFIG_ESFERA_STATS_VENTANA_S y CONFIG_ESFERA_STATS_EWMA_SHIFT.
+ */
+void esfera_stats_init(void);
+
+/**
+ * @brief Cambia el largo de la ventana y el peso de la EWMA. Reinicia las ventanas en curso.
+ */
+void esfera_stats_configurar(uint32_t ventana_s, uint8_t ewma_shift);
+
+/**
+ * @brief Incorpora una lectura en O(1). Se llama desde la tarea de ingesta.
+ *
+ * Una lectura atrasada de una ventana anterior (lote v3) solo actualiza la EWMA.
+ *
+ * @param indice Índice de la esfera en esfera_registry.
+ */
+void esfera_stats_actualizar(uint16_t indice, const esfera_data_t *dato);
+
+/**
+ * @brief Copia el estado de una esfera.
+ * @return false si la esfera no tiene lecturas.
+ */
+bool esfera_stats_get(uint16_t indice, esfera_stats_t *out);
+
+/**
+ * @brief JSON {"Estado":[...]} con el estado de todas las esferas con lecturas.
+ *        Hay que liberarlo con free().
+ */
+char *esfera_stats_generate_json(void);
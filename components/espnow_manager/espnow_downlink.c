@@ -0,0 +1,371 @@
+#include "espnow_downlink.h"
+#include "espnow_peers.h"
+#include <string.h>
+#include <inttypes.h>
+#include <stdatomic.h>
+#include "esp_log.h"
+#include "esp_timer.h"
+#include "esp_mac.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "freertos/queue.h"
+#include "freertos/semphr.h"
+
+#define DOWNLINK_TASK_STACK     4096
+#define DOWNLINK_TASK_PRIO      5
+#define DOWNLINK_EVENTOS        16
+#define DOWNLINK_TIMEOUT_CB_MS  200     // Sin callback de envío en este plazo se considera fallo
+#define NINGUNO                 (-1)
+#define MAX_NOTIFICACIONES      4
+
+static const char *TAG = "ESPNOW_DOWNLINK";
+
+typedef enum { EV_NUEVA, EV_RESULTADO } evento_tipo_t;
+
+typedef struct {
+    evento_tipo_t tipo;
+    uint8_t mac[ESP_NOW_ETH_ALEN];
+    bool ok;
+    uint32_t generacion;    // Número de envío al que responde el callback
+} evento_t;
+
+typedef struct {
+    uint8_t data[ESP_NOW_MAX_DATA_LEN];
+    uint16_t len;
+    uint32_t etiqueta;
+    uint8_t intentos;
+    int64_t encolada_us;
+    int64_t lista_us;       // No se reintenta antes (backoff)
+    int8_t siguiente;       // Siguiente trama del mismo peer o de la lista libre
+} trama_dl_t;
+
+typedef struct {
+    uint8_t mac[ESP_NOW_ETH_ALEN];
+    bool usado;
+    int8_t cabeza;
+    int8_t cola;
+    uint8_t n;
+    int64_t ultimo_us;
+} peer_dl_t;
+
+typedef struct {
+    uint8_t mac[ESP_NOW_ETH_ALEN];
+    uint32_t etiqueta;
+    bool ok;
+} notificacion_t;
+
+static trama_dl_t s_pool[ESPNOW_DOWNLINK_POOL];
+static int8_t s_libres = NINGUNO;
+static peer_dl_t s_peers[ESPNOW_DOWNLINK_MAX_PEERS];
+static espnow_downlink_stats_t s_totales;
+
+// Solo una trama en vuelo a la vez. Cada esp_now_send aceptado recibe exactamente
+// un callback y en orden, así que numerar envíos y callbacks los empareja: un
+// callback que llega después del timeout lleva el número de un intento viejo y se
+// ignora aunque el peer en vuelo sea el mismo.
+static int s_en_vuelo = NINGUNO;
+static int64_t s_en_vuelo_us;
+static uint32_t s_en_vuelo_gen;
+static uint32_t s_enviados;             // Solo la tarea de downlink
+static atomic_uint s_callbacks;         // Solo el callback de envío
+static int s_turno;
+
+static notificacion_t s_notif[MAX_NOTIFICACIONES];
+static int s_n_notif;
+
+static SemaphoreHandle_t s_mutex;
+static QueueHandle_t s_eventos;
+static TaskHandle_t s_task;
+static espnow_downlink_resultado_t s_resultado;
+
+// ============================================================
+//   POOL Y PEERS (llamar con s_mutex tomado)
+// ============================================================
+static int8_t pool_tomar(void)
+{
+    int8_t i = s_libres;
+    if (i != NINGUNO) s_libres = s_pool[i].siguiente;
+    return i;
+}
+
+static void pool_devolver(int8_t i)
+{
+    s_pool[i].siguiente = s_libres;
+    s_libres = i;
+}
+
+static peer_dl_t *buscar_o_crear_peer(const uint8_t *mac)
+{
+    int libre = NINGUNO;
+    int inactivo = NINGUNO;
+    for (int i = 0; i < ESPNOW_DOWNLINK_MAX_PEERS; i++) {
+        peer_dl_t *p = &s_peers[i];
+        if (!p->usado) {
+            if (libre == NINGUNO) libre = i;
+        } else if (memcmp(p->mac, mac, ESP_NOW_ETH_ALEN) == 0) {
+            return p;
+        } else if (p->n == 0 && i != s_en_vuelo &&
+                   (inactivo == NINGUNO || p->ultimo_us < s_peers[inactivo].ultimo_us)) {
+            inactivo = i;
+        }
+    }
+
+    // Tabla llena: se recicla el peer sin cola con menos actividad reciente
+    int i = libre != NINGUNO ? libre : inactivo;
+    if (i == NINGUNO) return NULL;
+
+    peer_dl_t *p = &s_peers[i];
+    memset(p, 0, sizeof(*p));
+    memcpy(p->mac, mac, ESP_NOW_ETH_ALEN);
+    p->usado = true;
+    p->cabeza = p->cola = NINGUNO;
+    return p;
+}
+
+static void notificar(const peer_dl_t *p, uint32_t etiqueta, bool ok)
+{
+    if (s_n_notif >= MAX_NOTIFICACIONES) return;
+    notificacion_t *n = &s_notif[s_n_notif++];
+    memcpy(n->mac, p->mac, ESP_NOW_ETH_ALEN);
+    n->etiqueta = etiqueta;
+    n->ok = ok;
+}
+
+static uint32_t backoff_ms(uint8_t intentos)
+{
+    uint32_t ms = ESPNOW_DOWNLINK_BACKOFF_MS << (intentos - 1);
+    return ms > ESPNOW_DOWNLINK_BACKOFF_MAX_MS ? ESPNOW_DOWNLINK_BACKOFF_MAX_MS : ms;
+}
+
+static void actualizar_latencia(espnow_downlink_stats_t *s, uint32_t ms)
+{
+    // Media móvil exponencial con alfa = 1/8
+    if (s->entregadas == 1) {
+        s->latencia_media_ms = ms;
+    } else {
+        s->latencia_media_ms = (uint32_t)((int32_t)s->latencia_media_ms + ((int32_t)ms - (int32_t)s->latencia_media_ms) / 8);
+    }
+    if (ms > s->latencia_max_ms) s->latencia_max_ms = ms;
+}
+
+// Cierra el intento en curso de la trama en cabeza del peer
+static void completar(peer_dl_t *p, bool ok)
+{
+    int8_t i = p->cabeza;
+    trama_dl_t *t = &s_pool[i];
+    int64_t ahora = esp_timer_get_time();
+
+    if (!ok && t->intentos <= ESPNOW_DOWNLINK_REINTENTOS) {
+        t->lista_us = ahora + (int64_t)backoff_ms(t->intentos) * 1000;
+        return;
+    }
+
+    if (ok) {
+        uint32_t ms = (uint32_t)((ahora - t->encolada_us) / 1000);
+        s_totales.entregadas++;
+        actualizar_latencia(&s_totales, ms);
+    } else {
+        s_totales.fallidas++;
+        ESP_LOGW(TAG, "⚠️ Trama descartada para " MACSTR " tras %u intentos", MAC2STR(p->mac), t->intentos);
+    }
+    notificar(p, t->etiqueta, ok);
+
+    p->cabeza = t->siguiente;
+    if (p->cabeza == NINGUNO) p->cola = NINGUNO;
+    p->n--;
+    pool_devolver(i);
+}
+
+static void despachar(void)
+{
+    if (s_en_vuelo != NINGUNO) return;
+
+    int64_t ahora = esp_timer_get_time();
+    for (int k = 0; k < ESPNOW_DOWNLINK_MAX_PEERS; k++) {
+        int i = (s_turno + k) % ESPNOW_DOWNLINK_MAX_PEERS;
+        peer_dl_t *p = &s_peers[i];
+        if (!p->usado || p->n == 0) continue;
+
+        trama_dl_t *t = &s_pool[p->cabeza];
+        if (t->lista_us > ahora) continue;
+
+        s_turno = i + 1;
+        t->intentos++;
+        s_totales.intentos++;
+        p->ultimo_us = ahora;
+
+        esp_err_t err = espnow_peers_asegurar(p->mac);
+        if (err == ESP_OK) {
+            s_en_vuelo = i;
+            s_en_vuelo_us = ahora;
+            err = esp_now_send(p->mac, t->data, t->len);
+            if (err == ESP_OK) s_en_vuelo_gen = s_enviados++;
+        }
+        if (err != ESP_OK) {
+            s_en_vuelo = NINGUNO;
+            ESP_LOGD(TAG, "Envío a " MACSTR " rechazado: %s", MAC2STR(p->mac), esp_err_to_name(err));
+            completar(p, false);
+        }
+        return;
+    }
+}
+
+static TickType_t proxima_espera(void)
+{
+    int64_t ahora = esp_timer_get_time();
+    int64_t limite = INT64_MAX;
+
+    if (s_en_vuelo != NINGUNO) {
+        limite = s_en_vuelo_us + DOWNLINK_TIMEOUT_CB_MS * 1000;
+    } else {
+        for (int i = 0; i < ESPNOW_DOWNLINK_MAX_PEERS; i++) {
+            const peer_dl_t *p = &s_peers[i];
+            if (p->usado && p->n > 0 && s_pool[p->cabeza].lista_us < limite) {
+                limite = s_pool[p->cabeza].lista_us;
+            }
+        }
+    }
+
+    if (limite == INT64_MAX) return portMAX_DELAY;
+    if (limite <= ahora) return 0;
+    return pdMS_TO_TICKS((limite - ahora + 999) / 1000) + 1;
+}
+
+// ============================================================
+//   TAREA DE DOWNLINK
+// ============================================================
+static void downlink_task(void *arg)
+{
+    while (1) {
+        xSemaphoreTake(s_mutex, portMAX_DELAY);
+        TickType_t espera = proxima_espera();
+        xSemaphoreGive(s_mutex);
+
+        evento_t ev;
+        bool hay_evento = xQueueReceive(s_eventos, &ev, espera) == pdTRUE;
+
+        xSemaphoreTake(s_mutex, portMAX_DELAY);
+        s_n_notif = 0;
+
+        if (hay_evento && ev.tipo == EV_RESULTADO) {
+            if (s_en_vuelo != NINGUNO && ev.generacion == s_en_vuelo_gen &&
+                memcmp(s_peers[s_en_vuelo].mac, ev.mac, ESP_NOW_ETH_ALEN) == 0) {
+                peer_dl_t *p = &s_peers[s_en_vuelo];
+                s_en_vuelo = NINGUNO;
+                completar(p, ev.ok);
+            } else {
+                ESP_LOGD(TAG, "Callback tardío de " MACSTR " (envío %" PRIu32 ") ignorado",
+                         MAC2STR(ev.mac), ev.generacion);
+            }
+        }
+
+        if (s_en_vuelo != NINGUNO &&
+            esp_timer_get_time() - s_en_vuelo_us > DOWNLINK_TIMEOUT_CB_MS * 1000) {
+            peer_dl_t *p = &s_peers[s_en_vuelo];
+            s_en_vuelo = NINGUNO;
+            completar(p, false);
+        }
+
+        despachar();
+
+        notificacion_t notif[MAX_NOTIFICACIONES];
+        int n_notif = s_n_notif;
+        memcpy(notif, s_notif, sizeof(notificacion_t) * n_notif);
+        xSemaphoreGive(s_mutex);
+
+        for (int i = 0; i < n_notif && s_resultado; i++) {
+            s_resultado(notif[i].mac, notif[i].etiqueta, notif[i].ok);
+        }
+    }
+}
+
+// ============================================================
+//   API
+// ============================================================
+void espnow_downlink_send_cb(const uint8_t *mac_addr, esp_now_send_status_t status)
+{
+    evento_t ev = {
+        .tipo = EV_RESULTADO,
+        .ok = status == ESP_NOW_SEND_SUCCESS,
+        .generacion = atomic_fetch_add(&s_callbacks, 1),
+    };
+    memcpy(ev.mac, mac_addr, ESP_NOW_ETH_ALEN);
+    xQueueSend(s_eventos, &ev, 0);
+}
+
+esp_err_t espnow_downlink_enviar(const uint8_t mac[ESP_NOW_ETH_ALEN], const uint8_t *data, size_t len, uint32_t etiqueta)
+{
+    if (len == 0 || len > ESP_NOW_MAX_DATA_LEN) return ESP_ERR_INVALID_SIZE;
+
+    xSemaphoreTake(s_mutex, portMAX_DELAY);
+
+    peer_dl_t *p = buscar_o_crear_peer(mac);
+    if (!p) {
+        xSemaphoreGive(s_mutex);
+        return ESP_ERR_NO_MEM;
+    }
+
+    for (int8_t i = p->cabeza; i != NINGUNO; i = s_pool[i].siguiente) {
+        if (s_pool[i].etiqueta == etiqueta) {
+            xSemaphoreGive(s_mutex);
+            return ESP_OK;
+        }
+    }
+
+    int8_t i = p->n < ESPNOW_DOWNLINK_COLA_POR_PEER ? pool_tomar() : NINGUNO;
+    if (i == NINGUNO) {
+        xSemaphoreGive(s_mutex);
+        return ESP_ERR_NO_MEM;
+    }
+
+    trama_dl_t *t = &s_pool[i];
+    memcpy(t->data, data, len);
+    t->len = (uint16_t)len;
+    t->etiqueta = etiqueta;
+    t->intentos = 0;
+    t->encolada_us = esp_timer_get_time();
+    t->lista_us = t->encolada_us;
+    t->siguiente = NINGUNO;
+
+    if (p->cola == NINGUNO) p->cabeza = i;
+    else s_pool[p->cola].siguiente = i;
+    p->cola = i;
+    p->n++;
+    p->ultimo_us = t->encolada_us;
+
+    xSemaphoreGive(s_mutex);
+
+    evento_t ev = {.tipo = EV_NUEVA};
+    xQueueSend(s_eventos, &ev, 0);
+    return ESP_OK;
+}
+
+void espnow_downlink_get_totales(espnow_downlink_stats_t *stats)
+{
+    xSemaphoreTake(s_mutex, portMAX_DELAY);
+    *stats = s_totales;
+    xSemaphoreGive(s_mutex);
+}
+
+esp_err_t espnow_downlink_init(espnow_downlink_resultado_t resultado)
+{
+    if (s_task) return ESP_OK;
+
+    s_resultado = resultado;
+    espnow_peers_init();
+    for (int i = 0; i < ESPNOW_DOWNLINK_POOL; i++) {
+        pool_devolver((int8_t)i);
+    }
+
+    s_mutex = xSemaphoreCreateMutex();
+    s_eventos = xQueueCreate(DOWNLINK_EVENTOS, sizeof(evento_t));
+    if (!s_mutex || !s_eventos) return ESP_ERR_NO_MEM;
+
+    if (xTaskCreate(downlink_task, "espnow_downlink", DOWNLINK_TASK_STACK, NULL, DOWNLINK_TASK_PRIO, &s_task) != pdPASS) {
+        ESP_LOGE(TAG, "❌ No se pudo crear la tarea de downlink");
+        return ESP_ERR_NO_MEM;
+    }
+
+    ESP_LOGI(TAG, "✅ Downlink ESP-NOW iniciado");
+    return ESP_OK;
+}
@@ -0,0 +1,57 @@
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdbool.h>
+#include "esp_err.h"
+#include "esp_now.h"
+
+#define ESPNOW_DOWNLINK_MAX_PEERS       64      // Peers con cola/estadísticas simultáneas
+#define ESPNOW_DOWNLINK_POOL            16      // Tramas en cola entre todos los peers
+#define ESPNOW_DOWNLINK_COLA_POR_PEER   2
+#define ESPNOW_DOWNLINK_REINTENTOS      5       // Reintentos tras el primer envío
+#define ESPNOW_DOWNLINK_BACKOFF_MS      20      // Primer backoff, se duplica en cada reintento
+// Tope del backoff: el que corresponde al último reintento (20..320 ms)
+#define ESPNOW_DOWNLINK_BACKOFF_MAX_MS  (ESPNOW_DOWNLINK_BACKOFF_MS << (ESPNOW_DOWNLINK_REINTENTOS - 1))
+
+/**
+ * @brief Resultado final de una trama: entregada (ok) o descartada tras agotar reintentos.
+ *        Se invoca desde la tarea de downlink.
+ */
+typedef void (*espnow_downlink_resultado_t)(const uint8_t mac[ESP_NOW_ETH_ALEN], uint32_t etiqueta, bool ok);
+
+typedef struct {
+    uint32_t entregadas;
+    uint32_t fallidas;          // Descartadas tras agotar reintentos
+    uint32_t intentos;          // Llamadas a esp_now_send (incluye reintentos)
+    uint32_t latencia_media_ms; // Desde encolar hasta confirmación, media móvil
+    uint32_t latencia_max_ms;
+} espnow_downlink_stats_t;
+
+/**
+ * @brief Crea la tarea de downlink. Debe llamarse antes de registrar espnow_downlink_send_cb.
+ *
+ * @param resultado Callback opcional con el resultado de cada trama, puede ser NULL.
+ */
+esp_err_t espnow_downlink_init(espnow_downlink_resultado_t resultado);
+
+/**
+ * @brief Encola una trama para el peer. El peer se agrega a ESP-NOW al enviar,
+ *        desalojando al menos reciente si la tabla del driver está llena.
+ *
+ * Si ya hay en cola una trama con la misma etiqueta para ese peer no se duplica.
+ *
+ * @param etiqueta Valor opaco devuelto en el callback de resultado.
+ * @return ESP_OK, ESP_ERR_INVALID_SIZE o ESP_ERR_NO_MEM (cola del peer o pool llenos).
+ */
+esp_err_t espnow_downlink_enviar(const uint8_t mac[ESP_NOW_ETH_ALEN], const uint8_t *data, size_t len, uint32_t etiqueta);
+
+/**
+ * @brief Callback de envío para esp_now_register_send_cb (corre en la tarea Wi-Fi).
+ */
+void espnow_downlink_send_cb(const uint8_t *mac_addr, esp_now_send_status_t status);
+
+/**
+ * @brief Estadísticas acumuladas de todos los peers.
+ */
+void espnow_downlink_get_totales(espnow_downlink_stats_t *stats);
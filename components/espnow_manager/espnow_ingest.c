@@ -0,0 +1,270 @@
+#include "espnow_ingest.h"
+#include <string.h>
+#include <stdatomic.h>
+#include <inttypes.h>
+#include <time.h>
+#include "sdkconfig.h"
+#include "esp_log.h"
+#include "esp_timer.h"
+#include "esp_system.h"
+#include "espnow_ratelimit.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "freertos/semphr.h"
+
+#define INGEST_TASK_STACK     4096
+#define INGEST_TASK_PRIO      6
+#define UNIDAD                32      // Granularidad de los registros en el ring
+#define UNIDADES              (ESPNOW_INGEST_BYTES / UNIDAD)
+#define CABECERA              8       // Prefijo con el largo del registro, mantiene alineado rx_us
+#define SALTO                 0       // Marca de fin de arena: el siguiente registro está al inicio
+#define HISTO_INTERVALOS      24      // Intervalo i: latencias de hasta 2^i us (el último acumula el resto)
+
+_Static_assert((UNIDADES & (UNIDADES - 1)) == 0, "ESPNOW_INGEST_BYTES debe ser potencia de 2");
+_Static_assert(CABECERA + sizeof(espnow_trama_t) <= UNIDAD, "La cabecera debe caber en una unidad");
+
+static const char *TAG = "ESPNOW_INGEST";
+
+// Ring SPSC de registros de largo variable: el productor (tarea Wi-Fi) solo
+// escribe s_head, el consumidor (tarea de ingesta) solo escribe s_tail. Ambos
+// cuentan unidades, crecen libremente y se enmascaran al indexar. Como todo
+// registro ocupa unidades enteras, siempre queda lugar para la marca de salto.
+static uint8_t s_arena[ESPNOW_INGEST_BYTES] __attribute__((aligned(8)));
+static atomic_uint s_head;
+static atomic_uint s_tail;
+
+// Estadísticas del productor
+static uint32_t s_recibidas;
+static uint32_t s_descartes;
+static uint32_t s_max_ocupacion;
+// Estadísticas del consumidor
+static uint32_t s_procesadas;
+
+// Métricas de la ventana actual, las escribe la tarea de ingesta
+static uint32_t s_histo[HISTO_INTERVALOS];
+static uint32_t s_latencia_max_us;
+static int64_t s_ventana_inicio_us;
+static uint32_t s_ventana_descartes;
+static uint32_t s_ventana_limitadas;
+static SemaphoreHandle_t s_metricas_mutex;
+
+static TaskHandle_t s_task;
+static espnow_ingest_handler_t s_handler;
+static espnow_ingest_fin_lote_t s_fin_lote;
+
+static inline uint32_t *prefijo(unsigned pos)
+{
+    return (uint32_t *)&s_arena[(pos % UNIDADES) * UNIDAD];
+}
+
+static inline espnow_trama_t *trama_en(unsigned pos)
+{
+    return (espnow_trama_t *)&s_arena[(pos % UNIDADES) * UNIDAD + CABECERA];
+}
+
+void espnow_ingest_push(const esp_now_recv_info_t *recv_info, const uint8_t *data, int len)
+{
+    s_recibidas++;
+
+    if (len <= 0 || len > ESPNOW_INGEST_MAX_LEN) {
+        s_descartes++;
+        return;
+    }
+
+    // Una esfera que inunda el canal se corta acá, antes de ocupar el ring
+    if (!espnow_ratelimit_admitir(recv_info->src_addr)) {
+        return;
+    }
+
+    unsigned unidades = (CABECERA + offsetof(espnow_trama_t, data) + len + UNIDAD - 1) / UNIDAD;
+    unsigned head = atomic_load_explicit(&s_head, memory_order_relaxed);
+    unsigned tail = atomic_load_explicit(&s_tail, memory_order_acquire);
+    unsigned libres = UNIDADES - (head - tail);
+    unsigned contiguas = UNIDADES - (head % UNIDADES);
+
+    // El registro no se parte: si no entra antes del fin de la arena se salta al inicio
+    unsigned salto = unidades > contiguas ? contiguas : 0;
+    if (libres < salto + unidades) {
+        s_descartes++;
+        return;
+    }
+    if (salto) {
+        *prefijo(head) = SALTO;
+        head += salto;
+    }
+
+    *prefijo(head) = unidades;
+    espnow_trama_t *t = trama_en(head);
+    memcpy(t->mac, recv_info->src_addr, ESP_NOW_ETH_ALEN);
+    t->rssi = recv_info->rx_ctrl ? recv_info->rx_ctrl->rssi : 0;
+    t->len = (uint16_t)len;
+    t->rx_us = esp_timer_get_time();
+    t->epoch = (uint32_t)time(NULL);
+    memcpy(t->data, data, len);
+
+    head += unidades;
+    atomic_store_explicit(&s_head, head, memory_order_release);
+
+    uint32_t ocupacion = (head - tail) * UNIDAD;
+    if (ocupacion > s_max_ocupacion) {
+        s_max_ocupacion = ocupacion;
+    }
+
+    if (s_task) {
+        xTaskNotifyGive(s_task);
+    }
+}
+
+static void registrar_latencia(int64_t latencia_us)
+{
+    uint32_t us = latencia_us > 0 ? (uint32_t)latencia_us : 0;
+    int i = us ? 32 - __builtin_clz(us) : 0;
+    if (i >= HISTO_INTERVALOS) i = HISTO_INTERVALOS - 1;
+
+    xSemaphoreTake(s_metricas_mutex, portMAX_DELAY);
+    s_histo[i]++;
+    if (us > s_latencia_max_us) s_latencia_max_us = us;
+    xSemaphoreGive(s_metricas_mutex);
+}
+
+static uint32_t percentil(const uint32_t *histo, uint32_t total, uint32_t por_mil)
+{
+    if (total == 0) return 0;
+    uint32_t objetivo = (uint32_t)(((uint64_t)total * por_mil + 999) / 1000);
+    uint32_t acumulado = 0;
+    for (int i = 0; i < HISTO_INTERVALOS; i++) {
+        acumulado += histo[i];
+        if (acumulado >= objetivo) return 1u << i;
+    }
+    return 1u << (HISTO_INTERVALOS - 1);
+}
+
+static void reportar_metricas(void)
+{
+    espnow_ingest_metricas_t m;
+    espnow_ingest_get_metricas(&m);
+    ESP_LOGI(TAG, "📊 %" PRIu32 " tramas en %" PRIu32 " s (%" PRIu32 ".%02" PRIu32 "/s), "
+             "latencia p50<=%" PRIu32 " us p99<=%" PRIu32 " us max %" PRIu32 " us, "
+             "descartes %" PRIu32 ", limitadas %" PRIu32 ", heap %" PRIu32 " (min %" PRIu32 ")",
+             m.tramas, m.ventana_ms / 1000, m.tramas_por_seg_x100 / 100, m.tramas_por_seg_x100 % 100,
+             m.latencia_p50_us, m.latencia_p99_us, m.latencia_max_us,
+             m.descartes, m.limitadas, m.heap_libre, m.heap_minimo);
+}
+
+static void ingest_task(void *arg)
+{
+    uint32_t descartes_reportados = 0;
+    int64_t proximo_reporte_us = esp_timer_get_time() + ESPNOW_INGEST_REPORTE_MS * 1000LL;
+
+    while (1) {
+        ulTaskNotifyTake(pdTRUE, pdMS_TO_TICKS(ESPNOW_INGEST_REPORTE_MS));
+
+        if (esp_timer_get_time() >= proximo_reporte_us) {
+            reportar_metricas();
+            proximo_reporte_us = esp_timer_get_time() + ESPNOW_INGEST_REPORTE_MS * 1000LL;
+        }
+
+        unsigned tail = atomic_load_explicit(&s_tail, memory_order_relaxed);
+        while (1) {
+            unsigned head = atomic_load_explicit(&s_head, memory_order_acquire);
+            if (head == tail) break;
+
+            // Procesa como máximo un lote antes de liberar el espacio al productor
+            unsigned n = 0;
+            while (tail != head && n < ESPNOW_INGEST_LOTE) {
+                uint32_t unidades = *prefijo(tail);
+                if (unidades == SALTO) {
+                    tail += UNIDADES - (tail % UNIDADES);
+                    continue;
+                }
+                espnow_trama_t *t = trama_en(tail);
+                s_handler(t);
+                registrar_latencia(esp_timer_get_time() - t->rx_us);
+                tail += unidades;
+                n++;
+            }
+            atomic_store_explicit(&s_tail, tail, memory_order_release);
+            s_procesadas += n;
+
+            if (n && s_fin_lote) s_fin_lote();
+        }
+
+        uint32_t descartes = s_descartes;
+        if (descartes != descartes_reportados) {
+            ESP_LOGW(TAG, "⚠️ Ring lleno: %" PRIu32 " tramas descartadas (max ocupación %" PRIu32 "/%d bytes)",
+                     descartes - descartes_reportados, s_max_ocupacion, ESPNOW_INGEST_BYTES);
+            descartes_reportados = descartes;
+        }
+        espnow_ratelimit_reportar();
+    }
+}
+
+esp_err_t espnow_ingest_init(espnow_ingest_handler_t handler, espnow_ingest_fin_lote_t fin_lote)
+{
+    if (s_task) return ESP_OK;
+    if (!handler) return ESP_ERR_INVALID_ARG;
+
+    s_metricas_mutex = xSemaphoreCreateMutex();
+    if (!s_metricas_mutex) return ESP_ERR_NO_MEM;
+
+    // Antes de que el callback empiece a admitir tramas
+    espnow_ratelimit_configurar(CONFIG_ESPNOW_RATELIMIT_TASA_MIN, CONFIG_ESPNOW_RATELIMIT_RAFAGA);
+
+    s_handler = handler;
+    s_fin_lote = fin_lote;
+    s_ventana_inicio_us = esp_timer_get_time();
+    atomic_store(&s_head, 0);
+    atomic_store(&s_tail, 0);
+
+    if (xTaskCreate(ingest_task, "espnow_ingest", INGEST_TASK_STACK, NULL, INGEST_TASK_PRIO, &s_task) != pdPASS) {
+        ESP_LOGE(TAG, "❌ No se pudo crear la tarea de ingesta");
+        return ESP_ERR_NO_MEM;
+    }
+
+    ESP_LOGI(TAG, "✅ Ingesta ESP-NOW iniciada (%d bytes, tramas de hasta %d)", ESPNOW_INGEST_BYTES, ESPNOW_INGEST_MAX_LEN);
+    return ESP_OK;
+}
+
+void espnow_ingest_get_stats(espnow_ingest_stats_t *stats)
+{
+    unsigned head = atomic_load(&s_head);
+    unsigned tail = atomic_load(&s_tail);
+    stats->ocupacion = (head - tail) * UNIDAD;
+    stats->max_ocupacion = s_max_ocupacion;
+    stats->descartes = s_descartes;
+    stats->recibidas = s_recibidas;
+    stats->procesadas = s_procesadas;
+}
+
+void espnow_ingest_get_metricas(espnow_ingest_metricas_t *metricas)
+{
+    uint32_t histo[HISTO_INTERVALOS];
+    espnow_ratelimit_stats_t rl;
+    espnow_ratelimit_get_stats(&rl);
+    int64_t ahora = esp_timer_get_time();
+
+    xSemaphoreTake(s_metricas_mutex, portMAX_DELAY);
+    memcpy(histo, s_histo, sizeof(histo));
+    memset(s_histo, 0, sizeof(s_histo));
+    metricas->latencia_max_us = s_latencia_max_us;
+    s_latencia_max_us = 0;
+    int64_t ventana_us = ahora - s_ventana_inicio_us;
+    s_ventana_inicio_us = ahora;
+    uint32_t descartes = s_descartes;
+    metricas->descartes = descartes - s_ventana_descartes;
+    s_ventana_descartes = descartes;
+    metricas->limitadas = rl.limitadas - s_ventana_limitadas;
+    s_ventana_limitadas = rl.limitadas;
+    xSemaphoreGive(s_metricas_mutex);
+
+    uint32_t tramas = 0;
+    for (int i = 0; i < HISTO_INTERVALOS; i++) tramas += histo[i];
+
+    metricas->ventana_ms = (uint32_t)(ventana_us / 1000);
+    metricas->tramas = tramas;
+    metricas->tramas_por_seg_x100 = ventana_us > 0 ? (uint32_t)((uint64_t)tramas * 100000000ULL / ventana_us) : 0;
+    metricas->latencia_p50_us = percentil(histo, tramas, 500);
+    metricas->latencia_p99_us = percentil(histo, tramas, 990);
+    metricas->heap_libre = esp_get_free_heap_size();
+    metricas->heap_minimo = esp_get_minimum_free_heap_size();
+}
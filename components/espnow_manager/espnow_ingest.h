@@ -0,0 +1,94 @@
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+#include "esp_err.h"
+#include "esp_now.h"
+
+#define ESPNOW_INGEST_BYTES       8192  // Memoria del ring, potencia de 2
+#define ESPNOW_INGEST_LOTE        8     // Tramas procesadas por lote antes de notificar fin de lote
+#define ESPNOW_INGEST_REPORTE_MS  60000 // Período del resumen de métricas en el log
+
+// ESP-NOW v2 (IDF 5.4) admite payloads de hasta 1470 bytes
+#ifdef ESP_NOW_MAX_DATA_LEN_V2
+#define ESPNOW_INGEST_MAX_LEN     ESP_NOW_MAX_DATA_LEN_V2
+#else
+#define ESPNOW_INGEST_MAX_LEN     ESP_NOW_MAX_DATA_LEN
+#endif
+
+/**
+ * @brief Trama ESP-NOW copiada tal cual desde el callback de recepción.
+ *
+ * Los registros del ring tienen largo variable: data ocupa solo len bytes.
+ */
+typedef struct {
+    int64_t rx_us;                  // esp_timer_get_time() al recibir
+    uint32_t epoch;                 // time(NULL) al recibir
+    uint16_t len;
+    uint8_t mac[ESP_NOW_ETH_ALEN];  // MAC origen (binaria)
+    int8_t rssi;
+    uint8_t data[];
+} espnow_trama_t;
+
+/**
+ * @brief Se invoca desde la tarea de ingesta para cada trama recibida.
+ */
+typedef void (*espnow_ingest_handler_t)(const espnow_trama_t *trama);
+
+/**
+ * @brief Se invoca al terminar cada lote (p.ej. para agrupar escrituras en NVS). Opcional.
+ */
+typedef void (*espnow_ingest_fin_lote_t)(void);
+
+typedef struct {
+    uint32_t ocupacion;       // Bytes pendientes en el ring
+    uint32_t max_ocupacion;   // High-water mark en bytes desde el arranque
+    uint32_t descartes;       // Tramas perdidas por ring lleno
+    uint32_t recibidas;
+    uint32_t procesadas;
+} espnow_ingest_stats_t;
+
+/**
+ * @brief Crea la tarea de ingesta. Debe llamarse antes de registrar espnow_recv_cb.
+ *
+ * @param handler Procesado de cada trama (fuera de la tarea Wi-Fi).
+ * @param fin_lote Callback opcional al final de cada lote, puede ser NULL.
+ */
+esp_err_t espnow_ingest_init(espnow_ingest_handler_t handler, espnow_ingest_fin_lote_t fin_lote);
+
+/**
+ * @brief Copia la trama al ring. Pensada para llamarse desde el callback ESP-NOW
+ *        (tarea Wi-Fi): no bloquea, no reserva memoria y no hace logs.
+ *
+ * Las tramas de emisores que superan el límite de espnow_ratelimit se
+ * descartan antes de copiarse y no cuentan como descartes del ring.
+ */
+void espnow_ingest_push(const esp_now_recv_info_t *recv_info, const uint8_t *data, int len);
+
+void espnow_ingest_get_stats(espnow_ingest_stats_t *stats);
+
+/**
+ * @brief Métricas de rendimiento de una ventana de medición.
+ *
+ * La latencia va desde el callback de recepción hasta que el handler termina
+ * con la trama (espera en el ring + parseo + buffer). Los percentiles salen de
+ * un histograma logarítmico y se informan como cota superior del intervalo.
+ */
+typedef struct {
+    uint32_t ventana_ms;
+    uint32_t tramas;            // Procesadas en la ventana
+    uint32_t tramas_por_seg_x100;
+    uint32_t latencia_p50_us;
+    uint32_t latencia_p99_us;
+    uint32_t latencia_max_us;
+    uint32_t descartes;         // Ring lleno, en la ventana
+    uint32_t limitadas;         // Cortadas por espnow_ratelimit, en la ventana
+    uint32_t heap_libre;
+    uint32_t heap_minimo;       // Mínimo histórico de heap libre
+} espnow_ingest_metricas_t;
+
+/**
+ * @brief Devuelve las métricas acumuladas desde la llamada anterior y abre una ventana nueva.
+ *        La tarea de ingesta las registra en el log cada ESPNOW_INGEST_REPORTE_MS.
+ */
+void espnow_ingest_get_metricas(espnow_ingest_metricas_t *metricas);
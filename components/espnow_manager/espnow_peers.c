@@ -0,0 +1,123 @@
+#include "espnow_peers.h"
+#include <string.h>
+#include <stdbool.h>
+#include "esp_log.h"
+#include "esp_mac.h"
+#include "esp_timer.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/semphr.h"
+
+static const char *TAG = "ESPNOW_PEERS";
+
+typedef struct {
+    uint8_t mac[ESP_NOW_ETH_ALEN];
+    bool usado;
+    int64_t ultimo_us;
+} peer_lru_t;
+
+// Con ~20 entradas una búsqueda lineal es más barata que cualquier estructura auxiliar
+static peer_lru_t s_peers[ESPNOW_PEERS_MAX];
+static espnow_peers_stats_t s_stats;
+static SemaphoreHandle_t s_mutex;
+
+static peer_lru_t *buscar(const uint8_t *mac)
+{
+    for (int i = 0; i < ESPNOW_PEERS_MAX; i++) {
+        if (s_peers[i].usado && memcmp(s_peers[i].mac, mac, ESP_NOW_ETH_ALEN) == 0) {
+            return &s_peers[i];
+        }
+    }
+    return NULL;
+}
+
+static peer_lru_t *slot_libre(void)
+{
+    for (int i = 0; i < ESPNOW_PEERS_MAX; i++) {
+        if (!s_peers[i].usado) return &s_peers[i];
+    }
+    return NULL;
+}
+
+static bool desalojar_lru(void)
+{
+    peer_lru_t *lru = NULL;
+    for (int i = 0; i < ESPNOW_PEERS_MAX; i++) {
+        if (s_peers[i].usado && (!lru || s_peers[i].ultimo_us < lru->ultimo_us)) lru = &s_peers[i];
+    }
+    if (!lru) return false;
+
+    esp_err_t err = esp_now_del_peer(lru->mac);
+    if (err != ESP_OK && err != ESP_ERR_ESPNOW_NOT_FOUND) {
+        ESP_LOGW(TAG, "⚠️ No se pudo quitar " MACSTR ": %s", MAC2STR(lru->mac), esp_err_to_name(err));
+    }
+    ESP_LOGD(TAG, "Desalojado " MACSTR, MAC2STR(lru->mac));
+    lru->usado = false;
+    s_stats.desalojos++;
+    s_stats.activos--;
+    return true;
+}
+
+void espnow_peers_init(void)
+{
+    if (!s_mutex) s_mutex = xSemaphoreCreateMutex();
+}
+
+esp_err_t espnow_peers_asegurar(const uint8_t mac[ESP_NOW_ETH_ALEN])
+{
+    esp_err_t err = ESP_OK;
+    xSemaphoreTake(s_mutex, portMAX_DELAY);
+
+    peer_lru_t *p = buscar(mac);
+    if (p) {
+        p->ultimo_us = esp_timer_get_time();
+        xSemaphoreGive(s_mutex);
+        return ESP_OK;
+    }
+
+    p = slot_libre();
+    if (!p) {
+        desalojar_lru();
+        p = slot_libre();
+    }
+
+    esp_now_peer_info_t peer = {
+        .ifidx = WIFI_IF_STA,
+        .encrypt = false};
+    memcpy(peer.peer_addr, mac, ESP_NOW_ETH_ALEN);
+
+    err = esp_now_add_peer(&peer);
+    if (err == ESP_ERR_ESPNOW_FULL && desalojar_lru()) {
+        // La tabla del driver tiene peers que no son nuestros; se libera uno más
+        err = esp_now_add_peer(&peer);
+    }
+    if (err == ESP_ERR_ESPNOW_EXIST) err = ESP_OK;
+
+    if (err == ESP_OK) {
+        memcpy(p->mac, mac, ESP_NOW_ETH_ALEN);
+        p->usado = true;
+        p->ultimo_us = esp_timer_get_time();
+        s_stats.altas++;
+        s_stats.activos++;
+    } else {
+        s_stats.fallos++;
+        ESP_LOGE(TAG, "❌ No se pudo agregar " MACSTR ": %s", MAC2STR(mac), esp_err_to_name(err));
+    }
+
+    xSemaphoreGive(s_mutex);
+    return err;
+}
+
+void espnow_peers_tocar(const uint8_t mac[ESP_NOW_ETH_ALEN])
+{
+    xSemaphoreTake(s_mutex, portMAX_DELAY);
+    peer_lru_t *p = buscar(mac);
+    if (p) p->ultimo_us = esp_timer_get_time();
+    xSemaphoreGive(s_mutex);
+}
+
+void espnow_peers_get_stats(espnow_peers_stats_t *stats)
+{
+    xSemaphoreTake(s_mutex, portMAX_DELAY);
+    *stats = s_stats;
+    xSemaphoreGive(s_mutex);
+}
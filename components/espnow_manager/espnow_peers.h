@@ -0,0 +1,30 @@
+#pragma once
+
+#include <stdint.h>
+#include "esp_err.h"
+#include "esp_now.h"
+
+// Un lugar de la tabla del driver queda reservado para el peer broadcast
+#define ESPNOW_PEERS_MAX    (ESP_NOW_MAX_TOTAL_PEER_NUM - 1)
+
+typedef struct {
+    uint32_t activos;       // Peers propios en la tabla del driver
+    uint32_t altas;         // esp_now_add_peer realizados
+    uint32_t desalojos;     // Peers quitados por LRU para hacer lugar
+    uint32_t fallos;        // Altas que fallaron aun tras desalojar
+} espnow_peers_stats_t;
+
+void espnow_peers_init(void);
+
+/**
+ * @brief Garantiza que la MAC esté en la tabla de peers del driver. Si no hay
+ *        lugar desaloja al peer usado menos recientemente.
+ */
+esp_err_t espnow_peers_asegurar(const uint8_t mac[ESP_NOW_ETH_ALEN]);
+
+/**
+ * @brief Marca actividad de la esfera (p.ej. al recibir una trama) sin tocar el driver.
+ */
+void espnow_peers_tocar(const uint8_t mac[ESP_NOW_ETH_ALEN]);
+
+void espnow_peers_get_stats(espnow_peers_stats_t *stats);
@@ -0,0 +1,132 @@
+#include "espnow_ratelimit.h"
+#include <string.h>
+#include <inttypes.h>
+#include "sdkconfig.h"
+#include "esp_log.h"
+#include "esp_mac.h"
+#include "esp_timer.h"
+#include "freertos/FreeRTOS.h"
+
+#define US_POR_MIN  60000000LL
+#define SONDEO      8           // Posiciones revisadas desde el hash: acota el callback con la tabla llena
+
+static const char *TAG = "ESPNOW_RATELIMIT";
+
+// Cada balde guarda crédito en microsegundos: crece con el tiempo, una trama
+// cuesta s_costo_us y el tope es rafaga * s_costo_us. Evita divisiones en el callback.
+typedef struct {
+    uint8_t mac[ESP_NOW_ETH_ALEN];
+    bool usado;
+    int64_t credito_us;
+    int64_t ultimo_us;
+    uint32_t limitadas;
+    uint32_t reportadas;    // Solo la escribe espnow_ratelimit_reportar
+} emisor_t;
+
+// La tabla la modifica la tarea Wi-Fi y la lee el reporte: ambos acceden bajo
+// s_lock, con secciones de pocas instrucciones para no demorar la recepción.
+static portMUX_TYPE s_lock = portMUX_INITIALIZER_UNLOCKED;
+static emisor_t s_emisores[ESPNOW_RATELIMIT_EMISORES];
+static int64_t s_costo_us = US_POR_MIN / CONFIG_ESPNOW_RATELIMIT_TASA_MIN;
+static int64_t s_tope_us = (US_POR_MIN / CONFIG_ESPNOW_RATELIMIT_TASA_MIN) * CONFIG_ESPNOW_RATELIMIT_RAFAGA;
+static espnow_ratelimit_stats_t s_stats;
+
+static unsigned hash_mac(const uint8_t *mac)
+{
+    // Los últimos bytes son los que varían entre esferas del mismo fabricante
+    return (unsigned)(mac[3] * 31u + mac[4]) * 31u + mac[5];
+}
+
+// Con s_lock tomado. Las entradas nunca se liberan, así que un emisor está
+// siempre dentro de las SONDEO posiciones de su hash y una libre corta la búsqueda.
+static emisor_t *buscar_o_crear(const uint8_t *mac, int64_t ahora)
+{
+    unsigned pos = hash_mac(mac) % ESPNOW_RATELIMIT_EMISORES;
+    emisor_t *viejo = NULL;
+
+    for (int i = 0; i < SONDEO; i++) {
+        emisor_t *e = &s_emisores[(pos + i) % ESPNOW_RATELIMIT_EMISORES];
+        if (!e->usado) {
+            s_stats.emisores++;
+            viejo = e;
+            break;
+        }
+        if (memcmp(e->mac, mac, ESP_NOW_ETH_ALEN) == 0) return e;
+        if (!viejo || e->ultimo_us < viejo->ultimo_us) viejo = e;
+    }
+
+    // Vecindario lleno: se recicla el emisor más antiguo, que parte con el balde lleno
+    if (viejo->usado) s_stats.reciclados++;
+    memcpy(viejo->mac, mac, ESP_NOW_ETH_ALEN);
+    viejo->usado = true;
+    viejo->credito_us = s_tope_us;
+    viejo->ultimo_us = ahora;
+    viejo->limitadas = 0;
+    viejo->reportadas = 0;
+    return viejo;
+}
+
+bool espnow_ratelimit_admitir(const uint8_t mac[ESP_NOW_ETH_ALEN])
+{
+    int64_t ahora = esp_timer_get_time();
+    bool admitida = false;
+
+    taskENTER_CRITICAL(&s_lock);
+    emisor_t *e = buscar_o_crear(mac, ahora);
+
+    e->credito_us += ahora - e->ultimo_us;
+    if (e->credito_us > s_tope_us) e->credito_us = s_tope_us;
+    e->ultimo_us = ahora;
+
+    if (e->credito_us < s_costo_us) {
+        e->limitadas++;
+        s_stats.limitadas++;
+    } else {
+        e->credito_us -= s_costo_us;
+        s_stats.admitidas++;
+        admitida = true;
+    }
+    taskEXIT_CRITICAL(&s_lock);
+    return admitida;
+}
+
+void espnow_ratelimit_configurar(uint32_t tasa_por_min, uint32_t rafaga)
+{
+    if (tasa_por_min == 0 || rafaga == 0) return;
+
+    taskENTER_CRITICAL(&s_lock);
+    s_costo_us = US_POR_MIN / tasa_por_min;
+    s_tope_us = s_costo_us * rafaga;
+    for (int i = 0; i < ESPNOW_RATELIMIT_EMISORES; i++) {
+        s_emisores[i].credito_us = s_tope_us;
+    }
+    taskEXIT_CRITICAL(&s_lock);
+    ESP_LOGI(TAG, "⚙️ Límite por esfera: %" PRIu32 " tramas/min, ráfaga %" PRIu32, tasa_por_min, rafaga);
+}
+
+void espnow_ratelimit_reportar(void)
+{
+    for (int i = 0; i < ESPNOW_RATELIMIT_EMISORES; i++) {
+        // MAC y contadores se copian juntos: la entrada puede reciclarse en cualquier momento
+        uint8_t mac[ESP_NOW_ETH_ALEN];
+        uint32_t nuevas = 0;
+        taskENTER_CRITICAL(&s_lock);
+        emisor_t *e = &s_emisores[i];
+        if (e->usado && e->limitadas != e->reportadas) {
+            memcpy(mac, e->mac, ESP_NOW_ETH_ALEN);
+            nuevas = e->limitadas - e->reportadas;
+            e->reportadas = e->limitadas;
+        }
+        taskEXIT_CRITICAL(&s_lock);
+        if (nuevas == 0) continue;
+
+        ESP_LOGW(TAG, "🚫 " MACSTR " supera el límite: %" PRIu32 " tramas descartadas", MAC2STR(mac), nuevas);
+    }
+}
+
+void espnow_ratelimit_get_stats(espnow_ratelimit_stats_t *stats)
+{
+    taskENTER_CRITICAL(&s_lock);
+    *stats = s_stats;
+    taskEXIT_CRITICAL(&s_lock);
+}
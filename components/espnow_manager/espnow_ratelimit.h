@@ -0,0 +1,38 @@
+#pragma once
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "esp_now.h"
+
+#define ESPNOW_RATELIMIT_EMISORES       64      // Emisores seguidos a la vez, se reciclan por antigüedad entre vecinos de hash
+
+typedef struct {
+    uint32_t admitidas;
+    uint32_t limitadas;     // Tramas descartadas por superar la tasa
+    uint32_t emisores;      // Emisores en la tabla
+    uint32_t reciclados;    // Entradas reutilizadas por vecindario de hash lleno
+} espnow_ratelimit_stats_t;
+
+/**
+ * @brief Cambia la tasa y la ráfaga de todos los emisores. Los baldes se llenan de nuevo.
+ *        Debe llamarse antes de registrar el callback de recepción; espnow_ingest_init
+ *        aplica CONFIG_ESPNOW_RATELIMIT_TASA_MIN y CONFIG_ESPNOW_RATELIMIT_RAFAGA.
+ */
+void espnow_ratelimit_configurar(uint32_t tasa_por_min, uint32_t rafaga);
+
+/**
+ * @brief Balde de tokens por MAC. Pensada para el callback de recepción
+ *        (tarea Wi-Fi): no reserva memoria, no hace logs y revisa a lo sumo unas
+ *        pocas entradas de la tabla dentro de una sección crítica corta.
+ *
+ * @return true si la trama se admite.
+ */
+bool espnow_ratelimit_admitir(const uint8_t mac[ESP_NOW_ETH_ALEN]);
+
+/**
+ * @brief Registra en el log los emisores limitados desde el último reporte.
+ *        Se llama desde una tarea normal, no desde el callback.
+ */
+void espnow_ratelimit_reportar(void);
+
+void espnow_ratelimit_get_stats(espnow_ratelimit_stats_t *stats);
@@ -1,166 +1,453 @@
 #include "mqtt_manager.h"
+#include "sdkconfig.h"
 #include "esp_log.h"
 #include <string.h>
+#include <stdatomic.h>
+#include <inttypes.h>
 #include "mqtt_secrets.h"
 #include "hub_station.h"
-#include "nvs_flash.h"
-#include "nvs.h"
 #include "cJSON.h"
 #include "esp_mac.h"
 #include "esfera_manager.h"
+#include "esfera_config.h"
+#include "esfera_seq.h"
+#include "esfera_log.h"
+#include "esfera_stats.h"
+#include "esfera_consulta.h"
+#include "mqtt_telemetria.h"
+#include "mqtt_reensamblado.h"
+#include "esp_timer.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "freertos/queue.h"
+#include "espnow_ingest.h"
+#include "espnow_downlink.h"
+#include "espnow_peers.h"
 
 #define TAG "MQTT_MANAGER"
 
+#define COMANDOS_TASK_STACK 6144
+#define COMANDOS_TASK_PRIO  4                       // Debajo de esp-mqtt (5) y de la ingesta (6)
+#define COMANDOS_COLA       (MQTT_MENSAJES_POOL + 3) // Todo el pool más avisos de conexión y telemetría
+#define REPORTE_MS          60000                   // Período del resumen de estadísticas en el log
+
+typedef enum {
+    COMANDO_MENSAJE,        // Mensaje entrante completo
+    COMANDO_CONECTADO,      // Conexión al broker: suscribirse e iniciar ESP-NOW
+    COMANDO_TELEMETRIA,     // Lote de telemetría listo o vencido: publicarlo
+} comando_tipo_t;
+
+typedef struct {
+    comando_tipo_t tipo;
+    esp_mqtt_client_handle_t cliente;
+    mqtt_mensaje_t *mensaje;
+} comando_t;
+
 static char topic_public[30] = {0};
 static char topic_suscripcion[64] = {0};
 extern char mac_local[13]; // Formato XX:XX:XX:XX:XX:XX
 
 static esp_mqtt_client_handle_t client = NULL;
+static QueueHandle_t s_comandos;
+static atomic_bool s_telemetria_avisada;    // Evita llenar la cola con avisos repetidos
 
 // --- Certificados (definidos en mqtt_secrets.h) ---
 extern const uint8_t ca_cert_pem_start[] asm("_binary_ca_cert_pem_start");
 extern const uint8_t client_cert_pem_start[] asm("_binary_client_cert_pem_start");
 extern const uint8_t client_key_pem_start[] asm("_binary_client_key_pem_start");
 
-// --- Configuración estándar ---
-static const char *default_config_json =
-    "{\"MACHUB\":\"%s\",\"MACSLAVE\":\"%s\","
-    "\"colorLED\":16777215,"
-    "\"riegoAuto\":0,"
-    "\"diasRiego\":0,"
-    "\"horaRiego\":\"08:00\","
-    "\"ml\":100}";
-
 // --- Prototipos privados ---
 static esp_err_t mqtt_event_handler_cb(esp_mqtt_event_handle_t event);
 static void mqtt_event_handler(void *handler_args, esp_event_base_t base, int32_t event_id, void *event_data);
-static void procesar_configuracion_esfera(const char *payload);
-static void intentar_enviar_configuracion_a_esfera(const char *mac_str, const uint8_t *mac_bin);
+static void procesar_consulta(esp_mqtt_client_handle_t cliente, const cJSON *pedido);
+static void procesar_mensaje(esp_mqtt_client_handle_t cliente, mqtt_mensaje_t *mensaje);
+static void comandos_task(void *arg);
+static void encolar_comando(comando_tipo_t tipo, esp_mqtt_client_handle_t cliente, mqtt_mensaje_t *mensaje);
+static void avisar_telemetria(void);
+static void intentar_enviar_configuracion_a_esfera(uint16_t indice, const esfera_lectura_t *lectura,
+                                                   const char *mac_str, const uint8_t *mac_bin);
+static void procesar_trama_esfera(const espnow_trama_t *trama);
+static void fin_lote_esferas(void);
+static void resultado_downlink(const uint8_t mac[ESP_NOW_ETH_ALEN], uint32_t version, bool ok);
 
 // ============================================================
 //   ENVÍO DE CONFIGURACIÓN A UNA ESFERA
 // ============================================================
-static void intentar_enviar_configuracion_a_esfera(const char *mac_str, const uint8_t *mac_bin)
+static void intentar_enviar_configuracion_a_esfera(uint16_t indice, const esfera_lectura_t *lectura,
+                                                   const char *mac_str, const uint8_t *mac_bin)
 {
-    char mac_clean[13];
-    int j = 0;
-    for (int i = 0; mac_str[i] && j < 12; i++) {
-        if (mac_str[i] != ':') mac_clean[j++] = mac_str[i];
+    uint8_t payload[ESFERA_CONFIG_MAX_LEN];
+    size_t len = sizeof(payload);
+    uint32_t version;
+    if (!esfera_config_pendiente(indice, lectura, payload, &len, &version)) {
+        ESP_LOGD(TAG, "ℹ️ %s ya tiene la configuración vigente", mac_str);
+        return;
     }
-    mac_clean[j] = '\0';
 
-    ESP_LOGI(TAG, "🔎 Buscando configuración para %s", mac_clean);
+    // La versión viaja como etiqueta y se marca como enviada al confirmarse la entrega
+    esp_err_t err = espnow_downlink_enviar(mac_bin, payload, len, version);
+    if (err == ESP_OK) {
+        ESP_LOGI(TAG, "📤 Configuración encolada para %s", mac_str);
+        ESP_LOGD(TAG, "%.*s", (int)len, (const char *)payload);
+    } else {
+        ESP_LOGE(TAG, "❌ No se pudo encolar la configuración para %s: %s", mac_str, esp_err_to_name(err));
+    }
+}
 
-    nvs_handle_t nvs_handle;
-    esp_err_t err = nvs_open("config_store", NVS_READONLY, &nvs_handle);
-    if (err != ESP_OK) {
-        ESP_LOGW(TAG, "⚠️ No se pudo abrir NVS, usando configuración estándar");
-        char buffer[256];
-        snprintf(buffer, sizeof(buffer), default_config_json, mac_local, mac_str);
-        esp_now_send(mac_bin, (uint8_t *)buffer, strlen(buffer));
-        ESP_LOGI(TAG, "✅ Configuración estándar enviada a %s", mac_str);
+static void resultado_downlink(const uint8_t mac[ESP_NOW_ETH_ALEN], uint32_t version, bool ok)
+{
+    if (!ok) {
+        ESP_LOGE(TAG, "❌ Fallo al enviar configuración a " MACSTR, MAC2STR(mac));
         return;
     }
 
-    size_t required_size = 0;
-    err = nvs_get_str(nvs_handle, mac_clean, NULL, &required_size);
-    if (err == ESP_ERR_NVS_NOT_FOUND) {
-        ESP_LOGI(TAG, "ℹ️ No hay configuración en NVS, usando estándar para %s", mac_clean);
-        char buffer[256];
-        snprintf(buffer, sizeof(buffer), default_config_json, mac_local, mac_str);
-        esp_now_send(mac_bin, (uint8_t *)buffer, strlen(buffer));
-        ESP_LOGI(TAG, "✅ Configuración estándar enviada a %s", mac_str);
-        nvs_close(nvs_handle);
-        return;
+    uint16_t indice = esfera_registry_find(mac);
+    if (indice != ESFERA_REGISTRY_NINGUNA) {
+        esfera_config_marcar_enviada(indice, version);
     }
+    ESP_LOGI(TAG, "✅ Configuración entregada a " MACSTR, MAC2STR(mac));
+}
 
-    char *config_json = malloc(required_size);
-    if (!config_json) {
-        ESP_LOGE(TAG, "❌ Error asignando memoria para JSON");
-        nvs_close(nvs_handle);
-        return;
+// ============================================================
+//   CONSULTA DE LECTURAS POR ESFERA Y RANGO DE TIEMPO
+// ============================================================
+// {"Consulta":{"MACs":["A085E369D6AC"],"Desde":e,"Hasta":e,"Horas":h,
+//              "Campos":["humedad","temperatura","bateria","riego"],"Limite":n,"Orden":"desc"}}
+// Todo es opcional: sin filtros devuelve las primeras lecturas guardadas.
+static void procesar_consulta(esp_mqtt_client_handle_t cliente, const cJSON *pedido)
+{
+    esfera_consulta_t consulta;
+    esfera_consulta_default(&consulta);
+
+    const cJSON *item;
+    cJSON_ArrayForEach(item, cJSON_GetObjectItem(pedido, "MACs")) {
+        if (consulta.n_macs == ESFERA_CONSULTA_MACS) {
+            ESP_LOGW(TAG, "⚠️ Consulta con más de %d MACs, se ignoran las demás", ESFERA_CONSULTA_MACS);
+            break;
+        }
+        if (!cJSON_IsString(item) || !esfera_registry_mac_desde_texto(item->valuestring, consulta.macs[consulta.n_macs])) {
+            ESP_LOGW(TAG, "⚠️ MAC inválida en la consulta");
+            return;
+        }
+        consulta.n_macs++;
     }
 
-    err = nvs_get_str(nvs_handle, mac_clean, config_json, &required_size);
-    nvs_close(nvs_handle);
-    if (err != ESP_OK) {
-        ESP_LOGE(TAG, "❌ Error leyendo configuración para %s", mac_str);
-        free(config_json);
-        return;
+    const cJSON *horas = cJSON_GetObjectItem(pedido, "Horas");
+    const cJSON *desde = cJSON_GetObjectItem(pedido, "Desde");
+    const cJSON *hasta = cJSON_GetObjectItem(pedido, "Hasta");
+    if (cJSON_IsNumber(horas) && horas->valuedouble > 0) {
+        time_t ahora = time(NULL);
+        double inicio = (double)ahora - horas->valuedouble * 3600;
+        consulta.desde = inicio > 0 ? (uint32_t)inicio : 0;
+    } else if (cJSON_IsNumber(desde) && desde->valuedouble > 0) {
+        consulta.desde = (uint32_t)desde->valuedouble;
+    }
+    if (cJSON_IsNumber(hasta) && hasta->valuedouble >= 0 && hasta->valuedouble < UINT32_MAX) {
+        consulta.hasta = (uint32_t)hasta->valuedouble;
     }
 
-    esp_err_t send_result = esp_now_send(mac_bin, (uint8_t *)config_json, strlen(config_json));
-    if (send_result == ESP_OK) {
-        ESP_LOGI(TAG, "✅ Configuración enviada a %s", mac_str);
-        ESP_LOGI(TAG, "%s", config_json);
-    } else {
-        ESP_LOGE(TAG, "❌ Fallo al enviar configuración a %s", mac_str);
+    const cJSON *campos = cJSON_GetObjectItem(pedido, "Campos");
+    if (cJSON_IsArray(campos)) {
+        static const struct { const char *nombre; uint8_t bit; } nombres[] = {
+            { "humedad", ESFERA_CONSULTA_HUMEDAD },
+            { "temperatura", ESFERA_CONSULTA_TEMPERATURA },
+            { "bateria", ESFERA_CONSULTA_BATERIA },
+            { "riego", ESFERA_CONSULTA_RIEGO },
+        };
+        consulta.campos = 0;
+        cJSON_ArrayForEach(item, campos) {
+            for (size_t i = 0; cJSON_IsString(item) && i < sizeof(nombres) / sizeof(nombres[0]); i++) {
+                if (strcmp(item->valuestring, nombres[i].nombre) == 0) consulta.campos |= nombres[i].bit;
+            }
+        }
     }
 
-    free(config_json);
+    const cJSON *limite = cJSON_GetObjectItem(pedido, "Limite");
+    if (cJSON_IsNumber(limite) && limite->valuedouble > 0) {
+        consulta.limite = (size_t)limite->valuedouble;
+    }
+    const cJSON *orden = cJSON_GetObjectItem(pedido, "Orden");
+    consulta.descendente = cJSON_IsString(orden) && strcmp(orden->valuestring, "desc") == 0;
+
+    char *out = esfera_consulta_generate_json(&consulta);
+    if (out) {
+        esp_mqtt_client_publish(cliente, topic_public, out, 0, 1, 0);
+        free(out);
+    }
 }
 
 // ============================================================
-//   GUARDAR CONFIGURACIÓN RECIBIDA DESDE MQTT
+//   PROCESAMIENTO DE COMANDOS
 // ============================================================
-static void procesar_configuracion_esfera(const char *payload)
+// Cada mensaje se parsea una sola vez y se despacha por tabla. El comando es el
+// primero (en el orden de la tabla) cuya clave está presente con el tipo
+// esperado; sus campos opcionales, si vienen, deben tener el tipo declarado.
+typedef enum {
+    CAMPO_VERDADERO,
+    CAMPO_NUMERO,
+    CAMPO_TEXTO,
+    CAMPO_OBJETO,
+} campo_tipo_t;
+
+typedef struct {
+    const char *clave;
+    campo_tipo_t tipo;
+} campo_t;
+
+typedef void (*comando_handler_t)(esp_mqtt_client_handle_t cliente, const cJSON *json, const mqtt_mensaje_t *mensaje);
+
+typedef struct {
+    campo_t clave;
+    campo_t opcionales[3];
+    comando_handler_t handler;
+} comando_def_t;
+
+static bool campo_valido(const cJSON *item, campo_tipo_t tipo)
 {
-    cJSON *json = cJSON_Parse(payload);
-    if (!json) {
-        ESP_LOGE(TAG, "❌ Error al parsear JSON");
-        return;
+    switch (tipo) {
+    case CAMPO_VERDADERO: return cJSON_IsTrue(item);
+    case CAMPO_NUMERO:    return cJSON_IsNumber(item);
+    case CAMPO_TEXTO:     return cJSON_IsString(item);
+    case CAMPO_OBJETO:    return cJSON_IsObject(item);
     }
+    return false;
+}
 
-    cJSON *data_flag = cJSON_GetObjectItem(json, "Data");
-    if (cJSON_IsBool(data_flag) && cJSON_IsTrue(data_flag)) {
-        ESP_LOGI(TAG, "📲 Petición de datos (se maneja en handler)");
-        cJSON_Delete(json);
-        return;
+// {"Ack":c} confirma la última página sin pedir otra
+static void comando_ack(esp_mqtt_client_handle_t cliente, const cJSON *json, const mqtt_mensaje_t *mensaje)
+{
+    const cJSON *ack = cJSON_GetObjectItem(json, "Ack");
+    if (esfera_manager_confirmar((uint32_t)ack->valuedouble) != ESP_OK) {
+        ESP_LOGW(TAG, "⚠️ Ack %.0f no corresponde a lo enviado", ack->valuedouble);
     }
+}
 
-    cJSON *mac_slave = cJSON_GetObjectItem(json, "MACSLAVE");
-    if (!cJSON_IsString(mac_slave)) {
-        ESP_LOGE(TAG, "❌ MACSLAVE inválido o ausente");
-        cJSON_Delete(json);
+static void comando_data(esp_mqtt_client_handle_t cliente, const cJSON *json, const mqtt_mensaje_t *mensaje)
+{
+    const cJSON *limite = cJSON_GetObjectItem(json, "Limite");
+    const cJSON *cursor = cJSON_GetObjectItem(json, "Cursor");
+    if (limite || cursor) {
+        // Paginado: {"Data":true,"Limite":n,"Cursor":c}; c confirma la página anterior
+        uint32_t c = cursor ? (uint32_t)cursor->valuedouble : 0;
+        size_t n = limite && limite->valuedouble > 0 ? (size_t)limite->valuedouble : 0;
+        char *out = esfera_manager_generate_pagina(cursor ? &c : NULL, n);
+        if (out) {
+            esp_mqtt_client_publish(cliente, topic_public, out, 0, 1, 0);
+            free(out);
+        }
         return;
     }
 
-    char *json_string = cJSON_PrintUnformatted(json);
-    if (!json_string) {
-        ESP_LOGE(TAG, "❌ No se pudo convertir JSON a string");
-        cJSON_Delete(json);
-        return;
+    ESP_LOGI(TAG, "📲 Petición de datos recibida. Enviando...");
+
+    // "Formato": "bloques" (binario, esfera_codec), "cbor" o "json"
+    const cJSON *formato = cJSON_GetObjectItem(json, "Formato");
+    bool bloques = formato && strcmp(formato->valuestring, "bloques") == 0;
+#ifdef CONFIG_ESFERA_DATA_CBOR
+    bool cbor = !formato || strcmp(formato->valuestring, "cbor") == 0;
+#else
+    bool cbor = formato && strcmp(formato->valuestring, "cbor") == 0;
+#endif
+
+    // Si no se pudo encolar la publicación el snapshot queda retenido para el próximo pedido
+    size_t len = 0;
+    char *out = bloques ? (char *)esfera_manager_generate_bloques(&len)
+              : cbor    ? (char *)esfera_manager_generate_cbor(&len)
+                        : esfera_manager_generate_json();
+    // len 0 hace que esp-mqtt use strlen(): un snapshot vacío en bloques se publica como ""
+    const char *datos = bloques && len == 0 ? "" : out;
+    if (out && esp_mqtt_client_publish(cliente, topic_public, datos, (int)len, 1, 0) >= 0) {
+        esfera_manager_clear();
+    } else {
+        ESP_LOGW(TAG, "⚠️ No se pudo publicar, los datos se reintentan en el próximo pedido");
     }
+    free(out);
+}
 
-    char mac_clean[13];
-    int j = 0;
-    for (int i = 0; mac_slave->valuestring[i] && j < 12; i++) {
-        if (mac_slave->valuestring[i] != ':') mac_clean[j++] = mac_slave->valuestring[i];
+// Lecturas guardadas filtradas por esfera, rango de tiempo y campos
+static void comando_consulta(esp_mqtt_client_handle_t cliente, const cJSON *json, const mqtt_mensaje_t *mensaje)
+{
+    ESP_LOGI(TAG, "📲 Consulta recibida");
+    procesar_consulta(cliente, cJSON_GetObjectItem(json, "Consulta"));
+}
+
+// Estado actual por esfera desde la tabla en RAM, sin tocar el buffer de lecturas
+static void comando_estado(esp_mqtt_client_handle_t cliente, const cJSON *json, const mqtt_mensaje_t *mensaje)
+{
+    ESP_LOGI(TAG, "📲 Petición de estado recibida");
+    char *json_out = esfera_stats_generate_json();
+    if (json_out) {
+        esp_mqtt_client_publish(cliente, topic_public, json_out, 0, 1, 0);
+        free(json_out);
     }
-    mac_clean[j] = '\0';
+}
 
-    nvs_handle_t nvs_handle;
-    esp_err_t err = nvs_open("config_store", NVS_READWRITE, &nvs_handle);
-    if (err != ESP_OK) {
-        ESP_LOGE(TAG, "❌ Error abriendo NVS: %s", esp_err_to_name(err));
-        free(json_string);
+// Configuración para una esfera: se guarda el mensaje tal cual llegó (ya minificado)
+static void comando_configuracion(esp_mqtt_client_handle_t cliente, const cJSON *json, const mqtt_mensaje_t *mensaje)
+{
+    ESP_LOGI(TAG, "⚙️ Configuración recibida");
+    esfera_config_guardar(cJSON_GetObjectItem(json, "MACSLAVE")->valuestring, mensaje->datos);
+}
+
+static const comando_def_t s_comandos_def[] = {
+    { { "Ack", CAMPO_NUMERO }, { { 0 } }, comando_ack },
+    { { "Data", CAMPO_VERDADERO },
+      { { "Limite", CAMPO_NUMERO }, { "Cursor", CAMPO_NUMERO }, { "Formato", CAMPO_TEXTO } }, comando_data },
+    { { "Consulta", CAMPO_OBJETO }, { { 0 } }, comando_consulta },
+    { { "Estado", CAMPO_VERDADERO }, { { 0 } }, comando_estado },
+    { { "MACSLAVE", CAMPO_TEXTO }, { { 0 } }, comando_configuracion },
+};
+
+// Recibe el mensaje ya completo, armado por mqtt_reensamblado
+static void procesar_mensaje(esp_mqtt_client_handle_t cliente, mqtt_mensaje_t *mensaje)
+{
+    // Minificar en el lugar es una pasada sin reservas y deja los bytes listos
+    // para guardarse sin volver a serializar
+    cJSON_Minify(mensaje->datos);
+    mensaje->len = strlen(mensaje->datos);
+
+    cJSON *json = cJSON_ParseWithLength(mensaje->datos, mensaje->len);
+    if (!json) {
+        ESP_LOGW(TAG, "⚠️ JSON inválido");
+        return;
+    }
+
+    const comando_def_t *cmd = NULL;
+    for (size_t i = 0; !cmd && i < sizeof(s_comandos_def) / sizeof(s_comandos_def[0]); i++) {
+        const campo_t *clave = &s_comandos_def[i].clave;
+        if (campo_valido(cJSON_GetObjectItem(json, clave->clave), clave->tipo)) cmd = &s_comandos_def[i];
+    }
+    if (!cmd) {
+        ESP_LOGW(TAG, "⚠️ Comando desconocido");
         cJSON_Delete(json);
         return;
     }
 
-    err = nvs_set_str(nvs_handle, mac_clean, json_string);
-    if (err == ESP_OK) {
-        nvs_commit(nvs_handle);
-        ESP_LOGI(TAG, "💾 Configuración almacenada para %s", mac_slave->valuestring);
-    } else {
-        ESP_LOGE(TAG, "❌ Error escribiendo en NVS: %s", esp_err_to_name(err));
+    for (size_t i = 0; i < sizeof(cmd->opcionales) / sizeof(cmd->opcionales[0]) && cmd->opcionales[i].clave; i++) {
+        const cJSON *item = cJSON_GetObjectItem(json, cmd->opcionales[i].clave);
+        if (item && !campo_valido(item, cmd->opcionales[i].tipo)) {
+            ESP_LOGW(TAG, "⚠️ \"%s\": tipo inválido en \"%s\"", cmd->clave.clave, cmd->opcionales[i].clave);
+            cJSON_Delete(json);
+            return;
+        }
     }
 
-    nvs_close(nvs_handle);
-    free(json_string);
+    cmd->handler(cliente, json, mensaje);
     cJSON_Delete(json);
 }
 
+// ============================================================
+//   TAREA DE COMANDOS
+// ============================================================
+// Resumen periódico de los contadores que no tienen otro consumidor
+static void reportar_metricas(void)
+{
+    // Sobrescritas o rechazadas indican que las publicaciones no alcanzan a la flota
+    esfera_manager_stats_t buf;
+    esfera_manager_get_stats(&buf);
+    ESP_LOGI(TAG, "📊 Buffer: %" PRIu32 "/%" PRIu32 " lecturas, %" PRIu32 " sobrescritas, %" PRIu32 " rechazadas",
+             buf.ocupacion, 2 * buf.capacidad, buf.sobrescritas, buf.rechazadas);
+
+    if (esfera_log_habilitado()) {
+        esfera_log_stats_t log;
+        esfera_log_get_stats(&log);
+        ESP_LOGI(TAG, "📊 Log: %" PRIu32 " pendientes, %" PRIu32 " escritas, %" PRIu32 " perdidas, %" PRIu32
+                 " borrados de %" PRIu32 " páginas, %" PRIu32 " commits del ack, %" PRIu32 " errores",
+                 log.pendientes, log.escritas, log.perdidas, log.borrados, log.paginas, log.commits_ack, log.errores);
+        ESP_LOGI(TAG, "📊 Historial: %" PRIu32 " lecturas comprimidas en %" PRIu32 " bytes",
+                 log.archivadas, log.bytes_historial);
+    }
+
+    espnow_downlink_stats_t dl;
+    espnow_downlink_get_totales(&dl);
+    ESP_LOGI(TAG, "📊 Downlink: %" PRIu32 " entregadas, %" PRIu32 " fallidas, %" PRIu32 " envíos, "
+             "latencia media %" PRIu32 " ms max %" PRIu32 " ms",
+             dl.entregadas, dl.fallidas, dl.intentos, dl.latencia_media_ms, dl.latencia_max_ms);
+
+    // Excedidos o sin buffer piden agrandar MQTT_MENSAJE_MAX o MQTT_MENSAJES_POOL
+    mqtt_reensamblado_stats_t rx;
+    mqtt_reensamblado_get_stats(&rx);
+    ESP_LOGI(TAG, "📊 Reensamblado: %" PRIu32 " completos (%" PRIu32 " fragmentados), %" PRIu32 " excedidos, %"
+             PRIu32 " sin buffer, %" PRIu32 " incompletos",
+             rx.completos, rx.fragmentados, rx.excedidos, rx.sin_buffer, rx.incompletos);
+
+    // Los desalojos de la ventana muestran si la flota no entra en la tabla del driver
+    static uint32_t desalojos_reportados;
+    espnow_peers_stats_t peers;
+    espnow_peers_get_stats(&peers);
+    ESP_LOGI(TAG, "📊 Peers: %" PRIu32 "/%d activos, %" PRIu32 " altas, %" PRIu32 " desalojos (%" PRIu32
+             " en la ventana), %" PRIu32 " fallos",
+             peers.activos, ESPNOW_PEERS_MAX, peers.altas, peers.desalojos,
+             peers.desalojos - desalojos_reportados, peers.fallos);
+    desalojos_reportados = peers.desalojos;
+
+#if CONFIG_MQTT_TELEMETRIA
+    mqtt_telemetria_metricas_t t;
+    mqtt_telemetria_get_metricas(&t);
+    ESP_LOGI(TAG, "📊 Telemetría: %" PRIu32 " mensajes, %" PRIu32 " lecturas (%" PRIu32 ".%02" PRIu32 "/mensaje, "
+             "%" PRIu32 " bytes), latencia media %" PRIu32 " ms max %" PRIu32 " ms, cierres por tamaño %" PRIu32
+             " y por antigüedad %" PRIu32 ", descartadas %" PRIu32 ", errores %" PRIu32,
+             t.mensajes, t.registros, t.registros_por_mensaje_x100 / 100, t.registros_por_mensaje_x100 % 100,
+             t.bytes_por_mensaje, t.latencia_media_ms, t.latencia_max_ms, t.por_tamano, t.por_antiguedad,
+             t.descartadas, t.errores);
+#endif
+}
+
+// Parseo, NVS y generación/publicación de respuestas corren acá, fuera de la
+// tarea de esp-mqtt, para que keepalives y recepción no esperen a un comando.
+static void comandos_task(void *arg)
+{
+    comando_t cmd;
+    int64_t proximo_reporte_us = esp_timer_get_time() + REPORTE_MS * 1000LL;
+    while (true) {
+        int64_t ahora = esp_timer_get_time();
+        if (ahora >= proximo_reporte_us) {
+            reportar_metricas();
+            proximo_reporte_us = ahora + REPORTE_MS * 1000LL;
+        }
+        TickType_t espera = pdMS_TO_TICKS((proximo_reporte_us - ahora) / 1000) + 1;
+        if (xQueueReceive(s_comandos, &cmd, espera) != pdTRUE) continue;
+
+        if (cmd.tipo == COMANDO_CONECTADO) {
+            mqtt_manager_suscribirse(topic_suscripcion);
+            continue;
+        }
+        if (cmd.tipo == COMANDO_TELEMETRIA) {
+            atomic_store(&s_telemetria_avisada, false);
+            mqtt_telemetria_flush(false);
+            continue;
+        }
+
+        int64_t inicio = esp_timer_get_time();
+        ESP_LOGI(TAG, "📝 Data: %.*s", (int)cmd.mensaje->len, cmd.mensaje->datos);
+        procesar_mensaje(cmd.cliente, cmd.mensaje);
+        int64_t fin = esp_timer_get_time();
+        ESP_LOGD(TAG, "Comando: %lld ms en cola, %lld ms de proceso",
+                 (long long)(inicio - cmd.mensaje->recibido_us) / 1000, (long long)(fin - inicio) / 1000);
+        mqtt_reensamblado_liberar(cmd.mensaje);
+    }
+}
+
+// Desde la tarea de esp-mqtt: no bloquea. Con la cola llena el comando se descarta.
+static void encolar_comando(comando_tipo_t tipo, esp_mqtt_client_handle_t cliente, mqtt_mensaje_t *mensaje)
+{
+    comando_t cmd = { .tipo = tipo, .cliente = cliente, .mensaje = mensaje };
+    if (xQueueSend(s_comandos, &cmd, 0) != pdTRUE) {
+        ESP_LOGW(TAG, "⚠️ Cola de comandos llena, se descarta");
+        mqtt_reensamblado_liberar(mensaje);
+    }
+}
+
+// Desde el timer de telemetría o la ingesta: solo avisa, la publicación la hace la tarea
+static void avisar_telemetria(void)
+{
+    if (atomic_exchange(&s_telemetria_avisada, true)) return;
+    comando_t cmd = { .tipo = COMANDO_TELEMETRIA };
+    if (xQueueSend(s_comandos, &cmd, 0) != pdTRUE) {
+        atomic_store(&s_telemetria_avisada, false);
+    }
+}
+
 // ============================================================
 //   CALLBACK EVENTOS MQTT
 // ============================================================
@@ -169,40 +456,18 @@ static esp_err_t mqtt_event_handler_cb(esp_mqtt_event_handle_t event)
     switch (event->event_id) {
     case MQTT_EVENT_CONNECTED:
         ESP_LOGI(TAG, "🔌 Conectado al broker MQTT");
-        vTaskDelay(pdMS_TO_TICKS(500));
-        mqtt_manager_suscribirse(topic_suscripcion);
+        encolar_comando(COMANDO_CONECTADO, event->client, NULL);
         break;
 
     case MQTT_EVENT_DATA: {
-        ESP_LOGI(TAG, "📥 Mensaje recibido:");
-        ESP_LOGI(TAG, "📌 Topic: %.*s", event->topic_len, event->topic);
-        ESP_LOGI(TAG, "📝 Data: %.*s", event->data_len, event->data);
-
-        char payload[256];
-        int len = event->data_len < sizeof(payload) - 1 ? event->data_len : sizeof(payload) - 1;
-        memcpy(payload, event->data, len);
-        payload[len] = '\0';
-
-        cJSON *json = cJSON_Parse(payload);
-        if (!json) {
-            ESP_LOGW(TAG, "⚠️ JSON inválido");
-            break;
+        if (event->current_data_offset == 0) {
+            ESP_LOGI(TAG, "📥 Mensaje recibido:");
+            ESP_LOGI(TAG, "📌 Topic: %.*s", event->topic_len, event->topic);
         }
 
-        cJSON *data_flag = cJSON_GetObjectItem(json, "Data");
-        if (cJSON_IsTrue(data_flag)) {
-            ESP_LOGI(TAG, "📲 Petición de datos recibida. Enviando...");
-
-            char *json_out = esfera_manager_generate_json();
-            esp_mqtt_client_publish(event->client, topic_public, json_out, 0, 1, 0);
-            free(json_out);
-            esfera_manager_clear();
-        } else {
-            ESP_LOGI(TAG, "⚙️ Configuración recibida");
-            procesar_configuracion_esfera(payload);
-        }
-
-        cJSON_Delete(json);
+        // Los mensajes grandes llegan en varios eventos: se procesan recién completos
+        mqtt_mensaje_t *mensaje = mqtt_reensamblado_agregar(event);
+        if (mensaje) encolar_comando(COMANDO_MENSAJE, event->client, mensaje);
         break;
     }
 
@@ -221,35 +486,64 @@ static void mqtt_event_handler(void *handler_args, esp_event_base_t base, int32_
 // ============================================================
 //   FUNCIÓN PARA CALLBACK ESP-NOW
 // ============================================================
+// Corre en la tarea Wi-Fi: solo copia la trama al ring de ingesta.
 void espnow_recv_cb(const esp_now_recv_info_t *recv_info, const uint8_t *data, int len)
+{
+    espnow_ingest_push(recv_info, data, len);
+}
+
+// Corre en la tarea de ingesta: parseo, registro en NVS y envío de configuración.
+static void procesar_trama_esfera(const espnow_trama_t *trama)
 {
     char mac_str[13];
     snprintf(mac_str, sizeof(mac_str), "%02X%02X%02X%02X%02X%02X",
-             recv_info->src_addr[0], recv_info->src_addr[1], recv_info->src_addr[2],
-             recv_info->src_addr[3], recv_info->src_addr[4], recv_info->src_addr[5]);
-
-    char payload[128] = {0};
-    memcpy(payload, data, len < 127 ? len : 127);
-
-    ESP_LOGI(TAG, "📥 Recibido de %s: %s", mac_str, payload);
-
-    esfera_manager_add(payload, mac_str);
-
-    esp_err_t err = esfera_manager_register_mac(mac_str);
-    if (err == ESP_OK) {
+             trama->mac[0], trama->mac[1], trama->mac[2],
+             trama->mac[3], trama->mac[4], trama->mac[5]);
+
+    ESP_LOGD(TAG, "📥 Recibido de %s (RSSI %d): %u bytes", mac_str, trama->rssi, trama->len);
+
+    // Solo una trama válida registra al emisor: ruido o tramas ajenas no deben
+    // ocupar lugares del registro ni escrituras en NVS
+    esfera_lectura_t lectura;
+    if (esfera_frame_decode(trama->data, trama->len, mac_str, &lectura) != ESP_OK) return;
+
+    uint16_t indice;
+    bool nueva = false;
+    esp_err_t err = esfera_registry_register(trama->mac, &indice, &nueva);
+    if (err == ESP_ERR_NO_MEM) {
+        ESP_LOGW(TAG, "⚠️ Registro de esferas lleno, %s no se registra", mac_str);
+    } else if (nueva) {
         ESP_LOGI(TAG, "✅ Nueva esfera registrada: %s", mac_str);
     }
 
-    esp_now_peer_info_t peer = {
-        .ifidx = WIFI_IF_STA,
-        .encrypt = false};
-    memcpy(peer.peer_addr, recv_info->src_addr, ESP_NOW_ETH_ALEN);
+    // Las tramas v3 traen varias muestras: cada una va al buffer con su propio timestamp
+    for (uint8_t i = 0; i < lectura.muestras; i++) {
+        if (i > 0) esfera_frame_muestra(trama->data, i, &lectura);
 
-    if (!esp_now_is_peer_exist(recv_info->src_addr)) {
-        esp_now_add_peer(&peer);
-    } else {
-        intentar_enviar_configuracion_a_esfera(mac_str, recv_info->src_addr);
+        if (err == ESP_OK && lectura.tiene_seq &&
+            esfera_seq_check(indice, lectura.seq, trama->rx_us) == ESFERA_SEQ_DUPLICADA) {
+            ESP_LOGD(TAG, "Duplicado de %s (seq %u) descartado", mac_str, lectura.seq);
+            continue;
+        }
+        time_t epoch = (time_t)trama->epoch - lectura.edad_s;
+        esfera_manager_add(err == ESP_OK ? indice : ESFERA_REGISTRY_NINGUNA, &lectura, epoch);
+#if CONFIG_MQTT_TELEMETRIA
+        mqtt_manager_publicar_datos(mac_str, lectura.temperatura / 100.0f, lectura.humedad / 100.0f,
+                                    lectura.voltaje_mv / 1000.0f, lectura.riego, (uint32_t)epoch);
+#endif
     }
+
+    if (err != ESP_OK) return;
+
+    espnow_peers_tocar(trama->mac);
+    intentar_enviar_configuracion_a_esfera(indice, &lectura, mac_str, trama->mac);
+}
+
+// Las esferas nuevas del lote se persisten juntas en un solo commit
+static void fin_lote_esferas(void)
+{
+    esfera_registry_flush();
+    esfera_log_flush(false);
 }
 
 // ============================================================
@@ -262,6 +556,19 @@ void mqtt_manager_init(void)
     ESP_LOGI(TAG, "📡 Topic suscripción: %s", topic_suscripcion);
     ESP_LOGI(TAG, "📡 Topic publicación: %s", topic_public);
 
+    esfera_config_init(mac_local);
+    ESP_ERROR_CHECK(mqtt_reensamblado_init());
+    s_comandos = xQueueCreate(COMANDOS_COLA, sizeof(comando_t));
+    if (!s_comandos || xTaskCreate(comandos_task, "mqtt_cmd", COMANDOS_TASK_STACK, NULL,
+                                   COMANDOS_TASK_PRIO, NULL) != pdPASS) {
+        ESP_LOGE(TAG, "❌ No se pudo crear la tarea de comandos");
+        return;
+    }
+
+    // Ingesta y downlink deben estar listos antes de que hub_iniciar_espnow registre el callback
+    ESP_ERROR_CHECK(espnow_downlink_init(resultado_downlink));
+    ESP_ERROR_CHECK(espnow_ingest_init(procesar_trama_esfera, fin_lote_esferas));
+
     esp_mqtt_client_config_t mqtt_cfg = {
         .broker = {
             .address.uri = MQTT_URI,
@@ -288,29 +595,18 @@ void mqtt_manager_init(void)
         return;
     }
 
+    ESP_ERROR_CHECK(mqtt_telemetria_init(client, topic_public, avisar_telemetria));
     esp_mqtt_client_register_event(client, ESP_EVENT_ANY_ID, mqtt_event_handler, NULL);
     ESP_ERROR_CHECK(esp_mqtt_client_start(client));
     ESP_LOGI(TAG, "✅ Cliente MQTT iniciado");
 }
 
-void mqtt_manager_publicar_datos(const char *mac, float temperatura, float humedad, float voltaje, int riego)
+void mqtt_manager_publicar_datos(const char *mac, float temperatura, float humedad, float voltaje, int riego,
+                                 uint32_t epoch)
 {
-    char payload[256];
-    snprintf(payload, sizeof(payload),
-             "temperatura,device=%s value=%.2f\n"
-             "humedad,device=%s value=%.2f\n"
-             "vbat,device=%s value=%.2f\n"
-             "riego,device=%s value=%d",
-             mac, temperatura,
-             mac, humedad,
-             mac, voltaje,
-             mac, riego);
-
-    int msg_id = esp_mqtt_client_publish(client, topic_public, payload, 0, 1, 0);
-    if (msg_id != -1) {
-        ESP_LOGI(TAG, "✅ Publicado a %s: %s", topic_public, payload);
-    } else {
-        ESP_LOGE(TAG, "❌ Error al publicar en el broker MQTT");
+    esp_err_t err = mqtt_telemetria_agregar(mac, temperatura, humedad, voltaje, riego, epoch);
+    if (err != ESP_OK) {
+        ESP_LOGE(TAG, "❌ No se pudo agregar la lectura de %s al lote: %s", mac, esp_err_to_name(err));
     }
 }
 
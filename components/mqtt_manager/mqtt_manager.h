@@ -10,14 +10,19 @@ void mqtt_manager_init(void);
 
 /**
  * @brief Publica un dato de sensor en formato Influx Line Protocol.
+ *
+ * No bloquea: la lectura se agrega a un lote (mqtt_telemetria) que se encola
+ * como un solo mensaje al llenarse o al cumplir MQTT_TELEMETRIA_MAX_MS.
  * 
  * @param mac Dirección MAC del dispositivo.
  * @param temperatura Temperatura medida.
  * @param humedad Humedad medida.
  * @param voltaje Voltaje de batería.
  * @param riego Estado del riego (0 o 1).
+ * @param epoch Momento de la lectura, en segundos Unix.
  */
-void mqtt_manager_publicar_datos(const char* mac, float temperatura, float humedad, float voltaje, int riego);
+void mqtt_manager_publicar_datos(const char* mac, float temperatura, float humedad, float voltaje, int riego,
+                                 uint32_t epoch);
 
 
 /**
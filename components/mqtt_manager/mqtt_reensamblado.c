@@ -0,0 +1,137 @@
+#include "mqtt_reensamblado.h"
+#include <stdlib.h>
+#include <string.h>
+#include "esp_log.h"
+#include "esp_timer.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/semphr.h"
+
+static const char *TAG = "MQTT_REENSAMBLADO";
+
+static mqtt_mensaje_t *s_pool;
+static uint32_t s_libres;           // Bit i: buffer i libre
+static SemaphoreHandle_t s_mutex;
+
+// Mensaje en armado; solo lo toca la tarea de esp-mqtt
+static mqtt_mensaje_t *s_armando;
+static size_t s_esperado;           // total_data_len de s_armando
+static bool s_descartando;          // Saltear fragmentos hasta el próximo mensaje
+static bool s_fragmentado;
+
+// Los escribe la tarea de esp-mqtt y los lee la de comandos al reportar
+static mqtt_reensamblado_stats_t s_stats;
+static portMUX_TYPE s_stats_lock = portMUX_INITIALIZER_UNLOCKED;
+
+_Static_assert(MQTT_MENSAJES_POOL <= 32, "El pool se indexa con una máscara de 32 bits");
+
+esp_err_t mqtt_reensamblado_init(void)
+{
+    if (s_pool) return ESP_OK;
+
+    s_mutex = xSemaphoreCreateMutex();
+    s_pool = malloc(MQTT_MENSAJES_POOL * sizeof(mqtt_mensaje_t));
+    if (!s_mutex || !s_pool) {
+        ESP_LOGE(TAG, "❌ Sin memoria para %d buffers de %d bytes", MQTT_MENSAJES_POOL, MQTT_MENSAJE_MAX);
+        return ESP_ERR_NO_MEM;
+    }
+    s_libres = (1ULL << MQTT_MENSAJES_POOL) - 1;
+    return ESP_OK;
+}
+
+static void contar(uint32_t *contador)
+{
+    taskENTER_CRITICAL(&s_stats_lock);
+    (*contador)++;
+    taskEXIT_CRITICAL(&s_stats_lock);
+}
+
+static mqtt_mensaje_t *tomar(void)
+{
+    mqtt_mensaje_t *m = NULL;
+    xSemaphoreTake(s_mutex, portMAX_DELAY);
+    if (s_libres) {
+        int i = __builtin_ctz(s_libres);
+        s_libres &= ~(1u << i);
+        m = &s_pool[i];
+    }
+    xSemaphoreGive(s_mutex);
+    return m;
+}
+
+void mqtt_reensamblado_liberar(mqtt_mensaje_t *mensaje)
+{
+    if (!mensaje) return;
+
+    xSemaphoreTake(s_mutex, portMAX_DELAY);
+    s_libres |= 1u << (mensaje - s_pool);
+    xSemaphoreGive(s_mutex);
+}
+
+mqtt_mensaje_t *mqtt_reensamblado_agregar(const esp_mqtt_event_handle_t event)
+{
+    if (!s_pool || event->data_len < 0) return NULL;
+
+    size_t total = event->total_data_len > 0 ? (size_t)event->total_data_len : (size_t)event->data_len;
+    size_t offset = event->current_data_offset > 0 ? (size_t)event->current_data_offset : 0;
+
+    if (offset == 0) {
+        // Un mensaje nuevo corta al que estaba a medias
+        if (s_armando) {
+            contar(&s_stats.incompletos);
+            ESP_LOGW(TAG, "⚠️ Mensaje incompleto descartado (%u de %u bytes)",
+                     (unsigned)s_armando->len, (unsigned)s_esperado);
+            mqtt_reensamblado_liberar(s_armando);
+            s_armando = NULL;
+        }
+        s_descartando = false;
+        s_fragmentado = (size_t)event->data_len < total;
+
+        if (total > MQTT_MENSAJE_MAX) {
+            contar(&s_stats.excedidos);
+            s_descartando = true;
+            ESP_LOGW(TAG, "⚠️ Mensaje de %u bytes supera el máximo de %d, se descarta",
+                     (unsigned)total, MQTT_MENSAJE_MAX);
+            return NULL;
+        }
+        s_armando = tomar();
+        if (!s_armando) {
+            contar(&s_stats.sin_buffer);
+            s_descartando = true;
+            ESP_LOGW(TAG, "⚠️ Sin buffers libres, mensaje de %u bytes descartado", (unsigned)total);
+            return NULL;
+        }
+        s_armando->len = 0;
+        s_esperado = total;
+    } else if (s_descartando) {
+        return NULL;
+    } else if (!s_armando || offset != s_armando->len || offset + event->data_len > s_esperado) {
+        // Fragmento sin comienzo o fuera de orden: no hay forma de recomponer el mensaje
+        contar(&s_stats.incompletos);
+        s_descartando = true;
+        mqtt_reensamblado_liberar(s_armando);
+        s_armando = NULL;
+        ESP_LOGW(TAG, "⚠️ Fragmento fuera de orden (offset %u), mensaje descartado", (unsigned)offset);
+        return NULL;
+    }
+
+    memcpy(&s_armando->datos[s_armando->len], event->data, event->data_len);
+    s_armando->len += event->data_len;
+    if (s_armando->len < s_esperado) return NULL;
+
+    mqtt_mensaje_t *completo = s_armando;
+    s_armando = NULL;
+    completo->datos[completo->len] = '\0';
+    completo->recibido_us = esp_timer_get_time();
+    taskENTER_CRITICAL(&s_stats_lock);
+    s_stats.completos++;
+    if (s_fragmentado) s_stats.fragmentados++;
+    taskEXIT_CRITICAL(&s_stats_lock);
+    return completo;
+}
+
+void mqtt_reensamblado_get_stats(mqtt_reensamblado_stats_t *stats)
+{
+    taskENTER_CRITICAL(&s_stats_lock);
+    *stats = s_stats;
+    taskEXIT_CRITICAL(&s_stats_lock);
+}
@@ -0,0 +1,51 @@
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdbool.h>
+#include "esp_err.h"
+#include "mqtt_client.h"
+
+#define MQTT_MENSAJE_MAX    4096    // Largo máximo de un mensaje entrante
+#define MQTT_MENSAJES_POOL  4       // Mensajes completos que pueden estar en proceso a la vez
+
+/**
+ * @brief Mensaje entrante completo, en un buffer del pool. datos termina en '\0'.
+ */
+typedef struct {
+    int64_t recibido_us;    // esp_timer_get_time() al completarse
+    size_t len;
+    char datos[MQTT_MENSAJE_MAX + 1];
+} mqtt_mensaje_t;
+
+typedef struct {
+    uint32_t completos;
+    uint32_t fragmentados;      // Completos que llegaron en más de un evento
+    uint32_t excedidos;         // Descartados por superar MQTT_MENSAJE_MAX
+    uint32_t sin_buffer;        // Descartados con el pool agotado
+    uint32_t incompletos;       // Cortados por un fragmento fuera de orden o un mensaje nuevo
+} mqtt_reensamblado_stats_t;
+
+/**
+ * @brief Reserva el pool de buffers.
+ */
+esp_err_t mqtt_reensamblado_init(void);
+
+/**
+ * @brief Incorpora un evento MQTT_EVENT_DATA.
+ *
+ * esp-mqtt entrega los mensajes más grandes que su buffer de entrada en varios
+ * eventos consecutivos (current_data_offset / total_data_len). Se llama desde
+ * la tarea de esp-mqtt, que es la única que arma mensajes.
+ *
+ * @return El mensaje cuando llegó el último fragmento, o NULL. Se devuelve al
+ *         pool con mqtt_reensamblado_liberar(), desde cualquier tarea.
+ */
+mqtt_mensaje_t *mqtt_reensamblado_agregar(const esp_mqtt_event_handle_t event);
+
+void mqtt_reensamblado_liberar(mqtt_mensaje_t *mensaje);
+
+/**
+ * @brief Copia consistente de los contadores; se puede llamar desde cualquier tarea.
+ */
+void mqtt_reensamblado_get_stats(mqtt_reensamblado_stats_t *stats);
@@ -0,0 +1,189 @@
+#include "mqtt_telemetria.h"
+#include <stdio.h>
+#include <string.h>
+#include <inttypes.h>
+#include <stdatomic.h>
+#include "esp_log.h"
+#include "esp_timer.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/semphr.h"
+
+#define REGISTRO_MAX    320     // Cota de las cuatro líneas de una lectura
+
+static const char *TAG = "MQTT_TELEMETRIA";
+
+typedef struct {
+    char datos[MQTT_TELEMETRIA_BYTES];
+    size_t len;
+    uint32_t registros;
+    int64_t desde_ms;           // Llegada del registro más viejo
+    int64_t llegadas_suma_ms;   // Suma de las llegadas, para la latencia media
+    bool por_tamano;
+} lote_t;
+
+static esp_mqtt_client_handle_t s_cliente;
+static const char *s_topic;
+static mqtt_telemetria_aviso_t s_aviso;
+static SemaphoreHandle_t s_mutex;
+static esp_timer_handle_t s_timer;
+static atomic_bool s_vencido;
+
+// Doble lote: la ingesta llena s_lotes[s_abierto]; el cerrado (s_cerrado) lo
+// encola la tarea que publica sin tener el mutex, porque nadie más lo toca.
+static lote_t s_lotes[2];
+static int s_abierto;
+static bool s_cerrado;
+
+static mqtt_telemetria_metricas_t s_metricas;
+static uint64_t s_bytes;
+static uint64_t s_latencia_suma_ms;
+
+// Con el mutex tomado. false si el lote anterior todavía no se encoló.
+static bool cerrar_abierto(bool por_tamano)
+{
+    if (s_cerrado) return false;
+    s_lotes[s_abierto].por_tamano = por_tamano;
+    s_abierto = 1 - s_abierto;
+    s_cerrado = true;
+    esp_timer_stop(s_timer);
+    return true;
+}
+
+// El timer corre en la tarea de esp_timer: solo marca y avisa
+static void timer_cb(void *arg)
+{
+    atomic_store(&s_vencido, true);
+    if (s_aviso) s_aviso();
+}
+
+esp_err_t mqtt_telemetria_init(esp_mqtt_client_handle_t cliente, const char *topic, mqtt_telemetria_aviso_t aviso)
+{
+    s_cliente = cliente;
+    s_topic = topic;
+    s_aviso = aviso;
+    if (!s_mutex) s_mutex = xSemaphoreCreateMutex();
+    if (!s_mutex) return ESP_ERR_NO_MEM;
+    if (!s_timer) {
+        const esp_timer_create_args_t args = { .callback = timer_cb, .name = "telemetria" };
+        return esp_timer_create(&args, &s_timer);
+    }
+    return ESP_OK;
+}
+
+esp_err_t mqtt_telemetria_agregar(const char *mac, float temperatura, float humedad, float voltaje, int riego,
+                                  uint32_t epoch)
+{
+    if (!s_cliente) return ESP_ERR_INVALID_STATE;
+
+    char registro[REGISTRO_MAX];
+    int n = snprintf(registro, sizeof(registro),
+                     "temperatura,device=%s value=%.2f %" PRIu32 "\n"
+                     "humedad,device=%s value=%.2f %" PRIu32 "\n"
+                     "vbat,device=%s value=%.2f %" PRIu32 "\n"
+                     "riego,device=%s value=%d %" PRIu32,
+                     mac, temperatura, epoch,
+                     mac, humedad, epoch,
+                     mac, voltaje, epoch,
+                     mac, riego, epoch);
+    if (n < 0 || n >= (int)sizeof(registro)) return ESP_ERR_INVALID_SIZE;
+
+    bool avisar = false;
+    xSemaphoreTake(s_mutex, portMAX_DELAY);
+    lote_t *l = &s_lotes[s_abierto];
+    // Los registros se separan con '\n', como pide el line protocol
+    if (l->len && l->len + 1 + n > sizeof(l->datos)) {
+        if (!cerrar_abierto(true)) {
+            s_metricas.descartadas++;
+            xSemaphoreGive(s_mutex);
+            return ESP_ERR_NO_MEM;
+        }
+        avisar = true;
+        l = &s_lotes[s_abierto];
+    }
+
+    int64_t ahora_ms = esp_timer_get_time() / 1000;
+    if (l->len == 0) {
+        l->desde_ms = ahora_ms;
+        l->registros = 0;
+        l->llegadas_suma_ms = 0;
+        esp_timer_start_once(s_timer, MQTT_TELEMETRIA_MAX_MS * 1000ULL);
+    } else {
+        l->datos[l->len++] = '\n';
+    }
+    memcpy(&l->datos[l->len], registro, n);
+    l->len += n;
+    l->registros++;
+    l->llegadas_suma_ms += ahora_ms;
+    xSemaphoreGive(s_mutex);
+
+    if (avisar && s_aviso) s_aviso();
+    return ESP_OK;
+}
+
+// Sin el mutex: el lote cerrado no lo toca nadie más hasta liberarlo
+static void encolar(lote_t *l)
+{
+    int64_t ahora_ms = esp_timer_get_time() / 1000;
+    uint32_t edad_ms = (uint32_t)(ahora_ms - l->desde_ms);
+
+    // store = true: esp-mqtt copia el mensaje a su outbox y lo envía desde su tarea
+    int id = esp_mqtt_client_enqueue(s_cliente, s_topic, l->datos, (int)l->len, 1, 0, true);
+
+    xSemaphoreTake(s_mutex, portMAX_DELAY);
+    if (id < 0) {
+        s_metricas.errores++;
+        ESP_LOGW(TAG, "⚠️ No se pudo encolar un lote de %" PRIu32 " lecturas", l->registros);
+    } else {
+        s_metricas.mensajes++;
+        s_metricas.registros += l->registros;
+        s_bytes += l->len;
+        s_latencia_suma_ms += (uint64_t)(l->registros * ahora_ms - l->llegadas_suma_ms);
+        if (edad_ms > s_metricas.latencia_max_ms) s_metricas.latencia_max_ms = edad_ms;
+        if (l->por_tamano) s_metricas.por_tamano++;
+        else s_metricas.por_antiguedad++;
+        ESP_LOGD(TAG, "📤 Lote de %" PRIu32 " lecturas (%u bytes, %" PRIu32 " ms)",
+                 l->registros, (unsigned)l->len, edad_ms);
+    }
+    l->len = 0;
+    s_cerrado = false;
+    xSemaphoreGive(s_mutex);
+}
+
+void mqtt_telemetria_flush(bool forzar)
+{
+    if (!s_mutex) return;
+
+    bool vencido = atomic_exchange(&s_vencido, false);
+    for (int vuelta = 0; vuelta < 2; vuelta++) {
+        xSemaphoreTake(s_mutex, portMAX_DELAY);
+        lote_t *abierto = &s_lotes[s_abierto];
+        if (!s_cerrado && abierto->len &&
+            (forzar || vencido || esp_timer_get_time() / 1000 - abierto->desde_ms >= MQTT_TELEMETRIA_MAX_MS)) {
+            cerrar_abierto(false);
+        }
+        lote_t *cerrado = s_cerrado ? &s_lotes[1 - s_abierto] : NULL;
+        xSemaphoreGive(s_mutex);
+
+        if (!cerrado) break;
+        encolar(cerrado);
+    }
+}
+
+void mqtt_telemetria_get_metricas(mqtt_telemetria_metricas_t *metricas)
+{
+    if (!s_mutex) {
+        memset(metricas, 0, sizeof(*metricas));
+        return;
+    }
+
+    xSemaphoreTake(s_mutex, portMAX_DELAY);
+    *metricas = s_metricas;
+    if (s_metricas.mensajes) {
+        metricas->registros_por_mensaje_x100 = (uint32_t)((uint64_t)s_metricas.registros * 100 / s_metricas.mensajes);
+        metricas->bytes_por_mensaje = (uint32_t)(s_bytes / s_metricas.mensajes);
+    }
+    if (s_metricas.registros) {
+        metricas->latencia_media_ms = (uint32_t)(s_latencia_suma_ms / s_metricas.registros);
+    }
+    xSemaphoreGive(s_mutex);
+}
@@ -0,0 +1,59 @@
+#pragma once
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "esp_err.h"
+#include "mqtt_client.h"
+
+#define MQTT_TELEMETRIA_BYTES       4096    // Tamaño máximo de un mensaje agrupado
+#define MQTT_TELEMETRIA_MAX_MS      1000    // Antigüedad máxima del registro más viejo del lote
+
+typedef struct {
+    uint32_t mensajes;          // Mensajes encolados en esp-mqtt
+    uint32_t registros;         // Lecturas incluidas en esos mensajes
+    uint32_t registros_por_mensaje_x100;
+    uint32_t bytes_por_mensaje; // Media
+    uint32_t latencia_media_ms; // Desde que la lectura entra al lote hasta encolarse
+    uint32_t latencia_max_ms;
+    uint32_t por_tamano;        // Lotes cerrados por llenarse
+    uint32_t por_antiguedad;    // Lotes cerrados por vencer MQTT_TELEMETRIA_MAX_MS
+    uint32_t descartadas;       // Lecturas sin lugar: lote lleno con el anterior aún sin enviar
+    uint32_t errores;           // Lotes que esp-mqtt no pudo encolar (se descartan)
+} mqtt_telemetria_metricas_t;
+
+/**
+ * @brief Pide que se llame a mqtt_telemetria_flush() desde la tarea que publica.
+ *        Se invoca desde la ingesta y desde el timer de esp_timer: no debe bloquear.
+ */
+typedef void (*mqtt_telemetria_aviso_t)(void);
+
+/**
+ * @brief Prepara el lote y el timer de vencimiento.
+ *
+ * @param cliente Cliente MQTT ya creado (no hace falta que esté conectado:
+ *                con QoS 1 esp-mqtt guarda el mensaje en su outbox).
+ * @param topic Topic de publicación; debe seguir vigente.
+ * @param aviso Avisa que hay un lote para encolar.
+ */
+esp_err_t mqtt_telemetria_init(esp_mqtt_client_handle_t cliente, const char *topic, mqtt_telemetria_aviso_t aviso);
+
+/**
+ * @brief Agrega una lectura en Influx Line Protocol al lote. No toca el cliente MQTT.
+ *
+ * Cada línea lleva el epoch de la medición con precisión de segundos (el
+ * consumidor debe usar precision=s). El lote se cierra al llenarse o cuando
+ * su registro más viejo supera MQTT_TELEMETRIA_MAX_MS, y se avisa para que
+ * se encole como un único mensaje QoS 1.
+ */
+esp_err_t mqtt_telemetria_agregar(const char *mac, float temperatura, float humedad, float voltaje, int riego,
+                                  uint32_t epoch);
+
+/**
+ * @brief Encola en esp-mqtt los lotes cerrados (y el abierto si venció).
+ *        Puede bloquear en el cliente MQTT: llamarla solo desde la tarea que publica.
+ *
+ * @param forzar true: encola también el lote abierto aunque no haya vencido.
+ */
+void mqtt_telemetria_flush(bool forzar);
+
+void mqtt_telemetria_get_metricas(mqtt_telemetria_metricas_t *metricas);
@@ -20,6 +20,7 @@
 #include "time_sync.h"
 #include "detector_manager.h"
 #include "button_manager.h"
+#include "espnow_downlink.h"
 
 
 #define TAG "HUB"
@@ -39,6 +40,7 @@ void hub_iniciar_espnow(void)
 
     ESP_ERROR_CHECK(esp_now_init());
     ESP_ERROR_CHECK(esp_now_register_recv_cb(espnow_recv_cb));
+    ESP_ERROR_CHECK(esp_now_register_send_cb(espnow_downlink_send_cb));
 
     esp_now_peer_info_t broadcast_peer = {
         .ifidx = WIFI_IF_STA,
@@ -90,6 +92,8 @@ void app_main(void)
 
     vTaskDelay(pdMS_TO_TICKS(1000));
 
+    esfera_manager_init();
+
     mqtt_manager_init();
 
     ESP_LOGI(TAG, "📡 HUB listo para recibir datos por ESP-NOW...");
@@ -0,0 +1,288 @@
+// Benchmark de la respuesta "Data" en CBOR contra JSON (escritor en streaming
+// y el árbol cJSON anterior) y los bloques de esfera_codec, con flotas de
+// tamaño realista: tamaño en bytes y tiempo de codificación del snapshot.
+//
+//   bench_cbor [-r repeticiones]
+//
+// Cada escenario es una flota de n esferas con k lecturas pendientes cada una
+// (una publicación cada k intervalos de medición), que llegan intercaladas.
+// Antes de medir se decodifica el CBOR y se compara con el snapshot.
+#include <stdlib.h>
+#include <string.h>
+#include <inttypes.h>
+#include <getopt.h>
+#include "esp_log.h"
+#include "esp_timer.h"
+#include "host.h"
+#include "prueba.h"
+#include "cJSON.h"
+#include "esfera_cbor.h"
+#include "esfera_manager.h"
+
+typedef struct {
+    int esferas;
+    int lecturas;           // Por esfera en cada snapshot
+    const char *nombre;
+} escenario_t;
+
+// El snapshot tiene a lo sumo CONFIG_ESFERA_BUFFER_CAPACIDAD lecturas
+static const escenario_t s_escenarios[] = {
+    { 10, 12, "casa, publicación por minuto" },
+    { 50, 12, "quinta" },
+    { 128, 8, "registro lleno" },
+    { 1000, 1, "1000 esferas, una lectura" },
+};
+
+static uint32_t s_azar = 2463534242u;
+
+static uint32_t azar(void)
+{
+    s_azar ^= s_azar << 13;
+    s_azar ^= s_azar >> 17;
+    s_azar ^= s_azar << 5;
+    return s_azar;
+}
+
+static void llenar(const escenario_t *esc)
+{
+    uint16_t humedad[1000];
+    int16_t temperatura[1000];
+    uint16_t bateria[1000];
+    for (int i = 0; i < esc->esferas; i++) {
+        humedad[i] = (uint16_t)(3000 + azar() % 4000);
+        temperatura[i] = (int16_t)(1500 + azar() % 1500);
+        bateria[i] = (uint16_t)(3600 + azar() % 600);
+    }
+
+    uint32_t epoch = 1767225600;
+    for (int k = 0; k < esc->lecturas; k++, epoch += 5) {
+        for (int i = 0; i < esc->esferas; i++) {
+            esfera_lectura_t l = { .muestras = 1 };
+            humedad[i] = (uint16_t)(humedad[i] + (int)(azar() % 21) - 10);
+            temperatura[i] = (int16_t)(temperatura[i] + (int)(azar() % 11) - 5);
+            if (azar() % 8 == 0) bateria[i]--;
+            l.humedad = humedad[i];
+            l.temperatura = temperatura[i];
+            l.voltaje_mv = bateria[i];
+            l.riego = (azar() % 16) == 0;
+            snprintf(l.mac, sizeof(l.mac), "A085E3%06X", i);
+            esfera_manager_add(ESFERA_REGISTRY_NINGUNA, &l, (time_t)(epoch + (uint32_t)i % 5));
+        }
+    }
+}
+
+// ============================================================
+//   VERIFICACIÓN DEL CBOR
+// ============================================================
+typedef struct {
+    const uint8_t *p;
+    size_t len;
+    size_t pos;
+    bool error;
+} lector_t;
+
+// Cabecera de un ítem: tipo mayor y argumento (largos definidos solamente)
+static uint64_t leer_cabecera(lector_t *r, uint8_t *tipo)
+{
+    if (r->pos >= r->len) {
+        r->error = true;
+        return 0;
+    }
+    uint8_t ib = r->p[r->pos++];
+    *tipo = ib >> 5;
+    uint8_t info = ib & 0x1F;
+    if (info < 24) return info;
+    int bytes = info == 24 ? 1 : info == 25 ? 2 : info == 26 ? 4 : info == 27 ? 8 : 0;
+    if (bytes == 0 || r->pos + bytes > r->len) {
+        r->error = true;
+        return 0;
+    }
+    uint64_t v = 0;
+    for (int i = 0; i < bytes; i++) v = (v << 8) | r->p[r->pos++];
+    return v;
+}
+
+static uint64_t leer_uint(lector_t *r)
+{
+    uint8_t tipo;
+    uint64_t v = leer_cabecera(r, &tipo);
+    if (tipo != 0) r->error = true;
+    return v;
+}
+
+static int64_t leer_int(lector_t *r)
+{
+    uint8_t tipo;
+    uint64_t v = leer_cabecera(r, &tipo);
+    if (tipo == 0) return (int64_t)v;
+    if (tipo == 1) return -1 - (int64_t)v;
+    r->error = true;
+    return 0;
+}
+
+static void verificar_cbor(const uint8_t *cbor, size_t len, size_t cantidad)
+{
+    lector_t r = { .p = cbor, .len = len };
+    uint8_t tipo;
+    VERIFICAR(leer_cabecera(&r, &tipo) == cantidad && tipo == 4);
+
+    for (size_t i = 0; i < cantidad && !r.error; i++) {
+        const esfera_data_t *e = esfera_manager_snapshot_leer(i);
+        VERIFICAR(leer_cabecera(&r, &tipo) == 6 && tipo == 5);
+
+        VERIFICAR(leer_uint(&r) == ESFERA_CBOR_MAC);
+        VERIFICAR(leer_cabecera(&r, &tipo) == 6 && tipo == 2 && r.pos + 6 <= len);
+        VERIFICAR(!r.error && memcmp(&cbor[r.pos], e->mac, 6) == 0);
+        r.pos += 6;
+
+        VERIFICAR(leer_uint(&r) == ESFERA_CBOR_TIMESTAMP);
+        VERIFICAR(leer_cabecera(&r, &tipo) == 1 && tipo == 6);
+        VERIFICAR(leer_uint(&r) == e->epoch);
+        VERIFICAR(leer_uint(&r) == ESFERA_CBOR_HUMEDAD);
+        VERIFICAR(leer_uint(&r) == e->humedad);
+        VERIFICAR(leer_uint(&r) == ESFERA_CBOR_TEMPERATURA);
+        VERIFICAR(leer_int(&r) == e->temperatura);
+        VERIFICAR(leer_uint(&r) == ESFERA_CBOR_BATERIA);
+        VERIFICAR(leer_uint(&r) == e->voltaje_mv);
+        VERIFICAR(leer_uint(&r) == ESFERA_CBOR_RIEGO);
+        VERIFICAR(leer_uint(&r) == e->riego);
+    }
+    VERIFICAR(!r.error && r.pos == len);
+}
+
+// ============================================================
+//   MEDICIÓN
+// ============================================================
+// El árbol cJSON que armaba esfera_manager_generate_json antes del streaming
+static char *data_cjson(void)
+{
+    cJSON *root = cJSON_CreateArray();
+    size_t cantidad = esfera_manager_snapshot_tomar();
+    for (size_t i = 0; i < cantidad; i++) {
+        const esfera_data_t *e = esfera_manager_snapshot_leer(i);
+        char mac[13];
+        char timestamp[20];
+        esfera_data_formatear(e, mac, timestamp);
+
+        cJSON *item = cJSON_CreateObject();
+        cJSON_AddStringToObject(item, "mac", mac);
+        cJSON_AddNumberToObject(item, "humedad", e->humedad / 100.0f);
+        cJSON_AddNumberToObject(item, "temperatura", e->temperatura / 100.0f);
+        cJSON_AddNumberToObject(item, "bateria", e->voltaje_mv / 1000.0f);
+        cJSON_AddNumberToObject(item, "riego", e->riego);
+        cJSON_AddStringToObject(item, "timestamp", timestamp);
+        cJSON_AddItemToArray(root, item);
+    }
+    char *json = cJSON_PrintUnformatted(root);
+    cJSON_Delete(root);
+    return json;
+}
+
+typedef enum { FORMATO_JSON, FORMATO_CJSON, FORMATO_CBOR, FORMATO_BLOQUES, FORMATOS } formato_t;
+
+static const char *const s_nombres[FORMATOS] = { "JSON streaming", "JSON cJSON", "CBOR", "bloques codec" };
+
+typedef struct {
+    size_t bytes;
+    double us;              // Mediana por codificación
+    size_t heap;            // Pico de heap durante la codificación
+} medida_t;
+
+static size_t codificar(formato_t f)
+{
+    size_t len = 0;
+    void *p = NULL;
+    switch (f) {
+    case FORMATO_JSON:
+        p = esfera_manager_generate_json();
+        len = p ? strlen(p) : 0;
+        break;
+    case FORMATO_CJSON:
+        p = data_cjson();
+        len = p ? strlen(p) : 0;
+        break;
+    case FORMATO_CBOR:
+        p = esfera_manager_generate_cbor(&len);
+        break;
+    default:
+        p = esfera_manager_generate_bloques(&len);
+        break;
+    }
+    VERIFICAR(p != NULL);
+    free(p);
+    return len;
+}
+
+static int comparar_double(const void *a, const void *b)
+{
+    double x = *(const double *)a, y = *(const double *)b;
+    return (x > y) - (x < y);
+}
+
+static medida_t medir(formato_t f, int repeticiones)
+{
+    medida_t m = { 0 };
+    double *t = malloc(repeticiones * sizeof(double));
+
+    host_heap_reiniciar_pico();
+    size_t base = host_heap_en_uso();
+    m.bytes = codificar(f);
+    m.heap = host_heap_pico() - base;
+
+    for (int i = 0; i < repeticiones; i++) {
+        int64_t t0 = esp_timer_get_time();
+        codificar(f);
+        t[i] = (double)(esp_timer_get_time() - t0);
+    }
+    qsort(t, repeticiones, sizeof(double), comparar_double);
+    m.us = t[repeticiones / 2];
+    free(t);
+    return m;
+}
+
+int main(int argc, char **argv)
+{
+    int repeticiones = 51;
+    int c;
+    while ((c = getopt(argc, argv, "r:")) != -1) {
+        if (c == 'r') repeticiones = atoi(optarg);
+        else {
+            fprintf(stderr, "uso: %s [-r repeticiones]\n", argv[0]);
+            return 2;
+        }
+    }
+    if (repeticiones < 1) repeticiones = 1;
+
+    setenv("TZ", "UTC0", 1);
+    tzset();
+    host_log_nivel = ESP_LOG_ERROR;
+    esfera_manager_init();
+
+    for (size_t e = 0; e < sizeof(s_escenarios) / sizeof(s_escenarios[0]); e++) {
+        const escenario_t *esc = &s_escenarios[e];
+        llenar(esc);
+        size_t cantidad = esfera_manager_snapshot_tomar();
+        VERIFICAR(cantidad == (size_t)(esc->esferas * esc->lecturas));
+
+        size_t len = 0;
+        uint8_t *cbor = esfera_manager_generate_cbor(&len);
+        VERIFICAR(cbor != NULL);
+        if (cbor) verificar_cbor(cbor, len, cantidad);
+        free(cbor);
+
+        printf("\n%d esferas x %d lecturas = %zu lecturas (%s)\n", esc->esferas, esc->lecturas, cantidad, esc->nombre);
+        printf("  %-16s %9s %9s %11s %12s\n", "formato", "bytes", "B/lectura", "us (p50)", "heap pico");
+        medida_t json = { 0 };
+        for (formato_t f = 0; f < FORMATOS; f++) {
+            medida_t m = medir(f, repeticiones);
+            if (f == FORMATO_JSON) json = m;
+            printf("  %-16s %9zu %9.1f %11.1f %12zu", s_nombres[f], m.bytes,
+                   (double)m.bytes / (double)cantidad, m.us, m.heap);
+            if (f != FORMATO_JSON && json.bytes) printf("   (%.0f%% del JSON)", 100.0 * m.bytes / json.bytes);
+            printf("\n");
+        }
+        esfera_manager_snapshot_liberar();
+    }
+    printf("\n");
+    return prueba_resultado("bench_cbor");
+}
@@ -0,0 +1,31 @@
+#pragma once
+
+#include <stdio.h>
+
+// Verificaciones de las pruebas de host: cada falla se informa y se cuenta,
+// y prueba_resultado() da el código de salida para ctest.
+
+static int s_fallas;
+
+#define VERIFICAR(cond) do {                                                \
+        if (!(cond)) {                                                      \
+            fprintf(stderr, "%s:%d: FALLA: %s\n", __FILE__, __LINE__, #cond); \
+            s_fallas++;                                                     \
+        }                                                                   \
+    } while (0)
+
+#define VERIFICAR_MSG(cond, ...) do {                                       \
+        if (!(cond)) {                                                      \
+            fprintf(stderr, "%s:%d: FALLA: %s: ", __FILE__, __LINE__, #cond); \
+            fprintf(stderr, __VA_ARGS__);                                   \
+            fputc('\n', stderr);                                            \
+            s_fallas++;                                                     \
+        }                                                                   \
+    } while (0)
+
+static inline int prueba_resultado(const char *nombre)
+{
+    if (s_fallas) fprintf(stderr, "%s: %d fallas\n", nombre, s_fallas);
+    else printf("%s: OK\n", nombre);
+    return s_fallas ? 1 : 0;
+}
@@ -0,0 +1,134 @@
+#include "host.h"
+#include <stdlib.h>
+#include <string.h>
+#include <stdatomic.h>
+#include <time.h>
+#include "esp_err.h"
+#include "esp_log.h"
+#include "esp_timer.h"
+#include "esp_system.h"
+#include "esp_heap_caps.h"
+#include "esp_random.h"
+#include "esp_partition.h"
+
+int host_log_nivel = ESP_LOG_WARN;
+
+const char *esp_err_to_name(esp_err_t err)
+{
+    switch (err) {
+    case ESP_OK:                    return "ESP_OK";
+    case ESP_FAIL:                  return "ESP_FAIL";
+    case ESP_ERR_NO_MEM:            return "ESP_ERR_NO_MEM";
+    case ESP_ERR_INVALID_ARG:       return "ESP_ERR_INVALID_ARG";
+    case ESP_ERR_INVALID_STATE:     return "ESP_ERR_INVALID_STATE";
+    case ESP_ERR_INVALID_SIZE:      return "ESP_ERR_INVALID_SIZE";
+    case ESP_ERR_NOT_FOUND:         return "ESP_ERR_NOT_FOUND";
+    case ESP_ERR_NOT_SUPPORTED:     return "ESP_ERR_NOT_SUPPORTED";
+    case ESP_ERR_TIMEOUT:           return "ESP_ERR_TIMEOUT";
+    case ESP_ERR_INVALID_RESPONSE:  return "ESP_ERR_INVALID_RESPONSE";
+    case ESP_ERR_INVALID_CRC:       return "ESP_ERR_INVALID_CRC";
+    case ESP_ERR_INVALID_VERSION:   return "ESP_ERR_INVALID_VERSION";
+    case ESP_ERR_NOT_FINISHED:      return "ESP_ERR_NOT_FINISHED";
+    case ESP_ERR_NVS_NOT_FOUND:     return "ESP_ERR_NVS_NOT_FOUND";
+    default:                        return "ERROR";
+    }
+}
+
+// ============================================================
+//   TIEMPO, AZAR Y HEAP
+// ============================================================
+int64_t esp_timer_get_time(void)
+{
+    static int64_t inicio;
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    int64_t ahora = (int64_t)ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+    if (inicio == 0) inicio = ahora - 1;
+    return ahora - inicio;
+}
+
+uint32_t esp_random(void)
+{
+    // xorshift32 compartido: no hace falta calidad criptográfica
+    static atomic_uint estado = 0x9E3779B9u;
+    uint32_t x = atomic_load(&estado), y;
+    do {
+        y = x;
+        y ^= y << 13;
+        y ^= y >> 17;
+        y ^= y << 5;
+    } while (!atomic_compare_exchange_weak(&estado, &x, y));
+    return y;
+}
+
+uint32_t esp_get_free_heap_size(void)
+{
+    size_t en_uso = host_heap_en_uso();
+    return en_uso < HOST_HEAP_BYTES ? (uint32_t)(HOST_HEAP_BYTES - en_uso) : 0;
+}
+
+uint32_t esp_get_minimum_free_heap_size(void)
+{
+    size_t pico = host_heap_pico();
+    return pico < HOST_HEAP_BYTES ? (uint32_t)(HOST_HEAP_BYTES - pico) : 0;
+}
+
+void *heap_caps_malloc(size_t tam, uint32_t caps)
+{
+    return malloc(tam);
+}
+
+void heap_caps_free(void *p)
+{
+    free(p);
+}
+
+// ============================================================
+//   PARTICIÓN EN RAM
+// ============================================================
+static esp_partition_t s_particion;
+static uint8_t *s_flash;
+
+const esp_partition_t *host_particion_crear(const char *label, uint32_t tam)
+{
+    free(s_flash);
+    s_flash = malloc(tam);
+    if (!s_flash) return NULL;
+    memset(s_flash, 0xFF, tam);
+
+    memset(&s_particion, 0, sizeof(s_particion));
+    s_particion.type = ESP_PARTITION_TYPE_DATA;
+    s_particion.size = tam;
+    s_particion.erase_size = 4096;
+    strncpy(s_particion.label, label, sizeof(s_particion.label) - 1);
+    return &s_particion;
+}
+
+const esp_partition_t *esp_partition_find_first(esp_partition_type_t tipo, esp_partition_subtype_t subtipo,
+                                                const char *label)
+{
+    if (!s_flash || (label && strcmp(label, s_particion.label) != 0)) return NULL;
+    return &s_particion;
+}
+
+esp_err_t esp_partition_read(const esp_partition_t *p, size_t offset, void *dst, size_t len)
+{
+    if (offset + len > p->size) return ESP_ERR_INVALID_SIZE;
+    memcpy(dst, s_flash + offset, len);
+    return ESP_OK;
+}
+
+esp_err_t esp_partition_write(const esp_partition_t *p, size_t offset, const void *src, size_t len)
+{
+    if (offset + len > p->size) return ESP_ERR_INVALID_SIZE;
+    const uint8_t *s = src;
+    for (size_t i = 0; i < len; i++) s_flash[offset + i] &= s[i];
+    return ESP_OK;
+}
+
+esp_err_t esp_partition_erase_range(const esp_partition_t *p, size_t offset, size_t len)
+{
+    if (offset % p->erase_size || len % p->erase_size || offset + len > p->size) return ESP_ERR_INVALID_ARG;
+    memset(s_flash + offset, 0xFF, len);
+    return ESP_OK;
+}
@@ -0,0 +1,22 @@
+#pragma once
+
+#include <stdio.h>
+#include "esp_err.h"
+
+// Niveles como esp_log_level_t. Por defecto solo advertencias y errores, para
+// que los benchmarks no midan printf; se cambia con host_log_nivel.
+enum { ESP_LOG_NONE, ESP_LOG_ERROR, ESP_LOG_WARN, ESP_LOG_INFO, ESP_LOG_DEBUG, ESP_LOG_VERBOSE };
+
+extern int host_log_nivel;
+
+#define HOST_LOG(nivel, letra, tag, formato, ...) do {                              \
+        if (host_log_nivel >= (nivel)) {                                            \
+            printf(letra " (%s) " formato "\n", tag, ##__VA_ARGS__);                \
+        }                                                                           \
+    } while (0)
+
+#define ESP_LOGE(tag, formato, ...) HOST_LOG(ESP_LOG_ERROR, "E", tag, formato, ##__VA_ARGS__)
+#define ESP_LOGW(tag, formato, ...) HOST_LOG(ESP_LOG_WARN, "W", tag, formato, ##__VA_ARGS__)
+#define ESP_LOGI(tag, formato, ...) HOST_LOG(ESP_LOG_INFO, "I", tag, formato, ##__VA_ARGS__)
+#define ESP_LOGD(tag, formato, ...) HOST_LOG(ESP_LOG_DEBUG, "D", tag, formato, ##__VA_ARGS__)
+#define ESP_LOGV(tag, formato, ...) HOST_LOG(ESP_LOG_VERBOSE, "V", tag, formato, ##__VA_ARGS__)
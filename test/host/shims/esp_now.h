@@ -0,0 +1,25 @@
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdbool.h>
+#include "esp_err.h"
+
+#define ESP_NOW_ETH_ALEN        6
+#define ESP_NOW_MAX_DATA_LEN    250
+#define ESP_NOW_MAX_DATA_LEN_V2 1470
+
+typedef struct {
+    signed rssi : 8;
+} wifi_pkt_rx_ctrl_t;
+
+typedef struct {
+    uint8_t *src_addr;
+    uint8_t *des_addr;
+    wifi_pkt_rx_ctrl_t *rx_ctrl;
+} esp_now_recv_info_t;
+
+typedef enum {
+    ESP_NOW_SEND_SUCCESS = 0,
+    ESP_NOW_SEND_FAIL,
+} esp_now_send_status_t;
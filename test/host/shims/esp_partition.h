@@ -0,0 +1,30 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+#include "esp_err.h"
+
+typedef enum {
+    ESP_PARTITION_TYPE_APP = 0,
+    ESP_PARTITION_TYPE_DATA = 1,
+} esp_partition_type_t;
+
+typedef int esp_partition_subtype_t;
+#define ESP_PARTITION_SUBTYPE_ANY 0xff
+
+typedef struct {
+    esp_partition_type_t type;
+    esp_partition_subtype_t subtype;
+    uint32_t address;
+    uint32_t size;
+    uint32_t erase_size;
+    char label[17];
+} esp_partition_t;
+
+// Partición en RAM con semántica NOR (escribir solo baja bits). No existe
+// hasta que un programa la crea con host_particion_crear().
+const esp_partition_t *esp_partition_find_first(esp_partition_type_t tipo, esp_partition_subtype_t subtipo,
+                                                const char *label);
+esp_err_t esp_partition_read(const esp_partition_t *p, size_t offset, void *dst, size_t len);
+esp_err_t esp_partition_write(const esp_partition_t *p, size_t offset, const void *src, size_t len);
+esp_err_t esp_partition_erase_range(const esp_partition_t *p, size_t offset, size_t len);
@@ -0,0 +1,9 @@
+#pragma once
+
+#include <stdint.h>
+#include "esp_err.h"
+
+// Heap libre sobre un total nominal de HOST_HEAP_BYTES, según lo que se reservó
+// con malloc en el proceso (ver host.h)
+uint32_t esp_get_free_heap_size(void);
+uint32_t esp_get_minimum_free_heap_size(void);
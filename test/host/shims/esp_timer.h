@@ -0,0 +1,9 @@
+#pragma once
+
+#include <stdint.h>
+#include "esp_err.h"
+
+/**
+ * @brief Microsegundos de CLOCK_MONOTONIC desde el primer uso.
+ */
+int64_t esp_timer_get_time(void);
@@ -0,0 +1,227 @@
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "freertos/queue.h"
+#include "freertos/semphr.h"
+#include <stdlib.h>
+#include <string.h>
+#include <stdbool.h>
+#include <errno.h>
+#include <sched.h>
+#include <time.h>
+#include <unistd.h>
+
+struct tskTaskControlBlock {
+    pthread_t hilo;
+    TaskFunction_t funcion;
+    void *arg;
+    pthread_mutex_t mutex;
+    pthread_cond_t cond;
+    uint32_t notificaciones;
+};
+
+struct QueueDefinition {
+    pthread_mutex_t mutex;
+    pthread_cond_t con_items;
+    pthread_cond_t con_lugar;
+    uint8_t *items;
+    size_t tam_item;
+    size_t largo;
+    size_t n;
+    size_t cabeza;
+};
+
+static __thread TaskHandle_t s_actual;
+
+// Plazo absoluto para pthread_cond_timedwait, o false si la espera es infinita
+static bool plazo(TickType_t espera, struct timespec *ts)
+{
+    if (espera == portMAX_DELAY) return false;
+    clock_gettime(CLOCK_REALTIME, ts);
+    ts->tv_sec += espera / 1000;
+    ts->tv_nsec += (long)(espera % 1000) * 1000000L;
+    if (ts->tv_nsec >= 1000000000L) {
+        ts->tv_sec++;
+        ts->tv_nsec -= 1000000000L;
+    }
+    return true;
+}
+
+// Espera la condición; false si venció el plazo
+static bool esperar(pthread_cond_t *cond, pthread_mutex_t *mutex, bool con_plazo, const struct timespec *ts)
+{
+    if (!con_plazo) return pthread_cond_wait(cond, mutex) == 0;
+    return pthread_cond_timedwait(cond, mutex, ts) != ETIMEDOUT;
+}
+
+// ============================================================
+//   TAREAS
+// ============================================================
+static void *trampolin(void *p)
+{
+    TaskHandle_t t = p;
+    s_actual = t;
+    t->funcion(t->arg);
+    return NULL;
+}
+
+BaseType_t xTaskCreate(TaskFunction_t funcion, const char *nombre, uint32_t stack, void *arg,
+                       UBaseType_t prioridad, TaskHandle_t *handle)
+{
+    TaskHandle_t t = calloc(1, sizeof(*t));
+    if (!t) return pdFAIL;
+    t->funcion = funcion;
+    t->arg = arg;
+    pthread_mutex_init(&t->mutex, NULL);
+    pthread_cond_init(&t->cond, NULL);
+    if (handle) *handle = t;
+
+    if (pthread_create(&t->hilo, NULL, trampolin, t) != 0) {
+        if (handle) *handle = NULL;
+        free(t);
+        return pdFAIL;
+    }
+    pthread_detach(t->hilo);
+    return pdPASS;
+}
+
+BaseType_t xTaskCreatePinnedToCore(TaskFunction_t funcion, const char *nombre, uint32_t stack, void *arg,
+                                   UBaseType_t prioridad, TaskHandle_t *handle, BaseType_t nucleo)
+{
+    return xTaskCreate(funcion, nombre, stack, arg, prioridad, handle);
+}
+
+void vTaskDelay(TickType_t ticks)
+{
+    if (ticks == 0) sched_yield();
+    else usleep((useconds_t)ticks * 1000);
+}
+
+TickType_t xTaskGetTickCount(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (TickType_t)(ts.tv_sec * 1000 + ts.tv_nsec / 1000000);
+}
+
+void taskYIELD(void)
+{
+    sched_yield();
+}
+
+BaseType_t xTaskNotifyGive(TaskHandle_t t)
+{
+    pthread_mutex_lock(&t->mutex);
+    t->notificaciones++;
+    pthread_cond_signal(&t->cond);
+    pthread_mutex_unlock(&t->mutex);
+    return pdPASS;
+}
+
+uint32_t ulTaskNotifyTake(BaseType_t limpiar, TickType_t espera)
+{
+    TaskHandle_t t = s_actual;
+    if (!t) return 0;
+
+    struct timespec ts;
+    bool con_plazo = plazo(espera, &ts);
+    pthread_mutex_lock(&t->mutex);
+    while (t->notificaciones == 0 && espera != 0) {
+        if (!esperar(&t->cond, &t->mutex, con_plazo, &ts)) break;
+    }
+    uint32_t valor = t->notificaciones;
+    if (valor) t->notificaciones = limpiar ? 0 : valor - 1;
+    pthread_mutex_unlock(&t->mutex);
+    return valor;
+}
+
+// ============================================================
+//   COLAS Y SEMÁFOROS
+// ============================================================
+QueueHandle_t xQueueCreate(UBaseType_t largo, UBaseType_t tam_item)
+{
+    QueueHandle_t q = calloc(1, sizeof(*q));
+    if (!q) return NULL;
+    q->items = tam_item ? malloc((size_t)largo * tam_item) : NULL;
+    if (tam_item && !q->items) {
+        free(q);
+        return NULL;
+    }
+    q->tam_item = tam_item;
+    q->largo = largo;
+    pthread_mutex_init(&q->mutex, NULL);
+    pthread_cond_init(&q->con_items, NULL);
+    pthread_cond_init(&q->con_lugar, NULL);
+    return q;
+}
+
+void vQueueDelete(QueueHandle_t q)
+{
+    if (!q) return;
+    pthread_mutex_destroy(&q->mutex);
+    pthread_cond_destroy(&q->con_items);
+    pthread_cond_destroy(&q->con_lugar);
+    free(q->items);
+    free(q);
+}
+
+BaseType_t xQueueSend(QueueHandle_t q, const void *item, TickType_t espera)
+{
+    struct timespec ts;
+    bool con_plazo = plazo(espera, &ts);
+    pthread_mutex_lock(&q->mutex);
+    while (q->n == q->largo) {
+        if (espera == 0 || !esperar(&q->con_lugar, &q->mutex, con_plazo, &ts)) {
+            pthread_mutex_unlock(&q->mutex);
+            return pdFALSE;
+        }
+    }
+    if (q->tam_item) {
+        memcpy(&q->items[((q->cabeza + q->n) % q->largo) * q->tam_item], item, q->tam_item);
+    }
+    q->n++;
+    pthread_cond_signal(&q->con_items);
+    pthread_mutex_unlock(&q->mutex);
+    return pdTRUE;
+}
+
+BaseType_t xQueueReceive(QueueHandle_t q, void *item, TickType_t espera)
+{
+    struct timespec ts;
+    bool con_plazo = plazo(espera, &ts);
+    pthread_mutex_lock(&q->mutex);
+    while (q->n == 0) {
+        if (espera == 0 || !esperar(&q->con_items, &q->mutex, con_plazo, &ts)) {
+            pthread_mutex_unlock(&q->mutex);
+            return pdFALSE;
+        }
+    }
+    if (q->tam_item) {
+        memcpy(item, &q->items[q->cabeza * q->tam_item], q->tam_item);
+        q->cabeza = (q->cabeza + 1) % q->largo;
+    }
+    q->n--;
+    pthread_cond_signal(&q->con_lugar);
+    pthread_mutex_unlock(&q->mutex);
+    return pdTRUE;
+}
+
+UBaseType_t uxQueueMessagesWaiting(QueueHandle_t q)
+{
+    pthread_mutex_lock(&q->mutex);
+    UBaseType_t n = (UBaseType_t)q->n;
+    pthread_mutex_unlock(&q->mutex);
+    return n;
+}
+
+SemaphoreHandle_t xSemaphoreCreateBinary(void)
+{
+    return xQueueCreate(1, 0);
+}
+
+SemaphoreHandle_t xSemaphoreCreateMutex(void)
+{
+    // Un mutex es un semáforo binario que arranca disponible
+    SemaphoreHandle_t s = xQueueCreate(1, 0);
+    if (s) xSemaphoreGive(s);
+    return s;
+}
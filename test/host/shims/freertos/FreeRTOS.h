@@ -0,0 +1,30 @@
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+#include <pthread.h>
+
+// FreeRTOS sobre hilos POSIX: tick de 1 ms, prioridades ignoradas
+typedef int BaseType_t;
+typedef unsigned UBaseType_t;
+typedef uint32_t TickType_t;
+
+#define pdTRUE              1
+#define pdFALSE             0
+#define pdPASS              1
+#define pdFAIL              0
+#define portMAX_DELAY       ((TickType_t)0xffffffffUL)
+#define portTICK_PERIOD_MS  1
+#define pdMS_TO_TICKS(ms)   ((TickType_t)(ms))
+#define tskNO_AFFINITY      0x7fffffff
+
+// Las secciones críticas de ESP-IDF son spinlocks entre núcleos; acá, un mutex
+typedef struct {
+    pthread_mutex_t mutex;
+} portMUX_TYPE;
+
+#define portMUX_INITIALIZER_UNLOCKED { PTHREAD_MUTEX_INITIALIZER }
+#define taskENTER_CRITICAL(mux)     pthread_mutex_lock(&(mux)->mutex)
+#define taskEXIT_CRITICAL(mux)      pthread_mutex_unlock(&(mux)->mutex)
+#define portENTER_CRITICAL(mux)     taskENTER_CRITICAL(mux)
+#define portEXIT_CRITICAL(mux)      taskEXIT_CRITICAL(mux)
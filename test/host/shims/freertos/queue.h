@@ -0,0 +1,13 @@
+#pragma once
+
+#include "FreeRTOS.h"
+
+typedef struct QueueDefinition *QueueHandle_t;
+
+QueueHandle_t xQueueCreate(UBaseType_t largo, UBaseType_t tam_item);
+void vQueueDelete(QueueHandle_t cola);
+BaseType_t xQueueSend(QueueHandle_t cola, const void *item, TickType_t espera);
+BaseType_t xQueueReceive(QueueHandle_t cola, void *item, TickType_t espera);
+UBaseType_t uxQueueMessagesWaiting(QueueHandle_t cola);
+
+#define xQueueSendToBack(cola, item, espera) xQueueSend(cola, item, espera)
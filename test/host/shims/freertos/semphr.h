@@ -0,0 +1,13 @@
+#pragma once
+
+#include "queue.h"
+
+// Semáforos como colas de items vacíos, igual que en FreeRTOS
+typedef QueueHandle_t SemaphoreHandle_t;
+
+SemaphoreHandle_t xSemaphoreCreateMutex(void);
+SemaphoreHandle_t xSemaphoreCreateBinary(void);
+
+#define xSemaphoreTake(sem, espera) xQueueReceive(sem, NULL, espera)
+#define xSemaphoreGive(sem)         xQueueSend(sem, NULL, 0)
+#define vSemaphoreDelete(sem)       vQueueDelete(sem)
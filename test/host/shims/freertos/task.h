@@ -0,0 +1,17 @@
+#pragma once
+
+#include "FreeRTOS.h"
+
+typedef struct tskTaskControlBlock *TaskHandle_t;
+typedef void (*TaskFunction_t)(void *arg);
+
+// Cada tarea es un hilo desacoplado; el stack y la prioridad no se usan
+BaseType_t xTaskCreate(TaskFunction_t funcion, const char *nombre, uint32_t stack, void *arg,
+                       UBaseType_t prioridad, TaskHandle_t *handle);
+BaseType_t xTaskCreatePinnedToCore(TaskFunction_t funcion, const char *nombre, uint32_t stack, void *arg,
+                                   UBaseType_t prioridad, TaskHandle_t *handle, BaseType_t nucleo);
+void vTaskDelay(TickType_t ticks);
+TickType_t xTaskGetTickCount(void);
+BaseType_t xTaskNotifyGive(TaskHandle_t tarea);
+uint32_t ulTaskNotifyTake(BaseType_t limpiar, TickType_t espera);
+void taskYIELD(void);
@@ -0,0 +1,93 @@
+// Contabilidad del heap del proceso: envuelve el malloc de glibc para medir el
+// pico de memoria reservada (cJSON, buffers de respuesta, etc.) sin instrumentar
+// el código de los componentes.
+#include "host.h"
+#include <malloc.h>
+#include <stdatomic.h>
+#include <stdlib.h>
+#include <errno.h>
+
+extern void *__libc_malloc(size_t tam);
+extern void *__libc_calloc(size_t n, size_t tam);
+extern void *__libc_realloc(void *p, size_t tam);
+extern void *__libc_memalign(size_t alineacion, size_t tam);
+extern void __libc_free(void *p);
+
+static atomic_size_t s_en_uso;
+static atomic_size_t s_pico;
+
+static void sumar(void *p)
+{
+    if (!p) return;
+    size_t en_uso = atomic_fetch_add(&s_en_uso, malloc_usable_size(p)) + malloc_usable_size(p);
+    size_t pico = atomic_load(&s_pico);
+    while (en_uso > pico && !atomic_compare_exchange_weak(&s_pico, &pico, en_uso)) {
+    }
+}
+
+static void restar(void *p)
+{
+    if (p) atomic_fetch_sub(&s_en_uso, malloc_usable_size(p));
+}
+
+void *malloc(size_t tam)
+{
+    void *p = __libc_malloc(tam);
+    sumar(p);
+    return p;
+}
+
+void *calloc(size_t n, size_t tam)
+{
+    void *p = __libc_calloc(n, tam);
+    sumar(p);
+    return p;
+}
+
+void *realloc(void *p, size_t tam)
+{
+    restar(p);
+    void *nuevo = __libc_realloc(p, tam);
+    // Si falla, el bloque original sigue reservado
+    sumar(nuevo ? nuevo : (tam ? p : NULL));
+    return nuevo;
+}
+
+void *memalign(size_t alineacion, size_t tam)
+{
+    void *p = __libc_memalign(alineacion, tam);
+    sumar(p);
+    return p;
+}
+
+void *aligned_alloc(size_t alineacion, size_t tam)
+{
+    return memalign(alineacion, tam);
+}
+
+int posix_memalign(void **p, size_t alineacion, size_t tam)
+{
+    *p = memalign(alineacion, tam);
+    return *p ? 0 : ENOMEM;
+}
+
+void free(void *p)
+{
+    restar(p);
+    __libc_free(p);
+}
+
+size_t host_heap_en_uso(void)
+{
+    return atomic_load(&s_en_uso);
+}
+
+size_t host_heap_pico(void)
+{
+    return atomic_load(&s_pico);
+}
+
+void host_heap_reiniciar_pico(void)
+{
+    atomic_store(&s_pico, atomic_load(&s_en_uso));
+}
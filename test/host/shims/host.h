@@ -0,0 +1,26 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+#include "esp_partition.h"
+
+// Servicios de los shims que solo usan los programas de host
+
+#define HOST_HEAP_BYTES     (320 * 1024)    // Heap nominal, como la DRAM libre de un ESP32 con Wi-Fi
+
+/**
+ * @brief Bytes reservados con malloc en este momento y máximo desde el último reinicio del pico.
+ */
+size_t host_heap_en_uso(void);
+size_t host_heap_pico(void);
+void host_heap_reiniciar_pico(void);
+
+/**
+ * @brief Crea (borrada) la partición de datos que devolverá esp_partition_find_first.
+ */
+const esp_partition_t *host_particion_crear(const char *label, uint32_t tam);
+
+/**
+ * @brief Cantidad de nvs_commit desde el arranque.
+ */
+uint32_t host_nvs_commits(void);
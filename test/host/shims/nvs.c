@@ -0,0 +1,192 @@
+#include "host.h"
+#include <stdlib.h>
+#include <stdbool.h>
+#include <string.h>
+#include <pthread.h>
+#include "nvs_flash.h"
+
+#define NVS_CLAVES  512
+
+typedef struct {
+    char ns[16];
+    char clave[16];
+    nvs_type_t tipo;
+    size_t len;
+    uint8_t *valor;
+} entrada_t;
+
+// Los handles son índices de namespace: 1 + posición en s_ns
+static entrada_t s_entradas[NVS_CLAVES];
+static char s_ns[16][16];
+static int s_n_ns;
+static uint32_t s_commits;
+static pthread_mutex_t s_mutex = PTHREAD_MUTEX_INITIALIZER;
+
+static entrada_t *buscar(nvs_handle_t handle, const char *clave, bool crear)
+{
+    const char *ns = s_ns[handle - 1];
+    entrada_t *libre = NULL;
+    for (int i = 0; i < NVS_CLAVES; i++) {
+        entrada_t *e = &s_entradas[i];
+        if (!e->valor) {
+            if (!libre) libre = e;
+        } else if (strcmp(e->ns, ns) == 0 && strcmp(e->clave, clave) == 0) {
+            return e;
+        }
+    }
+    if (!crear || !libre) return NULL;
+    strncpy(libre->ns, ns, sizeof(libre->ns) - 1);
+    strncpy(libre->clave, clave, sizeof(libre->clave) - 1);
+    return libre;
+}
+
+static esp_err_t escribir(nvs_handle_t handle, const char *clave, nvs_type_t tipo, const void *valor, size_t len)
+{
+    pthread_mutex_lock(&s_mutex);
+    entrada_t *e = buscar(handle, clave, true);
+    uint8_t *copia = e ? malloc(len ? len : 1) : NULL;
+    if (!copia) {
+        pthread_mutex_unlock(&s_mutex);
+        return ESP_ERR_NO_MEM;
+    }
+    memcpy(copia, valor, len);
+    free(e->valor);
+    e->valor = copia;
+    e->len = len;
+    e->tipo = tipo;
+    pthread_mutex_unlock(&s_mutex);
+    return ESP_OK;
+}
+
+static esp_err_t leer(nvs_handle_t handle, const char *clave, nvs_type_t tipo, void *valor, size_t *len)
+{
+    pthread_mutex_lock(&s_mutex);
+    entrada_t *e = buscar(handle, clave, false);
+    esp_err_t err = ESP_OK;
+    if (!e || e->tipo != tipo) {
+        err = ESP_ERR_NVS_NOT_FOUND;
+    } else if (valor && *len < e->len) {
+        err = ESP_ERR_INVALID_SIZE;
+    } else {
+        if (valor) memcpy(valor, e->valor, e->len);
+        *len = e->len;
+    }
+    pthread_mutex_unlock(&s_mutex);
+    return err;
+}
+
+esp_err_t nvs_open(const char *ns, nvs_open_mode_t modo, nvs_handle_t *handle)
+{
+    pthread_mutex_lock(&s_mutex);
+    int i = 0;
+    while (i < s_n_ns && strcmp(s_ns[i], ns) != 0) i++;
+    if (i == s_n_ns) {
+        if (s_n_ns == 16) {
+            pthread_mutex_unlock(&s_mutex);
+            return ESP_ERR_NO_MEM;
+        }
+        strncpy(s_ns[s_n_ns++], ns, 15);
+    }
+    pthread_mutex_unlock(&s_mutex);
+    *handle = (nvs_handle_t)(i + 1);
+    return ESP_OK;
+}
+
+void nvs_close(nvs_handle_t handle)
+{
+}
+
+esp_err_t nvs_get_u32(nvs_handle_t handle, const char *clave, uint32_t *valor)
+{
+    size_t len = sizeof(*valor);
+    return leer(handle, clave, NVS_TYPE_U32, valor, &len);
+}
+
+esp_err_t nvs_set_u32(nvs_handle_t handle, const char *clave, uint32_t valor)
+{
+    return escribir(handle, clave, NVS_TYPE_U32, &valor, sizeof(valor));
+}
+
+esp_err_t nvs_get_str(nvs_handle_t handle, const char *clave, char *valor, size_t *len)
+{
+    return leer(handle, clave, NVS_TYPE_STR, valor, len);
+}
+
+esp_err_t nvs_set_str(nvs_handle_t handle, const char *clave, const char *valor)
+{
+    return escribir(handle, clave, NVS_TYPE_STR, valor, strlen(valor) + 1);
+}
+
+esp_err_t nvs_get_blob(nvs_handle_t handle, const char *clave, void *valor, size_t *len)
+{
+    return leer(handle, clave, NVS_TYPE_BLOB, valor, len);
+}
+
+esp_err_t nvs_set_blob(nvs_handle_t handle, const char *clave, const void *valor, size_t len)
+{
+    return escribir(handle, clave, NVS_TYPE_BLOB, valor, len);
+}
+
+esp_err_t nvs_erase_key(nvs_handle_t handle, const char *clave)
+{
+    pthread_mutex_lock(&s_mutex);
+    entrada_t *e = buscar(handle, clave, false);
+    if (e) {
+        free(e->valor);
+        memset(e, 0, sizeof(*e));
+    }
+    pthread_mutex_unlock(&s_mutex);
+    return e ? ESP_OK : ESP_ERR_NVS_NOT_FOUND;
+}
+
+esp_err_t nvs_erase_all(nvs_handle_t handle)
+{
+    pthread_mutex_lock(&s_mutex);
+    for (int i = 0; i < NVS_CLAVES; i++) {
+        entrada_t *e = &s_entradas[i];
+        if (e->valor && strcmp(e->ns, s_ns[handle - 1]) == 0) {
+            free(e->valor);
+            memset(e, 0, sizeof(*e));
+        }
+    }
+    pthread_mutex_unlock(&s_mutex);
+    return ESP_OK;
+}
+
+esp_err_t nvs_commit(nvs_handle_t handle)
+{
+    pthread_mutex_lock(&s_mutex);
+    s_commits++;
+    pthread_mutex_unlock(&s_mutex);
+    return ESP_OK;
+}
+
+uint32_t host_nvs_commits(void)
+{
+    pthread_mutex_lock(&s_mutex);
+    uint32_t n = s_commits;
+    pthread_mutex_unlock(&s_mutex);
+    return n;
+}
+
+// Los programas de host arrancan con NVS vacío: no hace falta iterar
+esp_err_t nvs_entry_find(const char *particion, const char *ns, nvs_type_t tipo, nvs_iterator_t *it)
+{
+    *it = NULL;
+    return ESP_ERR_NVS_NOT_FOUND;
+}
+
+esp_err_t nvs_entry_next(nvs_iterator_t *it)
+{
+    *it = NULL;
+    return ESP_ERR_NVS_NOT_FOUND;
+}
+
+esp_err_t nvs_entry_info(nvs_iterator_t it, nvs_entry_info_t *info)
+{
+    return ESP_ERR_INVALID_ARG;
+}
+
+void nvs_release_iterator(nvs_iterator_t it)
+{
+}
@@ -0,0 +1,35 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+#include "esp_err.h"
+
+typedef uint32_t nvs_handle_t;
+typedef enum { NVS_READONLY, NVS_READWRITE } nvs_open_mode_t;
+typedef enum { NVS_TYPE_U32 = 0x04, NVS_TYPE_STR = 0x21, NVS_TYPE_BLOB = 0x42, NVS_TYPE_ANY = 0xff } nvs_type_t;
+
+typedef struct {
+    char namespace_name[16];
+    char key[16];
+    nvs_type_t type;
+} nvs_entry_info_t;
+
+typedef struct nvs_opaque_iterator_t *nvs_iterator_t;
+
+// NVS en memoria, compartido por todo el proceso: claves por namespace, sin
+// persistencia. Cada nvs_commit se cuenta (ver host.h).
+esp_err_t nvs_open(const char *ns, nvs_open_mode_t modo, nvs_handle_t *handle);
+void nvs_close(nvs_handle_t handle);
+esp_err_t nvs_get_u32(nvs_handle_t handle, const char *clave, uint32_t *valor);
+esp_err_t nvs_set_u32(nvs_handle_t handle, const char *clave, uint32_t valor);
+esp_err_t nvs_get_str(nvs_handle_t handle, const char *clave, char *valor, size_t *len);
+esp_err_t nvs_set_str(nvs_handle_t handle, const char *clave, const char *valor);
+esp_err_t nvs_get_blob(nvs_handle_t handle, const char *clave, void *valor, size_t *len);
+esp_err_t nvs_set_blob(nvs_handle_t handle, const char *clave, const void *valor, size_t len);
+esp_err_t nvs_erase_key(nvs_handle_t handle, const char *clave);
+esp_err_t nvs_erase_all(nvs_handle_t handle);
+esp_err_t nvs_commit(nvs_handle_t handle);
+esp_err_t nvs_entry_find(const char *particion, const char *ns, nvs_type_t tipo, nvs_iterator_t *it);
+esp_err_t nvs_entry_next(nvs_iterator_t *it);
+esp_err_t nvs_entry_info(nvs_iterator_t it, nvs_entry_info_t *info);
+void nvs_release_iterator(nvs_iterator_t it);
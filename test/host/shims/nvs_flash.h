@@ -0,0 +1,5 @@
+#pragma once
+
+#include "nvs.h"
+
+#define NVS_DEFAULT_PART_NAME "nvs"
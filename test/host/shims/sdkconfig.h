@@ -0,0 +1,10 @@
+#pragma once
+
+// Configuración fija de los programas de host. Sigue los valores por defecto
+// de los Kconfig salvo la capacidad, que se agranda para flotas de 1000 esferas.
+#define CONFIG_ESFERA_BUFFER_CAPACIDAD      1024
+#define CONFIG_ESFERA_BUFFER_SOBRESCRIBIR   1
+#define CONFIG_ESFERA_STATS_VENTANA_S       3600
+#define CONFIG_ESFERA_STATS_EWMA_SHIFT      3
+#define CONFIG_ESPNOW_RATELIMIT_TASA_MIN    30
+#define CONFIG_ESPNOW_RATELIMIT_RAFAGA      10
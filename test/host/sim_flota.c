@@ -0,0 +1,478 @@
+// Simulador de una flota de esferas contra la ruta real de ingesta del hub:
+// espnow_ingest_push (como el callback ESP-NOW) -> tarea de ingesta ->
+// esfera_frame / esfera_registry / esfera_seq -> esfera_manager, con un
+// publicador que vacía el buffer como los pedidos "Data".
+//
+//   sim_flota [-n esferas] [-i intervalo_ms] [-j jitter_%] [-d duplicados_%]
+//             [-m malformadas_%] [-f texto|v1|v2|v3|mixto] [-k muestras_v3]
+//             [-p publicacion_ms] [-t segundos] [-s semilla] [-c]
+//
+// Informa tramas/s, latencia de ingesta p50/p99 (exacta, además del histograma
+// de espnow_ingest), pico de heap y descartes. Con -c verifica que no se pierda
+// ninguna lectura y que los descartes sean los esperados (para ctest).
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdbool.h>
+#include <stdatomic.h>
+#include <inttypes.h>
+#include <getopt.h>
+#include <pthread.h>
+#include <unistd.h>
+#include "host.h"
+#include "esp_log.h"
+#include "esp_timer.h"
+#include "esfera_frame.h"
+#include "esfera_log.h"
+#include "esfera_manager.h"
+#include "esfera_registry.h"
+#include "esfera_seq.h"
+#include "espnow_ingest.h"
+#include "espnow_ratelimit.h"
+
+#define MAX_ESFERAS     1000
+#define MAX_LATENCIAS   (1 << 21)
+
+typedef enum { FORMATO_TEXTO, FORMATO_V1, FORMATO_V2, FORMATO_V3, FORMATO_MIXTO } formato_t;
+
+typedef struct {
+    int esferas;
+    int intervalo_ms;
+    int jitter;
+    int duplicados;
+    int malformadas;
+    formato_t formato;
+    int muestras_v3;
+    int publicacion_ms;
+    int segundos;
+    uint32_t semilla;
+    bool verificar;
+} opciones_t;
+
+typedef struct {
+    uint8_t mac[ESP_NOW_ETH_ALEN];
+    formato_t formato;
+    uint16_t seq;
+    int64_t proximo_us;
+    uint16_t humedad;
+    int16_t temperatura;
+    uint16_t bateria_mv;
+    uint8_t riego;
+} esfera_sim_t;
+
+static opciones_t s_op = {
+    .esferas = 100,
+    .intervalo_ms = 5000,
+    .jitter = 10,
+    .duplicados = 2,
+    .malformadas = 1,
+    .formato = FORMATO_MIXTO,
+    .muestras_v3 = 4,
+    .publicacion_ms = 1000,
+    .segundos = 5,
+    .semilla = 1,
+};
+
+static esfera_sim_t s_esferas[MAX_ESFERAS];
+static uint32_t s_azar;
+
+// Inyectado por el productor
+static uint64_t s_tramas;
+static uint64_t s_lecturas_enviadas;
+static uint64_t s_inyectadas_dup;
+static uint64_t s_inyectadas_dup_detectables;
+static uint64_t s_inyectadas_malas;
+
+// Contado por la tarea de ingesta
+static uint64_t s_invalidas;
+static uint64_t s_duplicadas;
+static uint64_t s_agregadas;
+static uint64_t s_sin_registro;
+static uint32_t *s_latencias;
+static size_t s_n_latencias;
+
+// Publicador
+static atomic_bool s_fin_publicador;
+static atomic_bool s_publicador_listo;
+static uint64_t s_publicadas;
+static uint64_t s_publicaciones;
+
+static uint32_t azar(void)
+{
+    s_azar ^= s_azar << 13;
+    s_azar ^= s_azar >> 17;
+    s_azar ^= s_azar << 5;
+    return s_azar;
+}
+
+static bool con_probabilidad(int por_ciento)
+{
+    return (int)(azar() % 100) < por_ciento;
+}
+
+static int64_t proximo_envio(int64_t desde)
+{
+    int64_t base = (int64_t)s_op.intervalo_ms * 1000;
+    int64_t jitter = base * s_op.jitter / 100;
+    int64_t desvio = jitter ? (int64_t)(azar() % (uint32_t)(2 * jitter + 1)) - jitter : 0;
+    return desde + base + desvio;
+}
+
+// ============================================================
+//   TRAMAS
+// ============================================================
+static void avanzar_medicion(esfera_sim_t *e)
+{
+    // Camina al azar como una medición real que cambia despacio
+    e->humedad = (uint16_t)(e->humedad + (int)(azar() % 21) - 10);
+    e->temperatura = (int16_t)(e->temperatura + (int)(azar() % 11) - 5);
+    if (e->bateria_mv > 3300 && azar() % 8 == 0) e->bateria_mv--;
+    if (azar() % 16 == 0) e->riego ^= 1;
+}
+
+static size_t armar_texto(const esfera_sim_t *e, uint8_t *buf, size_t cap)
+{
+    int n = snprintf((char *)buf, cap, "%.2f,%.2f,%.3f,%u %02X%02X%02X%02X%02X%02X",
+                     e->humedad / 100.0, e->temperatura / 100.0, e->bateria_mv / 1000.0, e->riego,
+                     e->mac[0], e->mac[1], e->mac[2], e->mac[3], e->mac[4], e->mac[5]);
+    return (size_t)n;
+}
+
+static size_t armar_v1_v2(esfera_sim_t *e, uint8_t *buf)
+{
+    if (e->formato == FORMATO_V1) {
+        esfera_frame_v1_t t = {
+            .version = ESFERA_FRAME_V1, .seq = e->seq++, .humedad = e->humedad,
+            .temperatura = e->temperatura, .bateria_mv = e->bateria_mv, .riego = e->riego,
+        };
+        t.crc = esfera_frame_crc16((const uint8_t *)&t, offsetof(esfera_frame_v1_t, crc));
+        memcpy(buf, &t, sizeof(t));
+        return sizeof(t);
+    }
+    esfera_frame_v2_t t = {
+        .version = ESFERA_FRAME_V2, .seq = e->seq++, .humedad = e->humedad,
+        .temperatura = e->temperatura, .bateria_mv = e->bateria_mv, .riego = e->riego, .cfg_version = 1,
+    };
+    t.crc = esfera_frame_crc16((const uint8_t *)&t, offsetof(esfera_frame_v2_t, crc));
+    memcpy(buf, &t, sizeof(t));
+    return sizeof(t);
+}
+
+// v3: las muestras se tomaron a lo largo del intervalo y viajan juntas
+static size_t armar_v3(esfera_sim_t *e, uint8_t *buf, int muestras)
+{
+    esfera_frame_v3_cab_t cab = {
+        .version = ESFERA_FRAME_V3, .seq = e->seq, .cfg_version = 1, .n_muestras = (uint8_t)muestras,
+    };
+    memcpy(buf, &cab, sizeof(cab));
+    size_t pos = sizeof(cab);
+    int paso_s = s_op.intervalo_ms / 1000 / muestras;
+    for (int i = 0; i < muestras; i++) {
+        if (i > 0) avanzar_medicion(e);
+        esfera_frame_v3_muestra_t m = {
+            .edad_s = (uint16_t)((muestras - 1 - i) * paso_s), .humedad = e->humedad,
+            .temperatura = e->temperatura, .bateria_mv = e->bateria_mv, .riego = e->riego,
+        };
+        memcpy(&buf[pos], &m, sizeof(m));
+        pos += sizeof(m);
+    }
+    e->seq = (uint16_t)(e->seq + muestras);
+    uint16_t crc = esfera_frame_crc16(buf, pos);
+    memcpy(&buf[pos], &crc, sizeof(crc));
+    return pos + sizeof(crc);
+}
+
+// Una trama corrupta que el hub debe rechazar siempre: la texto pierde la MAC,
+// la binaria cambia un byte después de la versión (el CRC-16 lo detecta)
+static size_t corromper(const esfera_sim_t *e, uint8_t *buf, size_t len)
+{
+    if (e->formato == FORMATO_TEXTO) return len / 2;
+    buf[1 + azar() % (len - 1)] ^= 0x5A;
+    return len;
+}
+
+static void enviar(esfera_sim_t *e, const uint8_t *data, size_t len)
+{
+    wifi_pkt_rx_ctrl_t rx = { .rssi = -40 - (int)(azar() % 50) };
+    esp_now_recv_info_t info = { .src_addr = e->mac, .rx_ctrl = &rx };
+    espnow_ingest_push(&info, data, (int)len);
+    s_tramas++;
+}
+
+static void transmitir(esfera_sim_t *e)
+{
+    uint8_t buf[ESPNOW_INGEST_MAX_LEN];
+    size_t len;
+    int lecturas = 1;
+
+    avanzar_medicion(e);
+    switch (e->formato) {
+    case FORMATO_TEXTO:
+        len = armar_texto(e, buf, sizeof(buf));
+        break;
+    case FORMATO_V3:
+        lecturas = s_op.muestras_v3;
+        len = armar_v3(e, buf, lecturas);
+        break;
+    default:
+        len = armar_v1_v2(e, buf);
+        break;
+    }
+
+    if (con_probabilidad(s_op.malformadas)) {
+        enviar(e, buf, corromper(e, buf, len));
+        s_inyectadas_malas++;
+        return;
+    }
+
+    enviar(e, buf, len);
+    s_lecturas_enviadas += lecturas;
+
+    // Retransmisión ESP-NOW: la misma trama otra vez
+    if (con_probabilidad(s_op.duplicados)) {
+        enviar(e, buf, len);
+        s_inyectadas_dup += lecturas;
+        if (e->formato != FORMATO_TEXTO) s_inyectadas_dup_detectables += lecturas;
+        else s_lecturas_enviadas += lecturas;
+    }
+}
+
+// ============================================================
+//   HUB: MISMO PROCESO QUE procesar_trama_esfera, SIN MQTT
+// ============================================================
+static void procesar_trama(const espnow_trama_t *trama)
+{
+    char mac_str[13];
+    esfera_registry_mac_a_texto(trama->mac, mac_str);
+
+    esfera_lectura_t lectura;
+    if (esfera_frame_decode(trama->data, trama->len, mac_str, &lectura) != ESP_OK) {
+        s_invalidas++;
+        return;
+    }
+
+    uint16_t indice;
+    bool nueva = false;
+    esp_err_t err = esfera_registry_register(trama->mac, &indice, &nueva);
+    if (err != ESP_OK) s_sin_registro++;
+
+    for (uint8_t i = 0; i < lectura.muestras; i++) {
+        if (i > 0) esfera_frame_muestra(trama->data, i, &lectura);
+
+        if (err == ESP_OK && lectura.tiene_seq &&
+            esfera_seq_check(indice, lectura.seq, trama->rx_us) == ESFERA_SEQ_DUPLICADA) {
+            s_duplicadas++;
+            continue;
+        }
+        esfera_manager_add(err == ESP_OK ? indice : ESFERA_REGISTRY_NINGUNA, &lectura,
+                           (time_t)trama->epoch - lectura.edad_s);
+        s_agregadas++;
+    }
+
+    if (s_n_latencias < MAX_LATENCIAS) {
+        s_latencias[s_n_latencias++] = (uint32_t)(esp_timer_get_time() - trama->rx_us);
+    }
+}
+
+static void fin_lote(void)
+{
+    esfera_registry_flush();
+    esfera_log_flush(false);
+}
+
+// Mismo ciclo que un pedido "Data" seguido de su "Ack"
+static void *publicador(void *arg)
+{
+    atomic_store(&s_publicador_listo, true);
+    bool ultima = false;
+    while (!ultima) {
+        ultima = atomic_load(&s_fin_publicador);
+        if (!ultima) usleep((useconds_t)s_op.publicacion_ms * 1000);
+
+        size_t n = esfera_manager_snapshot_tomar();
+        char *json = esfera_manager_generate_json();
+        if (json) {
+            free(json);
+            esfera_manager_snapshot_liberar();
+            s_publicadas += n;
+            s_publicaciones++;
+        }
+    }
+    return NULL;
+}
+
+// ============================================================
+//   PRINCIPAL
+// ============================================================
+static int comparar_u32(const void *a, const void *b)
+{
+    uint32_t x = *(const uint32_t *)a, y = *(const uint32_t *)b;
+    return (x > y) - (x < y);
+}
+
+static uint32_t percentil(const uint32_t *v, size_t n, unsigned por_mil)
+{
+    if (n == 0) return 0;
+    size_t i = (n * por_mil + 999) / 1000;
+    return v[i ? i - 1 : 0];
+}
+
+static formato_t leer_formato(const char *s)
+{
+    if (strcmp(s, "texto") == 0) return FORMATO_TEXTO;
+    if (strcmp(s, "v1") == 0) return FORMATO_V1;
+    if (strcmp(s, "v2") == 0) return FORMATO_V2;
+    if (strcmp(s, "v3") == 0) return FORMATO_V3;
+    return FORMATO_MIXTO;
+}
+
+static void leer_opciones(int argc, char **argv)
+{
+    int c;
+    while ((c = getopt(argc, argv, "n:i:j:d:m:f:k:p:t:s:cv")) != -1) {
+        switch (c) {
+        case 'n': s_op.esferas = atoi(optarg); break;
+        case 'i': s_op.intervalo_ms = atoi(optarg); break;
+        case 'j': s_op.jitter = atoi(optarg); break;
+        case 'd': s_op.duplicados = atoi(optarg); break;
+        case 'm': s_op.malformadas = atoi(optarg); break;
+        case 'f': s_op.formato = leer_formato(optarg); break;
+        case 'k': s_op.muestras_v3 = atoi(optarg); break;
+        case 'p': s_op.publicacion_ms = atoi(optarg); break;
+        case 't': s_op.segundos = atoi(optarg); break;
+        case 's': s_op.semilla = (uint32_t)strtoul(optarg, NULL, 0); break;
+        case 'c': s_op.verificar = true; break;
+        case 'v': host_log_nivel = ESP_LOG_INFO; break;
+        default:
+            fprintf(stderr, "uso: %s [-n esferas] [-i intervalo_ms] [-j jitter_%%] [-d duplicados_%%] "
+                            "[-m malformadas_%%] [-f texto|v1|v2|v3|mixto] [-k muestras_v3] "
+                            "[-p publicacion_ms] [-t segundos] [-s semilla] [-c] [-v]\n", argv[0]);
+            exit(2);
+        }
+    }
+    if (s_op.esferas < 1 || s_op.esferas > MAX_ESFERAS) {
+        fprintf(stderr, "-n debe estar entre 1 y %d\n", MAX_ESFERAS);
+        exit(2);
+    }
+    if (s_op.muestras_v3 < 1 || s_op.muestras_v3 > 26) s_op.muestras_v3 = 4;
+    if (s_op.intervalo_ms < 1) s_op.intervalo_ms = 1;
+    s_azar = s_op.semilla ? s_op.semilla : 1;
+}
+
+static int verificar(const esfera_manager_stats_t *mgr, const espnow_ingest_stats_t *ing,
+                     const espnow_ratelimit_stats_t *rl)
+{
+    int fallas = 0;
+#define VERIFICAR(cond) do {                                    \
+        if (!(cond)) {                                          \
+            fprintf(stderr, "FALLA: %s\n", #cond);              \
+            fallas++;                                           \
+        }                                                       \
+    } while (0)
+
+    VERIFICAR(ing->descartes == 0);
+    VERIFICAR(rl->limitadas == 0);
+    VERIFICAR(s_invalidas == s_inyectadas_malas);
+    VERIFICAR(s_agregadas == s_publicadas + mgr->sobrescritas + mgr->rechazadas);
+    if (s_sin_registro == 0) {
+        VERIFICAR(s_duplicadas == s_inyectadas_dup_detectables);
+        VERIFICAR(s_agregadas == s_lecturas_enviadas);
+    }
+#undef VERIFICAR
+    return fallas;
+}
+
+int main(int argc, char **argv)
+{
+    leer_opciones(argc, argv);
+    s_latencias = malloc(MAX_LATENCIAS * sizeof(uint32_t));
+    if (!s_latencias) return 1;
+
+    esfera_manager_init();
+    ESP_ERROR_CHECK(espnow_ingest_init(procesar_trama, fin_lote));
+
+    pthread_t hilo_publicador;
+    pthread_create(&hilo_publicador, NULL, publicador, NULL);
+    while (!atomic_load(&s_publicador_listo)) usleep(100);
+
+    int64_t inicio = esp_timer_get_time();
+    for (int i = 0; i < s_op.esferas; i++) {
+        esfera_sim_t *e = &s_esferas[i];
+        e->mac[0] = 0xA0;
+        e->mac[1] = 0x85;
+        e->mac[2] = 0xE3;
+        e->mac[3] = (uint8_t)(i >> 16);
+        e->mac[4] = (uint8_t)(i >> 8);
+        e->mac[5] = (uint8_t)i;
+        e->formato = s_op.formato == FORMATO_MIXTO ? (formato_t)(i % 4) : s_op.formato;
+        e->seq = (uint16_t)azar();
+        e->humedad = (uint16_t)(3000 + azar() % 4000);
+        e->temperatura = (int16_t)(1500 + azar() % 1500);
+        e->bateria_mv = (uint16_t)(3600 + azar() % 600);
+        // Fase al azar para que la flota no transmita toda junta al arrancar
+        e->proximo_us = inicio + (int64_t)(azar() % ((uint32_t)s_op.intervalo_ms * 1000));
+    }
+
+    espnow_ingest_metricas_t descarte;
+    espnow_ingest_get_metricas(&descarte);
+    host_heap_reiniciar_pico();
+    size_t heap_base = host_heap_en_uso();
+
+    // Productor: hace de tarea Wi-Fi, un solo hilo como en el hub
+    int64_t fin = inicio + (int64_t)s_op.segundos * 1000000;
+    int64_t ahora;
+    while ((ahora = esp_timer_get_time()) < fin) {
+        int64_t siguiente = fin;
+        for (int i = 0; i < s_op.esferas; i++) {
+            esfera_sim_t *e = &s_esferas[i];
+            if (e->proximo_us <= ahora) {
+                transmitir(e);
+                e->proximo_us = proximo_envio(e->proximo_us);
+            }
+            if (e->proximo_us < siguiente) siguiente = e->proximo_us;
+        }
+        int64_t espera = siguiente - esp_timer_get_time();
+        if (espera > 0) usleep((useconds_t)(espera < 1000 ? espera : 1000));
+    }
+
+    // Se espera a que la ingesta vacíe el ring y el publicador el buffer
+    espnow_ingest_stats_t ing;
+    do {
+        usleep(1000);
+        espnow_ingest_get_stats(&ing);
+    } while (ing.ocupacion > 0);
+    usleep(20000);
+    espnow_ingest_metricas_t m;
+    espnow_ingest_get_metricas(&m);
+    atomic_store(&s_fin_publicador, true);
+    pthread_join(hilo_publicador, NULL);
+    espnow_ingest_get_stats(&ing);
+
+    esfera_manager_stats_t mgr;
+    esfera_manager_get_stats(&mgr);
+    espnow_ratelimit_stats_t rl;
+    espnow_ratelimit_get_stats(&rl);
+
+    qsort(s_latencias, s_n_latencias, sizeof(uint32_t), comparar_u32);
+    double segundos = (double)(ahora - inicio) / 1e6;
+
+    printf("Flota: %d esferas, intervalo %d ms ±%d%%, %d%% duplicadas, %d%% malformadas, %.1f s\n",
+           s_op.esferas, s_op.intervalo_ms, s_op.jitter, s_op.duplicados, s_op.malformadas, segundos);
+    printf("Tramas:     %" PRIu64 " enviadas, %.1f tramas/s procesadas\n",
+           s_tramas, m.tramas / segundos);
+    printf("Latencia:   p50 %" PRIu32 " us, p99 %" PRIu32 " us, max %" PRIu32 " us "
+           "(histograma del hub: p50<=%" PRIu32 " p99<=%" PRIu32 ")\n",
+           percentil(s_latencias, s_n_latencias, 500), percentil(s_latencias, s_n_latencias, 990),
+           s_n_latencias ? s_latencias[s_n_latencias - 1] : 0, m.latencia_p50_us, m.latencia_p99_us);
+    printf("Heap:       pico %zu bytes (%zu sobre la base de %zu)\n",
+           host_heap_pico(), host_heap_pico() - heap_base, heap_base);
+    printf("Descartes:  ring %" PRIu32 " (max ocupación %" PRIu32 "/%d), limitadas %" PRIu32
+           ", inválidas %" PRIu64 "/%" PRIu64 ", duplicadas %" PRIu64 "/%" PRIu64 ", sin registro %" PRIu64 "\n",
+           ing.descartes, ing.max_ocupacion, ESPNOW_INGEST_BYTES, rl.limitadas,
+           s_invalidas, s_inyectadas_malas, s_duplicadas, s_inyectadas_dup_detectables, s_sin_registro);
+    printf("Lecturas:   %" PRIu64 " agregadas, %" PRIu64 " publicadas en %" PRIu64 " pedidos, "
+           "%" PRIu32 " sobrescritas, %" PRIu32 " rechazadas\n",
+           s_agregadas, s_publicadas, s_publicaciones, mgr.sobrescritas, mgr.rechazadas);
+
+    return s_op.verificar ? (verificar(&mgr, &ing, &rl) ? 1 : 0) : 0;
+}
@@ -0,0 +1,183 @@
+// Prueba de estrés del doble buffer de esfera_manager: una tarea escribe
+// lecturas con esfera_manager_add mientras otra toma, lee y libera snapshots y
+// hace copias con esfera_manager_copiar, como el publicador y las consultas.
+//
+// Cada lectura lleva un epoch único y el resto de los campos derivados de él,
+// así que una lectura rota (mezcla de dos escrituras) se detecta. Se verifica
+// que ninguna lectura aparezca dos veces, que el orden se conserve y que toda
+// lectura escrita se publique o figure como sobrescrita/rechazada; con control
+// de flujo (el escritor no llena la mitad activa) deben publicarse todas.
+#include <stdlib.h>
+#include <string.h>
+#include <stdbool.h>
+#include <stdatomic.h>
+#include <inttypes.h>
+#include <pthread.h>
+#include <sched.h>
+#include <unistd.h>
+#include "esp_log.h"
+#include "prueba.h"
+#include "esfera_manager.h"
+
+#define LECTURAS        400000
+
+static atomic_bool s_fin_escritura;
+static uint8_t *s_vistas;
+static uint32_t s_ultimo_publicado;
+static uint64_t s_publicadas;
+static uint64_t s_snapshots;
+static uint64_t s_copias;
+static bool s_control_flujo;
+
+static void lectura_de(uint32_t k, esfera_lectura_t *l)
+{
+    memset(l, 0, sizeof(*l));
+    l->humedad = (uint16_t)(k * 7u);
+    l->temperatura = (int16_t)(k * 31u);
+    l->voltaje_mv = (uint16_t)(k ^ 0x5555u);
+    l->riego = k & 1;
+    l->muestras = 1;
+    strcpy(l->mac, "A085E369D6AC");
+}
+
+static bool intacta(const esfera_data_t *e)
+{
+    uint32_t k = e->epoch;
+    static const uint8_t mac[6] = { 0xA0, 0x85, 0xE3, 0x69, 0xD6, 0xAC };
+    return k >= 1 && k <= LECTURAS &&
+           e->humedad == (uint16_t)(k * 7u) &&
+           e->temperatura == (int16_t)(k * 31u) &&
+           e->voltaje_mv == (uint16_t)(k ^ 0x5555u) &&
+           e->riego == (k & 1) &&
+           memcmp(e->mac, mac, sizeof(mac)) == 0;
+}
+
+static void *escritor(void *arg)
+{
+    esfera_lectura_t l;
+    for (uint32_t k = 1; k <= LECTURAS; k++) {
+        lectura_de(k, &l);
+        if (s_control_flujo) {
+            // La ocupación incluye la mitad activa: sin llenarla nunca se sobrescribe
+            esfera_manager_stats_t st;
+            for (esfera_manager_get_stats(&st); st.ocupacion >= st.capacidad; esfera_manager_get_stats(&st)) {
+                sched_yield();
+            }
+        }
+        esfera_manager_add(ESFERA_REGISTRY_NINGUNA, &l, (time_t)k);
+        // Cambia el ritmo para recorrer distintos entrelazados con el lector
+        if ((k & 0xFFF) == 0) sched_yield();
+    }
+    atomic_store(&s_fin_escritura, true);
+    return NULL;
+}
+
+// Copia sin tocar el snapshot: debe empezar con el snapshot retenido (si lo
+// hay) y seguir con lecturas más nuevas, todas intactas y en orden
+static void verificar_copia(size_t n_snapshot)
+{
+    size_t n;
+    esfera_data_t *copia = esfera_manager_copiar(&n);
+    VERIFICAR(copia != NULL);
+    if (!copia) return;
+
+    VERIFICAR(n >= n_snapshot);
+    for (size_t i = 0; i < n; i++) {
+        VERIFICAR_MSG(intacta(&copia[i]), "copia[%zu] epoch %" PRIu32, i, copia[i].epoch);
+        if (i > 0) VERIFICAR_MSG(copia[i].epoch > copia[i - 1].epoch, "copia fuera de orden en %zu", i);
+        if (i < n_snapshot) {
+            VERIFICAR(memcmp(&copia[i], esfera_manager_snapshot_leer(i), sizeof(esfera_data_t)) == 0);
+        }
+    }
+    free(copia);
+    s_copias++;
+}
+
+static void consumir_snapshot(void)
+{
+    size_t n = esfera_manager_snapshot_tomar();
+    if (s_snapshots % 7 == 3) verificar_copia(n);
+    VERIFICAR(esfera_manager_snapshot_tomar() == n);
+
+    for (size_t i = 0; i < n; i++) {
+        const esfera_data_t *e = esfera_manager_snapshot_leer(i);
+        if (!intacta(e)) {
+            VERIFICAR_MSG(false, "lectura rota en snapshot %" PRIu64 "[%zu]: epoch %" PRIu32,
+                          s_snapshots, i, e->epoch);
+            continue;
+        }
+        VERIFICAR_MSG(e->epoch > s_ultimo_publicado, "epoch %" PRIu32 " después de %" PRIu32,
+                      e->epoch, s_ultimo_publicado);
+        VERIFICAR_MSG(!s_vistas[e->epoch], "epoch %" PRIu32 " publicado dos veces", e->epoch);
+        s_vistas[e->epoch] = 1;
+        s_ultimo_publicado = e->epoch;
+        s_publicadas++;
+    }
+    esfera_manager_snapshot_liberar();
+    s_snapshots++;
+    if (s_snapshots % 11 == 5) verificar_copia(0);
+}
+
+static void ronda(bool control_flujo, int pausa_us)
+{
+    esfera_manager_init();
+    memset(s_vistas, 0, LECTURAS + 1);
+    s_ultimo_publicado = 0;
+    s_publicadas = 0;
+    s_snapshots = 0;
+    s_copias = 0;
+    s_control_flujo = control_flujo;
+    atomic_store(&s_fin_escritura, false);
+
+    esfera_manager_stats_t antes;
+    esfera_manager_get_stats(&antes);
+
+    pthread_t hilo;
+    pthread_create(&hilo, NULL, escritor, NULL);
+    while (!atomic_load(&s_fin_escritura)) {
+        consumir_snapshot();
+        if (pausa_us) usleep((useconds_t)pausa_us);
+    }
+    pthread_join(hilo, NULL);
+    // Dos intercambios vacían ambas mitades
+    consumir_snapshot();
+    consumir_snapshot();
+
+    esfera_manager_stats_t despues;
+    esfera_manager_get_stats(&despues);
+    uint32_t sobrescritas = despues.sobrescritas - antes.sobrescritas;
+    uint32_t rechazadas = despues.rechazadas - antes.rechazadas;
+
+    printf("%s, pausa %4d us: %" PRIu64 " publicadas en %" PRIu64 " snapshots, %" PRIu64 " copias, "
+           "%" PRIu32 " sobrescritas, %" PRIu32 " rechazadas\n",
+           control_flujo ? "con control de flujo" : "sin control de flujo", pausa_us,
+           s_publicadas, s_snapshots, s_copias, sobrescritas, rechazadas);
+
+    VERIFICAR(despues.ocupacion == 0);
+    VERIFICAR_MSG(s_publicadas + sobrescritas + rechazadas == LECTURAS,
+                  "%" PRIu64 " + %" PRIu32 " + %" PRIu32 " != %d",
+                  s_publicadas, sobrescritas, rechazadas, LECTURAS);
+    if (control_flujo) {
+        VERIFICAR(sobrescritas == 0 && rechazadas == 0);
+        VERIFICAR(s_publicadas == LECTURAS);
+    }
+}
+
+int main(void)
+{
+    s_vistas = malloc(LECTURAS + 1);
+    if (!s_vistas) return 1;
+
+    // Los avisos de buffer lleno son esperables en las rondas sin control de flujo
+    host_log_nivel = ESP_LOG_ERROR;
+
+    // Sin pausa el lector compite en cada escritura; con pausa y sin control de
+    // flujo el buffer se llena y se ejercita la sobrescritura durante el intercambio
+    ronda(true, 0);
+    ronda(true, 20);
+    ronda(false, 0);
+    ronda(false, 200);
+
+    free(s_vistas);
+    return prueba_resultado("test_doble_buffer");
+}
@@ -0,0 +1,262 @@
+// Prueba del parser de tramas de texto de esfera_frame ("h,t,v,r MAC").
+//
+// Compara esfera_frame_parse_texto con el parser anterior basado en sscanf
+// (referencia copiada abajo) sobre tramas como las que imprimen las esferas,
+// verifica los casos en que el parser nuevo es deliberadamente más estricto
+// (campos largos, valores fuera de rango, riego distinto de 0/1, separadores
+// faltantes) y mide el tiempo de ambos.
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <math.h>
+#include <inttypes.h>
+#include "esp_log.h"
+#include "esp_timer.h"
+#include "prueba.h"
+#include "esfera_frame.h"
+
+#define TRAMAS_EQUIVALENCIA     200000
+#define TRAMAS_TIEMPO           200000
+#define TEXTO_MAX_LEN           64
+
+static uint32_t s_azar = 12345;
+
+static uint32_t azar(void)
+{
+    s_azar ^= s_azar << 13;
+    s_azar ^= s_azar >> 17;
+    s_azar ^= s_azar << 5;
+    return s_azar;
+}
+
+// Parser de texto anterior a esfera_frame_parse_texto, sin cambios salvo la firma
+static bool referencia_sscanf(const uint8_t *data, size_t len, esfera_lectura_t *out)
+{
+    char payload[TEXTO_MAX_LEN + 1];
+    if (len > TEXTO_MAX_LEN) len = TEXTO_MAX_LEN;
+    memcpy(payload, data, len);
+    payload[len] = '\0';
+
+    float h, t, v;
+    int r;
+    if (sscanf(payload, "%f,%f,%f,%d %12s", &h, &t, &v, &r, out->mac) != 5) {
+        return false;
+    }
+
+    out->humedad = (uint16_t)lroundf(h * 100.0f);
+    out->temperatura = (int16_t)lroundf(t * 100.0f);
+    out->voltaje_mv = (uint16_t)lroundf(v * 1000.0f);
+    out->riego = (uint8_t)r;
+    return true;
+}
+
+static esfera_texto_err_t parsear(const char *texto, esfera_lectura_t *out, size_t *pos)
+{
+    return esfera_frame_parse_texto((const uint8_t *)texto, strlen(texto), out, pos);
+}
+
+// ============================================================
+//   EQUIVALENCIA CON sscanf
+// ============================================================
+static size_t trama_al_azar(char *buf, size_t cap, bool seis_decimales)
+{
+    // Rangos reales de las esferas: humedad 0-100 %, -40 a 85 °C, 0 a 4.5 V
+    double h = (azar() % 1000001) / 10000.0;
+    double t = ((int32_t)(azar() % 1250001) - 400000) / 10000.0;
+    double v = (azar() % 4500001) / 1000000.0;
+    unsigned r = azar() & 1;
+    const char *hex = (azar() & 1) ? "0123456789ABCDEF" : "0123456789abcdef";
+    char mac[13];
+    for (int i = 0; i < 12; i++) mac[i] = hex[azar() % 16];
+    mac[12] = '\0';
+
+    int n = seis_decimales ? snprintf(buf, cap, "%f,%f,%f,%u %s", h, t, v, r, mac)
+                           : snprintf(buf, cap, "%.2f,%.2f,%.3f,%u %s", h, t, v, r, mac);
+    return (size_t)n;
+}
+
+static void probar_equivalencia(void)
+{
+    char buf[TEXTO_MAX_LEN];
+    unsigned exactas = 0, redondeo = 0;
+
+    for (int i = 0; i < TRAMAS_EQUIVALENCIA; i++) {
+        // La mitad con los decimales justos del punto fijo, la mitad con "%f"
+        bool seis = i & 1;
+        size_t len = trama_al_azar(buf, sizeof(buf), seis);
+
+        esfera_lectura_t nuevo, viejo;
+        esfera_texto_err_t err = esfera_frame_parse_texto((const uint8_t *)buf, len, &nuevo, NULL);
+        VERIFICAR_MSG(err == ESFERA_TEXTO_OK, "\"%s\": %s", buf, esfera_frame_texto_err_str(err));
+        VERIFICAR(referencia_sscanf((const uint8_t *)buf, len, &viejo));
+        if (err != ESFERA_TEXTO_OK) continue;
+
+        // sscanf pasa por float: con "%f" el redondeo puede diferir en la última unidad
+        int dh = abs(nuevo.humedad - viejo.humedad);
+        int dt = abs(nuevo.temperatura - viejo.temperatura);
+        int dv = abs(nuevo.voltaje_mv - viejo.voltaje_mv);
+        if (!seis) {
+            VERIFICAR_MSG(dh == 0 && dt == 0 && dv == 0, "\"%s\": %u/%d/%u contra %u/%d/%u", buf,
+                          nuevo.humedad, nuevo.temperatura, nuevo.voltaje_mv,
+                          viejo.humedad, viejo.temperatura, viejo.voltaje_mv);
+        } else {
+            VERIFICAR_MSG(dh <= 1 && dt <= 1 && dv <= 1, "\"%s\"", buf);
+        }
+        if (dh || dt || dv) redondeo++;
+        else exactas++;
+
+        VERIFICAR(nuevo.riego == viejo.riego);
+        VERIFICAR(strcasecmp(nuevo.mac, viejo.mac) == 0);
+        VERIFICAR(nuevo.muestras == 1 && !nuevo.tiene_seq && !nuevo.tiene_cfg && nuevo.edad_s == 0);
+    }
+    printf("equivalencia con sscanf: %u idénticas, %u con diferencia de redondeo de 1 unidad\n",
+           exactas, redondeo);
+}
+
+// ============================================================
+//   CASOS LÍMITE
+// ============================================================
+typedef struct {
+    const char *texto;
+    esfera_texto_err_t err;
+    int32_t humedad, temperatura, voltaje, riego;  // Solo si err == OK
+} caso_t;
+
+static const caso_t s_casos[] = {
+    // Válidos
+    { "45.23,22.10,3.812,1 A085E369D6AC", ESFERA_TEXTO_OK, 4523, 2210, 3812, 1 },
+    { "45.230000,22.100000,3.812000,0 a085e369d6ac", ESFERA_TEXTO_OK, 4523, 2210, 3812, 0 },
+    { "0,-40,0,0 A085E369D6AC", ESFERA_TEXTO_OK, 0, -4000, 0, 0 },
+    { "+1,+2,+3,+1 A085E369D6AC", ESFERA_TEXTO_OK, 100, 200, 3000, 1 },
+    { " 1, -0.5,\t4,1  A085E369D6AC\r\n", ESFERA_TEXTO_OK, 100, -50, 4000, 1 },
+    { "1.,2.,3.,1 A085E369D6AC", ESFERA_TEXTO_OK, 100, 200, 3000, 1 },
+    { ".5,-.25,.001,0 A085E369D6AC", ESFERA_TEXTO_OK, 50, -25, 1, 0 },
+    { "12.345,12.344,1.2345,0 A085E369D6AC", ESFERA_TEXTO_OK, 1235, 1234, 1235, 0 },
+    { "1.00000000000000000000001,0,0,0 A085E369D6AC", ESFERA_TEXTO_OK, 100, 0, 0, 0 },
+    { "655.35,327.67,65.535,1 A085E369D6AC", ESFERA_TEXTO_OK, 65535, 32767, 65535, 1 },
+    { "0,-327.68,0,0 A085E369D6AC", ESFERA_TEXTO_OK, 0, -32768, 0, 0 },
+    { "0000000000000045.5,0,0,0 A085E369D6AC", ESFERA_TEXTO_OK, 4550, 0, 0, 0 },
+
+    // Fuera de rango, incluido lo que sscanf aceptaba y truncaba al convertir
+    { "655.36,0,0,0 A085E369D6AC", ESFERA_TEXTO_ERR_RANGO },
+    { "655.355,0,0,0 A085E369D6AC", ESFERA_TEXTO_ERR_RANGO },
+    { "-0.01,0,0,0 A085E369D6AC", ESFERA_TEXTO_ERR_RANGO },
+    { "0,327.68,0,0 A085E369D6AC", ESFERA_TEXTO_ERR_RANGO },
+    { "0,-327.69,0,0 A085E369D6AC", ESFERA_TEXTO_ERR_RANGO },
+    { "0,0,65.536,0 A085E369D6AC", ESFERA_TEXTO_ERR_RANGO },
+    { "99999999999999999999,0,0,0 A085E369D6AC", ESFERA_TEXTO_ERR_RANGO },
+    { "0,-99999999999999999999,0,0 A085E369D6AC", ESFERA_TEXTO_ERR_RANGO },
+
+    // Riego: solo 0 o 1, como en las tramas binarias
+    { "1,2,3,2 A085E369D6AC", ESFERA_TEXTO_ERR_RANGO },
+    { "1,2,3,-1 A085E369D6AC", ESFERA_TEXTO_ERR_RANGO },
+    { "1,2,3,10 A085E369D6AC", ESFERA_TEXTO_ERR_RANGO },
+    { "1,2,3,1.0 A085E369D6AC", ESFERA_TEXTO_ERR_SEPARADOR },
+
+    // Números y separadores
+    { "", ESFERA_TEXTO_ERR_VACIO },
+    { "abc", ESFERA_TEXTO_ERR_NUMERO },
+    { "-,2,3,1 A085E369D6AC", ESFERA_TEXTO_ERR_NUMERO },
+    { "1,,3,1 A085E369D6AC", ESFERA_TEXTO_ERR_NUMERO },
+    { "1;2;3;1 A085E369D6AC", ESFERA_TEXTO_ERR_SEPARADOR },
+    { "1,2,3 1 A085E369D6AC", ESFERA_TEXTO_ERR_SEPARADOR },
+    { "1,2,3,1A085E369D6AC", ESFERA_TEXTO_ERR_SEPARADOR },
+    { "1 2,3,1 A085E369D6AC", ESFERA_TEXTO_ERR_SEPARADOR },
+    { "1,2,3,1", ESFERA_TEXTO_ERR_SEPARADOR },
+    { "1.2.3,2,3,1 A085E369D6AC", ESFERA_TEXTO_ERR_SEPARADOR },
+
+    // MAC
+    { "1,2,3,1 ", ESFERA_TEXTO_ERR_MAC },
+    { "1,2,3,1 A085E369D6A", ESFERA_TEXTO_ERR_MAC },
+    { "1,2,3,1 A085E369D6AG", ESFERA_TEXTO_ERR_MAC },
+    { "1,2,3,1 A0:85:E3:69:D6:AC", ESFERA_TEXTO_ERR_MAC },
+    { "1,2,3,1 A085E369D6AC0", ESFERA_TEXTO_ERR_SOBRANTE },
+    { "1,2,3,1 A085E369D6AC x", ESFERA_TEXTO_ERR_SOBRANTE },
+};
+
+static void probar_casos(void)
+{
+    for (size_t i = 0; i < sizeof(s_casos) / sizeof(s_casos[0]); i++) {
+        const caso_t *c = &s_casos[i];
+        esfera_lectura_t l;
+        size_t pos = SIZE_MAX;
+        esfera_texto_err_t err = parsear(c->texto, &l, &pos);
+        VERIFICAR_MSG(err == c->err, "\"%s\": %s, se esperaba %s", c->texto,
+                      esfera_frame_texto_err_str(err), esfera_frame_texto_err_str(c->err));
+        if (err != ESFERA_TEXTO_OK) {
+            VERIFICAR_MSG(pos <= strlen(c->texto), "\"%s\": posición %zu", c->texto, pos);
+            continue;
+        }
+        if (c->err != ESFERA_TEXTO_OK) continue;
+        VERIFICAR_MSG(l.humedad == c->humedad && l.temperatura == c->temperatura &&
+                      l.voltaje_mv == c->voltaje && l.riego == c->riego,
+                      "\"%s\": %u/%d/%u/%u", c->texto, l.humedad, l.temperatura, l.voltaje_mv, l.riego);
+        VERIFICAR(strcmp(l.mac, "A085E369D6AC") == 0);
+    }
+
+    // La posición del error apunta al byte que falló
+    esfera_lectura_t l;
+    size_t pos = 0;
+    VERIFICAR(parsear("1,2,3,2 A085E369D6AC", &l, &pos) == ESFERA_TEXTO_ERR_RANGO && pos == 6);
+    VERIFICAR(parsear("1,2;3,1 A085E369D6AC", &l, &pos) == ESFERA_TEXTO_ERR_SEPARADOR && pos == 3);
+    VERIFICAR(parsear("1,2,3,1 A085E369D6AG", &l, &pos) == ESFERA_TEXTO_ERR_MAC && pos == 19);
+
+    // No requiere '\0' final: la trama termina donde dice len, aunque siga memoria válida
+    const char *con_cola = "1,2,3,1 A085E369D6ACFFFF";
+    VERIFICAR(esfera_frame_parse_texto((const uint8_t *)con_cola, 20, &l, NULL) == ESFERA_TEXTO_OK);
+    VERIFICAR(esfera_frame_parse_texto((const uint8_t *)con_cola, 19, &l, NULL) == ESFERA_TEXTO_ERR_MAC);
+    uint8_t *exacta = malloc(20);
+    memcpy(exacta, con_cola, 20);
+    VERIFICAR(esfera_frame_parse_texto(exacta, 20, &l, NULL) == ESFERA_TEXTO_OK);
+    free(exacta);
+
+    // Los '\0' finales (esferas que envían el terminador) se toleran
+    const uint8_t con_nul[] = "1,2,3,1 A085E369D6AC";
+    VERIFICAR(esfera_frame_parse_texto(con_nul, sizeof(con_nul), &l, NULL) == ESFERA_TEXTO_OK);
+
+    // Ruta completa: esfera_frame_decode elige el parser por el primer byte
+    VERIFICAR(esfera_frame_decode((const uint8_t *)"45.2,22.1,3.8,1 A085E369D6AC", 28, "X", &l) == ESP_OK);
+    VERIFICAR(l.humedad == 4520 && l.temperatura == 2210 && l.voltaje_mv == 3800);
+    VERIFICAR(esfera_frame_decode((const uint8_t *)"45.2,22.1,3.8,2 A085E369D6AC", 28, "X", &l) == ESP_ERR_INVALID_ARG);
+}
+
+// ============================================================
+//   TIEMPO
+// ============================================================
+static void medir_tiempo(void)
+{
+    char (*tramas)[TEXTO_MAX_LEN] = malloc(TRAMAS_TIEMPO * sizeof(*tramas));
+    size_t *largos = malloc(TRAMAS_TIEMPO * sizeof(size_t));
+    if (!tramas || !largos) return;
+    for (int i = 0; i < TRAMAS_TIEMPO; i++) largos[i] = trama_al_azar(tramas[i], TEXTO_MAX_LEN, i & 1);
+
+    esfera_lectura_t l;
+    unsigned ok = 0;
+    int64_t t0 = esp_timer_get_time();
+    for (int i = 0; i < TRAMAS_TIEMPO; i++) {
+        ok += esfera_frame_parse_texto((const uint8_t *)tramas[i], largos[i], &l, NULL) == ESFERA_TEXTO_OK;
+    }
+    int64_t t1 = esp_timer_get_time();
+    for (int i = 0; i < TRAMAS_TIEMPO; i++) {
+        ok += referencia_sscanf((const uint8_t *)tramas[i], largos[i], &l);
+    }
+    int64_t t2 = esp_timer_get_time();
+    VERIFICAR(ok == 2 * TRAMAS_TIEMPO);
+
+    printf("tiempo por trama: esfera_frame_parse_texto %.0f ns, sscanf %.0f ns (%.1fx)\n",
+           (t1 - t0) * 1000.0 / TRAMAS_TIEMPO, (t2 - t1) * 1000.0 / TRAMAS_TIEMPO,
+           (double)(t2 - t1) / (double)(t1 - t0));
+    free(tramas);
+    free(largos);
+}
+
+int main(void)
+{
+    // Las tramas inválidas de esfera_frame_decode se registran como avisos
+    host_log_nivel = ESP_LOG_ERROR;
+
+    probar_equivalencia();
+    probar_casos();
+    medir_tiempo();
+    return prueba_resultado("test_frame");
+}
@@ -0,0 +1,394 @@
+// Prueba del escritor JSON en streaming (esfera_json) contra cJSON.
+//
+// esfera_json_numero debe formatear igual que cJSON_PrintUnformatted: enteros
+// con "%d" (incluido el recorte de valueint a INT_MAX/INT_MIN), "%1.15g" cuando
+// alcanza para recuperar el valor y "%1.17g" cuando no. Después se compara la
+// respuesta "Data" completa de esfera_manager con el árbol cJSON que armaba la
+// versión anterior sobre el mismo snapshot, entera y entregada por tramos, y
+// la respuesta "Estado" de esfera_stats con el árbol cJSON que la armaba.
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <float.h>
+#include <limits.h>
+#include <inttypes.h>
+#include <time.h>
+#include "esp_log.h"
+#include "esp_timer.h"
+#include "host.h"
+#include "prueba.h"
+#include "cJSON.h"
+#include "esfera_json.h"
+#include "esfera_manager.h"
+#include "esfera_registry.h"
+#include "esfera_seq.h"
+#include "esfera_stats.h"
+
+#define LECTURAS        1000
+#define NUMEROS_AZAR    200000
+
+static uint64_t s_azar = 88172645463325252ull;
+
+static uint64_t azar(void)
+{
+    s_azar ^= s_azar << 13;
+    s_azar ^= s_azar >> 7;
+    s_azar ^= s_azar << 17;
+    return s_azar;
+}
+
+// ============================================================
+//   NÚMEROS
+// ============================================================
+static unsigned s_numeros;
+
+static void comparar_numero(double d)
+{
+    char buf[32];
+    esfera_json_t w;
+    esfera_json_init(&w, buf, sizeof(buf) - 1, NULL, NULL);
+    esfera_json_numero(&w, d);
+    VERIFICAR_MSG(esfera_json_fin(&w) == ESP_OK, "%a", d);
+    buf[w.total] = '\0';
+
+    cJSON *n = cJSON_CreateNumber(d);
+    char *ref = cJSON_PrintUnformatted(n);
+    VERIFICAR_MSG(ref && strcmp(buf, ref) == 0, "%a: \"%s\" contra cJSON \"%s\"", d, buf, ref ? ref : "(null)");
+    free(ref);
+    cJSON_Delete(n);
+    s_numeros++;
+}
+
+static void probar_numeros(void)
+{
+    static const double fijos[] = {
+        // Enteros
+        0.0, -0.0, 1.0, -1.0, 42.0, 100.0, 65535.0, -32768.0, 1e6, 123456789.0,
+        // Borde del recorte a int de cJSON (valueint)
+        (double)INT_MAX, (double)INT_MAX - 1, (double)INT_MAX + 1, (double)INT_MAX + 0.5,
+        (double)INT_MIN, (double)INT_MIN + 1, (double)INT_MIN - 1, (double)INT_MIN - 0.5,
+        4294967296.0, -4294967296.0, 1e15, 1e16, 1e17, 9007199254740993.0, 1e300, -1e300,
+        DBL_MAX, -DBL_MAX,
+        // Fracciones que alcanzan con 15 dígitos
+        0.5, -0.25, 0.1, 45.23, -12.5, 3.812, 2147483647.5,
+        // Fracciones que necesitan 17 dígitos
+        1.0 / 3.0, 2.0 / 3.0, 0.1 + 0.2, 45.23f, 22.1f, 3.812f, -0.01f, 1e-7 / 3,
+        // Muy chicos y subnormales
+        1e-300, DBL_MIN, DBL_MIN / 2, 4.9406564584124654e-324, -DBL_TRUE_MIN,
+        // Sin representación en JSON
+        NAN, -NAN, INFINITY, -INFINITY,
+    };
+    for (size_t i = 0; i < sizeof(fijos) / sizeof(fijos[0]); i++) comparar_numero(fijos[i]);
+
+    // Todos los valores que produce una lectura: centésimas y milésimas pasadas por float
+    for (int32_t v = 0; v <= UINT16_MAX; v++) {
+        comparar_numero(v / 100.0f);
+        comparar_numero(v / 1000.0f);
+    }
+    for (int32_t v = INT16_MIN; v <= INT16_MAX; v++) comparar_numero(v / 100.0f);
+
+    // Patrones de bits al azar y enteros grandes al azar
+    for (int i = 0; i < NUMEROS_AZAR; i++) {
+        uint64_t bits = azar();
+        double d;
+        memcpy(&d, &bits, sizeof(d));
+        comparar_numero(d);
+        comparar_numero((double)(int64_t)azar() / (double)(1ull << (azar() % 64)));
+    }
+    printf("números: %u comparados con cJSON\n", s_numeros);
+}
+
+// ============================================================
+//   RESPUESTA "Data" COMPLETA
+// ============================================================
+// Lo que hacía esfera_manager_generate_json antes del escritor en streaming
+static char *referencia_cjson(void)
+{
+    cJSON *root = cJSON_CreateArray();
+
+    size_t cantidad = esfera_manager_snapshot_tomar();
+    for (size_t i = 0; i < cantidad; i++) {
+        const esfera_data_t *e = esfera_manager_snapshot_leer(i);
+        char mac[13];
+        char timestamp[20];
+        esfera_data_formatear(e, mac, timestamp);
+
+        cJSON *item = cJSON_CreateObject();
+        cJSON_AddStringToObject(item, "mac", mac);
+        cJSON_AddNumberToObject(item, "humedad", e->humedad / 100.0f);
+        cJSON_AddNumberToObject(item, "temperatura", e->temperatura / 100.0f);
+        cJSON_AddNumberToObject(item, "bateria", e->voltaje_mv / 1000.0f);
+        cJSON_AddNumberToObject(item, "riego", e->riego);
+        cJSON_AddStringToObject(item, "timestamp", timestamp);
+        cJSON_AddItemToArray(root, item);
+    }
+
+    char *json_string = cJSON_PrintUnformatted(root);
+    cJSON_Delete(root);
+    return json_string;
+}
+
+typedef struct {
+    char *buf;
+    size_t len;
+    unsigned tramos;
+} acumulador_t;
+
+static esp_err_t acumular(const char *datos, size_t len, void *ctx)
+{
+    acumulador_t *a = ctx;
+    memcpy(a->buf + a->len, datos, len);
+    a->len += len;
+    a->tramos++;
+    return ESP_OK;
+}
+
+static esp_err_t fallar(const char *datos, size_t len, void *ctx)
+{
+    (*(unsigned *)ctx)++;
+    return ESP_FAIL;
+}
+
+static void agregar_lectura(uint32_t k)
+{
+    esfera_lectura_t l = { .muestras = 1 };
+    // Los primeros valores recorren los extremos de cada campo
+    static const uint16_t humedades[] = { 0, 1, 9, 10, 99, 100, 4523, 10000, 65534, 65535 };
+    static const int16_t temperaturas[] = { INT16_MIN, -4000, -1, 0, 1, 2210, 8500, INT16_MAX };
+    static const uint16_t voltajes[] = { 0, 1, 999, 1000, 3812, 4200, 65535 };
+    if (k < 10) {
+        l.humedad = humedades[k];
+        l.temperatura = temperaturas[k % 8];
+        l.voltaje_mv = voltajes[k % 7];
+    } else {
+        l.humedad = (uint16_t)azar();
+        l.temperatura = (int16_t)azar();
+        l.voltaje_mv = (uint16_t)azar();
+    }
+    l.riego = k & 1;
+    snprintf(l.mac, sizeof(l.mac), "A085E3%06" PRIX32, (uint32_t)(azar() % 40));
+    // Epochs de 1970 a 2106, incluido el cambio de año
+    time_t epoch = k == 0 ? 0 : k == 1 ? 1767225599 : (time_t)(uint32_t)azar();
+    esfera_manager_add(ESFERA_REGISTRY_NINGUNA, &l, epoch);
+}
+
+static void probar_data(size_t lecturas)
+{
+    for (uint32_t k = 0; k < lecturas; k++) agregar_lectura(k);
+    esfera_manager_snapshot_tomar();
+
+    char *ref = referencia_cjson();
+    VERIFICAR(ref != NULL);
+    if (!ref) return;
+    size_t largo = strlen(ref);
+
+    // Un solo buffer con la cota de peor caso
+    char *json = esfera_manager_generate_json();
+    VERIFICAR(json != NULL);
+    if (json) {
+        VERIFICAR_MSG(strcmp(json, ref) == 0, "%zu lecturas: difiere de cJSON", lecturas);
+        free(json);
+    }
+
+    // Por tramos, con buffers de varios tamaños
+    static const size_t caps[] = { 1, 7, 64, ESFERA_JSON_LECTURA_MAX, 1024, 4096 };
+    for (size_t i = 0; i < sizeof(caps) / sizeof(caps[0]); i++) {
+        char *trabajo = malloc(caps[i]);
+        acumulador_t a = { .buf = malloc(largo + 1) };
+        size_t total = 0;
+        VERIFICAR(esfera_manager_write_json(trabajo, caps[i], acumular, &a, &total) == ESP_OK);
+        VERIFICAR(total == largo && a.len == largo);
+        VERIFICAR_MSG(a.len == largo && memcmp(a.buf, ref, largo) == 0, "tramos de %zu bytes", caps[i]);
+        VERIFICAR(a.tramos == (largo + caps[i] - 1) / caps[i]);
+        free(a.buf);
+        free(trabajo);
+    }
+
+    // Solo contar bytes
+    size_t total = 0;
+    VERIFICAR(esfera_manager_write_json(NULL, 0, NULL, NULL, &total) == ESP_OK && total == largo);
+
+    // Sin salida y sin lugar: error, nunca escritura fuera del buffer
+    if (largo > 1) {
+        char *corto = malloc(largo - 1);
+        VERIFICAR(esfera_manager_write_json(corto, largo - 1, NULL, NULL, NULL) == ESP_ERR_INVALID_SIZE);
+        free(corto);
+    }
+
+    // El primer error de la salida corta la serialización
+    unsigned llamadas = 0;
+    char trabajo[16];
+    VERIFICAR(esfera_manager_write_json(trabajo, sizeof(trabajo), fallar, &llamadas, NULL) == ESP_FAIL);
+    VERIFICAR(llamadas == 1);
+
+    free(ref);
+    esfera_manager_snapshot_liberar();
+}
+
+// La cota por lectura de ESFERA_JSON_LECTURA_MAX con los valores más largos
+static void probar_cota(void)
+{
+    esfera_lectura_t l = { .muestras = 1, .riego = 1, .humedad = 65533, .temperatura = -32767, .voltaje_mv = 65533 };
+    strcpy(l.mac, "FFFFFFFFFFFF");
+    esfera_manager_add(ESFERA_REGISTRY_NINGUNA, &l, (time_t)UINT32_MAX);
+    esfera_manager_snapshot_tomar();
+    size_t total = 0;
+    esfera_manager_write_json(NULL, 0, NULL, NULL, &total);
+    VERIFICAR_MSG(total - 2 <= ESFERA_JSON_LECTURA_MAX, "%zu bytes por lectura", total - 2);
+    esfera_manager_snapshot_liberar();
+}
+
+// ============================================================
+//   RESPUESTA "Estado"
+// ============================================================
+static void agregar_metrica(cJSON *item, const char *nombre, int32_t actual,
+                            const esfera_stats_metrica_t *m, double escala)
+{
+    cJSON *obj = cJSON_AddObjectToObject(item, nombre);
+    cJSON_AddNumberToObject(obj, "actual", actual / escala);
+    cJSON_AddNumberToObject(obj, "min", m->min / escala);
+    cJSON_AddNumberToObject(obj, "max", m->max / escala);
+    cJSON_AddNumberToObject(obj, "media", m->media / escala);
+    cJSON_AddNumberToObject(obj, "ewma", m->ewma / escala);
+}
+
+// Lo que hacía esfera_stats_generate_json antes del escritor en streaming
+static char *referencia_estado(void)
+{
+    cJSON *root = cJSON_CreateObject();
+    cJSON *lista = cJSON_AddArrayToObject(root, "Estado");
+
+    for (uint16_t i = 0; i < ESFERA_REGISTRY_MAX; i++) {
+        esfera_stats_t st;
+        if (!esfera_stats_get(i, &st)) continue;
+
+        char mac[13];
+        char timestamp[20];
+        esfera_data_formatear(&st.ultima, mac, timestamp);
+
+        cJSON *item = cJSON_CreateObject();
+        cJSON_AddStringToObject(item, "mac", mac);
+        cJSON_AddStringToObject(item, "timestamp", timestamp);
+        cJSON_AddNumberToObject(item, "riego", st.ultima.riego);
+        cJSON_AddNumberToObject(item, "muestras", st.muestras);
+        agregar_metrica(item, "humedad", st.ultima.humedad, &st.humedad, 100.0);
+        agregar_metrica(item, "temperatura", st.ultima.temperatura, &st.temperatura, 100.0);
+        agregar_metrica(item, "bateria", st.ultima.voltaje_mv, &st.voltaje_mv, 1000.0);
+
+        esfera_seq_stats_t seq;
+        if (esfera_seq_get_stats(i, &seq) == ESP_OK) {
+            cJSON *obj = cJSON_AddObjectToObject(item, "secuencia");
+            cJSON_AddNumberToObject(obj, "recibidas", seq.recibidas);
+            cJSON_AddNumberToObject(obj, "perdidas", seq.perdidas);
+            cJSON_AddNumberToObject(obj, "duplicadas", seq.duplicadas);
+            cJSON_AddNumberToObject(obj, "fuera_de_orden", seq.fuera_de_orden);
+            cJSON_AddNumberToObject(obj, "reinicios", seq.reinicios);
+        }
+        cJSON_AddItemToArray(lista, item);
+    }
+
+    char *json_string = cJSON_PrintUnformatted(root);
+    cJSON_Delete(root);
+    return json_string;
+}
+
+static void comparar_estado(const char *caso)
+{
+    char *ref = referencia_estado();
+    char *json = esfera_stats_generate_json();
+    VERIFICAR_MSG(json && ref && strcmp(json, ref) == 0, "Estado %s difiere de cJSON", caso);
+    free(json);
+    free(ref);
+}
+
+// Todas las esferas del registro, con valores extremos y contadores de secuencia grandes
+static void probar_estado(void)
+{
+    comparar_estado("vacío");
+
+    for (uint16_t k = 0; k < ESFERA_REGISTRY_MAX; k++) {
+        uint8_t mac[6] = { 0xA0, 0x85, 0xE3, 0x00, (uint8_t)(k >> 8), (uint8_t)k };
+        uint16_t indice;
+        bool nueva;
+        if (esfera_registry_register(mac, &indice, &nueva) != ESP_OK) {
+            VERIFICAR(false);
+            return;
+        }
+
+        // Las esferas impares mandan tramas binarias: secuencias con huecos y duplicados
+        if (k & 1) {
+            uint16_t seq = (uint16_t)azar();
+            for (int j = 0; j < 40; j++) {
+                seq += 1 + (azar() % 4 == 0);
+                esfera_seq_check(indice, seq, (int64_t)j * 1000);
+                if (azar() % 5 == 0) esfera_seq_check(indice, seq, (int64_t)j * 1000);
+            }
+        }
+
+        for (int j = 0; j < 7; j++) {
+            esfera_data_t d = { .epoch = 1767225600u + (uint32_t)j * 13, .riego = (uint8_t)(j & 1) };
+            memcpy(d.mac, mac, sizeof(mac));
+            if (k < 8) {
+                // Los extremos de cada campo, para las medias y EWMA más largas
+                d.humedad = j & 1 ? 65535 : (uint16_t)(azar() % 3);
+                d.temperatura = j & 2 ? INT16_MIN : INT16_MAX;
+                d.voltaje_mv = (uint16_t)(65535 - j * 7);
+            } else {
+                d.humedad = (uint16_t)azar();
+                d.temperatura = (int16_t)azar();
+                d.voltaje_mv = (uint16_t)azar();
+            }
+            esfera_stats_actualizar(indice, &d);
+        }
+    }
+    comparar_estado("con el registro lleno");
+
+    char *json = esfera_stats_generate_json();
+    VERIFICAR(json && strstr(json, "\"secuencia\":{\"recibidas\":") != NULL);
+    if (json) printf("Estado con %d esferas: %zu bytes\n", ESFERA_REGISTRY_MAX, strlen(json));
+    free(json);
+}
+
+static void medir(void)
+{
+    for (uint32_t k = 0; k < LECTURAS; k++) agregar_lectura(k);
+    esfera_manager_snapshot_tomar();
+
+    host_heap_reiniciar_pico();
+    size_t base = host_heap_en_uso();
+    int64_t t0 = esp_timer_get_time();
+    char *json = esfera_manager_generate_json();
+    int64_t t1 = esp_timer_get_time();
+    size_t heap_streaming = host_heap_pico() - base;
+    free(json);
+
+    host_heap_reiniciar_pico();
+    base = host_heap_en_uso();
+    int64_t t2 = esp_timer_get_time();
+    char *ref = referencia_cjson();
+    int64_t t3 = esp_timer_get_time();
+    size_t heap_cjson = host_heap_pico() - base;
+    free(ref);
+
+    printf("Data con %d lecturas: streaming %" PRId64 " us y %zu bytes de heap, "
+           "cJSON %" PRId64 " us y %zu bytes de heap\n",
+           LECTURAS, t1 - t0, heap_streaming, t3 - t2, heap_cjson);
+    esfera_manager_snapshot_liberar();
+}
+
+int main(void)
+{
+    setenv("TZ", "UTC0", 1);
+    tzset();
+    host_log_nivel = ESP_LOG_ERROR;
+    esfera_manager_init();
+
+    probar_numeros();
+    probar_data(0);
+    probar_data(1);
+    probar_data(LECTURAS);
+    probar_cota();
+    probar_estado();
+    medir();
+    return prueba_resultado("test_json");
+}
@@ -0,0 +1,306 @@
+// Prueba de esfera_log sobre la partición en RAM: confirmaciones lectura por
+// lectura como el publicador, reinicios simulados (esfera_log_init de nuevo
+// sobre la misma flash y la misma NVS) y vueltas completas del log.
+//
+// El cursor de confirmación no debe persistirse en cada confirmación, sino a
+// lo sumo una vez por página; tras un reinicio se vuelve a publicar menos de
+// una página y nunca se pierde una lectura sin confirmar. Con una partición
+// con historial, las consultas deben devolver cada lectura exactamente una vez,
+// esté cruda o comprimida, también tras reiniciar y tras reciclar el historial.
+#include <stdlib.h>
+#include <string.h>
+#include <inttypes.h>
+#include "esp_log.h"
+#include "host.h"
+#include "prueba.h"
+#include "esfera_log.h"
+
+#define PAGINAS         8           // Sin historial (menos de 4 × ESFERA_LOG_GRUPO)
+#define PAGINAS_HIST    64          // 32 crudas y 32 de historial
+#define SLOTS_PAGINA    ((4096 - 32) / 24)
+#define ESFERAS         10
+#define EPOCH_BASE      1767225600u
+
+static void lectura_de(uint32_t id, esfera_data_t *d)
+{
+    memset(d, 0, sizeof(*d));
+    d->epoch = 1767225600u + id;
+    d->humedad = (uint16_t)(id * 7u);
+    d->temperatura = (int16_t)(id * 31u);
+    d->voltaje_mv = (uint16_t)(id ^ 0x5555u);
+    d->riego = id & 1;
+    d->mac[0] = 0xA0;
+    d->mac[5] = (uint8_t)(id % 40);
+}
+
+static uint32_t agregar(uint32_t n)
+{
+    uint32_t id = 0;
+    for (uint32_t i = 0; i < n; i++) {
+        esfera_data_t d;
+        lectura_de(esfera_log_siguiente_id(), &d);
+        VERIFICAR(esfera_log_agregar(&d, &id) == ESP_OK);
+    }
+    return id + 1;
+}
+
+typedef struct {
+    uint32_t esperado;
+    uint32_t visitadas;
+} recorrido_t;
+
+static void visitar(const esfera_data_t *dato, uint32_t id, void *ctx)
+{
+    recorrido_t *r = ctx;
+    esfera_data_t ref;
+    lectura_de(id, &ref);
+    VERIFICAR_MSG(id == r->esperado, "id %" PRIu32 " en lugar de %" PRIu32, id, r->esperado);
+    VERIFICAR_MSG(memcmp(dato, &ref, sizeof(ref)) == 0, "lectura %" PRIu32 " distinta", id);
+    r->esperado = id + 1;
+    r->visitadas++;
+}
+
+// Las pendientes deben ser exactamente [primer_pendiente, siguiente_id)
+static void verificar_pendientes(void)
+{
+    recorrido_t r = { .esperado = esfera_log_primer_pendiente() };
+    uint32_t fin = esfera_log_siguiente_id();
+    esfera_log_recorrer_pendientes(fin, visitar, &r);
+    VERIFICAR(r.esperado == fin);
+    VERIFICAR(r.visitadas == fin - esfera_log_primer_pendiente());
+}
+
+static void probar_confirmaciones(void)
+{
+    uint32_t commits = host_nvs_commits();
+    uint32_t confirmaciones = 0;
+
+    // Una confirmación por lectura: el peor caso para la NVS
+    uint32_t n = 5 * SLOTS_PAGINA + 17;
+    for (uint32_t i = 0; i < n; i++) {
+        uint32_t hasta = agregar(1);
+        esfera_log_confirmar(hasta);
+        confirmaciones++;
+    }
+    uint32_t hechos = host_nvs_commits() - commits;
+    printf("%" PRIu32 " confirmaciones, %" PRIu32 " commits del cursor\n", confirmaciones, hechos);
+    VERIFICAR_MSG(hechos <= n / SLOTS_PAGINA + 1, "%" PRIu32 " commits", hechos);
+    VERIFICAR(esfera_log_primer_pendiente() == esfera_log_siguiente_id());
+
+    // Reinicio sin flush: se republica menos de una página
+    uint32_t confirmado = esfera_log_primer_pendiente();
+    VERIFICAR(esfera_log_init() == ESP_OK);
+    uint32_t recuperado = esfera_log_primer_pendiente();
+    printf("reinicio: cursor %" PRIu32 " recuperado como %" PRIu32 "\n", confirmado, recuperado);
+    VERIFICAR(recuperado <= confirmado && confirmado - recuperado < SLOTS_PAGINA);
+    verificar_pendientes();
+
+    // Con flush forzado antes de reiniciar no se republica nada
+    esfera_log_confirmar(esfera_log_siguiente_id());
+    esfera_log_flush(true);
+    VERIFICAR(esfera_log_init() == ESP_OK);
+    VERIFICAR(esfera_log_primer_pendiente() == esfera_log_siguiente_id());
+
+    // Las confirmaciones repetidas o hacia atrás no escriben
+    commits = host_nvs_commits();
+    for (int i = 0; i < 100; i++) esfera_log_confirmar(esfera_log_primer_pendiente() - 1);
+    esfera_log_flush(false);
+    VERIFICAR(host_nvs_commits() == commits);
+}
+
+// Lecturas sin confirmar en el lote y en flash sobreviven al reinicio
+static void probar_pendientes(void)
+{
+    uint32_t desde = esfera_log_siguiente_id();
+    agregar(3 * SLOTS_PAGINA);
+    esfera_log_confirmar(desde + SLOTS_PAGINA / 2);
+    esfera_log_flush(true);
+    VERIFICAR(esfera_log_init() == ESP_OK);
+    VERIFICAR(esfera_log_primer_pendiente() == desde + SLOTS_PAGINA / 2);
+    verificar_pendientes();
+
+    esfera_log_stats_t st;
+    esfera_log_get_stats(&st);
+    VERIFICAR(st.pendientes == 3 * SLOTS_PAGINA - SLOTS_PAGINA / 2);
+}
+
+// Sin confirmar, el log da varias vueltas: se pierde lo más viejo, nunca lo nuevo
+static void probar_vueltas(void)
+{
+    esfera_log_stats_t antes;
+    esfera_log_get_stats(&antes);
+    agregar(3 * PAGINAS * SLOTS_PAGINA);
+    esfera_log_flush(true);
+
+    esfera_log_stats_t st;
+    esfera_log_get_stats(&st);
+    VERIFICAR(st.perdidas > antes.perdidas);
+    VERIFICAR(st.pendientes <= PAGINAS * SLOTS_PAGINA && st.pendientes >= (PAGINAS - 1) * SLOTS_PAGINA);
+    VERIFICAR(st.errores == 0);
+    verificar_pendientes();
+
+    VERIFICAR(esfera_log_init() == ESP_OK);
+    verificar_pendientes();
+    printf("vueltas: %" PRIu32 " pendientes, %" PRIu32 " perdidas, %" PRIu32 " borrados, %" PRIu32 " commits\n",
+           st.pendientes, st.perdidas, st.borrados, st.commits_ack);
+}
+
+// ============================================================
+//   HISTORIAL
+// ============================================================
+// Lectura k de la flota: esfera k % ESFERAS, epoch único y valores que
+// cambian despacio como los de una esfera real
+static void lectura_flota(uint32_t k, esfera_data_t *d)
+{
+    uint32_t i = k % ESFERAS, t = k / ESFERAS;
+    memset(d, 0, sizeof(*d));
+    d->epoch = EPOCH_BASE + k;
+    d->humedad = (uint16_t)(4000 + i * 300 + (t / 3) % 200 + (t * 7 % 5));
+    d->temperatura = (int16_t)(1800 + i * 50 + (int)((t / 10) % 120) - (int)(t % 3));
+    d->voltaje_mv = (uint16_t)(4100 - i * 10 - t / 40);
+    d->riego = (t % 30) == 0;
+    d->mac[0] = 0xA0;
+    d->mac[1] = 0x85;
+    d->mac[5] = (uint8_t)i;
+}
+
+static void agregar_flota(uint32_t desde, uint32_t hasta)
+{
+    for (uint32_t k = desde; k < hasta; k++) {
+        esfera_data_t d;
+        uint32_t id;
+        lectura_flota(k, &d);
+        VERIFICAR(esfera_log_agregar(&d, &id) == ESP_OK);
+        // El publicador confirma al ritmo de la ingesta
+        if (k % 50 == 49) esfera_log_confirmar(id + 1);
+    }
+}
+
+typedef struct {
+    uint8_t *vistas;
+    uint32_t total;
+    uint32_t coinciden;
+    uint32_t rotas;
+    uint32_t repetidas;
+    const uint8_t *mac;     // NULL = todas
+    uint32_t limite;        // 0 = sin límite
+} consulta_t;
+
+static bool contar(const esfera_data_t *d, void *ctx)
+{
+    consulta_t *c = ctx;
+    uint32_t k = d->epoch - EPOCH_BASE;
+    esfera_data_t ref;
+    lectura_flota(k, &ref);
+    c->total++;
+    if (memcmp(d, &ref, sizeof(ref)) != 0) {
+        c->rotas++;
+        return true;
+    }
+    if (c->mac && memcmp(d->mac, c->mac, sizeof(d->mac)) != 0) return true;
+    if (c->vistas[k]) c->repetidas++;
+    c->vistas[k] = 1;
+    c->coinciden++;
+    return !c->limite || c->coinciden < c->limite;
+}
+
+static consulta_t consultar(uint8_t *vistas, uint32_t n, uint32_t desde, uint32_t hasta, const uint8_t *mac,
+                            bool descendente)
+{
+    memset(vistas, 0, n);
+    consulta_t c = { .vistas = vistas, .mac = mac };
+    esfera_log_filtro_t filtro = { .desde = EPOCH_BASE + desde, .hasta = EPOCH_BASE + hasta };
+    if (mac) filtro.bloom = esfera_log_bloom(mac);
+    esfera_log_recorrer(&filtro, descendente, contar, &c);
+    VERIFICAR(c.rotas == 0 && c.repetidas == 0);
+    return c;
+}
+
+// Cuántas de [desde, hasta) faltan en la consulta
+static uint32_t faltantes(const uint8_t *vistas, uint32_t desde, uint32_t hasta)
+{
+    uint32_t n = 0;
+    for (uint32_t k = desde; k < hasta; k++) n += !vistas[k];
+    return n;
+}
+
+static void probar_historial(void)
+{
+    if (!host_particion_crear(ESFERA_LOG_PARTICION, PAGINAS_HIST * 4096)) {
+        VERIFICAR(false);
+        return;
+    }
+    VERIFICAR(esfera_log_init() == ESP_OK);
+    esfera_log_stats_t antes;
+    esfera_log_get_stats(&antes);
+
+    // Más de tres vueltas del anillo crudo, sin llenar el historial
+    uint32_t n = 20000;
+    uint8_t *vistas = malloc(200000);
+    if (!vistas) return;
+    agregar_flota(0, n);
+
+    esfera_log_stats_t st;
+    esfera_log_get_stats(&st);
+    uint32_t archivadas = st.archivadas - antes.archivadas;
+    uint32_t bytes = st.bytes_historial - antes.bytes_historial;
+    printf("historial: %" PRIu32 " lecturas en %" PRIu32 " bytes (%.2f B/lectura, %.1fx menos que crudas)\n",
+           archivadas, bytes, (double)bytes / archivadas, 24.0 * archivadas / bytes);
+    VERIFICAR(archivadas > 2 * (PAGINAS_HIST / 2) * SLOTS_PAGINA);
+    VERIFICAR(bytes * 5 < archivadas * 24);
+    VERIFICAR(st.errores == 0);
+
+    // Todo, en los dos sentidos, y de nuevo tras reiniciar
+    for (int reinicio = 0; reinicio < 2; reinicio++) {
+        consulta_t c = consultar(vistas, n, 0, UINT32_MAX - EPOCH_BASE, NULL, false);
+        VERIFICAR_MSG(c.coinciden == n && faltantes(vistas, 0, n) == 0, "%" PRIu32 " de %" PRIu32, c.coinciden, n);
+        c = consultar(vistas, n, 0, UINT32_MAX - EPOCH_BASE, NULL, true);
+        VERIFICAR(c.coinciden == n);
+        VERIFICAR(esfera_log_init() == ESP_OK);
+    }
+
+    // Una esfera: el filtro de la cabecera de bloque deja solo la suya
+    static const uint8_t mac[6] = { 0xA0, 0x85, 0, 0, 0, 3 };
+    consulta_t c = consultar(vistas, n, 0, UINT32_MAX - EPOCH_BASE, mac, false);
+    VERIFICAR(c.coinciden == n / ESFERAS && c.total < n);
+
+    // Un rango de epoch dentro de lo comprimido y otro que cruza a lo crudo
+    c = consultar(vistas, n, 5000, 5999, NULL, false);
+    VERIFICAR(c.coinciden == 1000 && c.total == 1000 && faltantes(vistas, 5000, 6000) == 0);
+    c = consultar(vistas, n, n - 3000, n - 1, NULL, true);
+    VERIFICAR(c.coinciden == 3000 && faltantes(vistas, n - 3000, n) == 0);
+
+    // Corte temprano: la consulta se detiene en el límite
+    memset(vistas, 0, n);
+    c = (consulta_t){ .vistas = vistas, .limite = 25 };
+    esfera_log_filtro_t todo = { .desde = 0, .hasta = UINT32_MAX };
+    esfera_log_recorrer(&todo, false, contar, &c);
+    VERIFICAR(c.total == 25 && c.coinciden == 25);
+
+    // Varias vueltas del historial: se pierde lo más viejo, nunca lo nuevo
+    uint32_t m = 200000;
+    agregar_flota(n, m);
+    c = consultar(vistas, m, 0, UINT32_MAX - EPOCH_BASE, NULL, false);
+    uint32_t primera = 0;
+    while (primera < m && !vistas[primera]) primera++;
+    printf("historial reciclado: %" PRIu32 " lecturas consultables (desde la %" PRIu32 ")\n", c.coinciden, primera);
+    VERIFICAR(faltantes(vistas, primera, m) == 0);
+    VERIFICAR(c.coinciden > (PAGINAS_HIST / 2) * SLOTS_PAGINA * 3);
+    VERIFICAR(esfera_log_init() == ESP_OK);
+    consulta_t tras = consultar(vistas, m, 0, UINT32_MAX - EPOCH_BASE, NULL, true);
+    VERIFICAR(tras.coinciden == c.coinciden);
+    free(vistas);
+}
+
+int main(void)
+{
+    host_log_nivel = ESP_LOG_ERROR;
+    if (!host_particion_crear(ESFERA_LOG_PARTICION, PAGINAS * 4096)) return 1;
+    VERIFICAR(esfera_log_init() == ESP_OK);
+
+    probar_confirmaciones();
+    probar_pendientes();
+    probar_vueltas();
+    probar_historial();
+    return prueba_resultado("test_log");
+}